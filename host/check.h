@@ -0,0 +1,54 @@
+#ifndef _CHECK_H_
+#define _CHECK_H_
+
+#include <math.h>
+#include <stdio.h>
+
+/* Minimal assertions for the host tests, a failed one is printed and counted
+ * and the test carries on. main returns check_failed() for ctest. */
+static int check_failures;
+
+#define CHECK(cond)                                                            \
+    do                                                                         \
+    {                                                                          \
+        if (!(cond))                                                           \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);         \
+            check_failures++;                                                  \
+        }                                                                      \
+    } while (0)
+
+#define CHECK_INT(actual, expected)                                            \
+    do                                                                         \
+    {                                                                          \
+        long long a_ = (actual), e_ = (expected);                              \
+        if (a_ != e_)                                                          \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n", __FILE__,    \
+                    __LINE__, #actual, a_, e_);                                \
+            check_failures++;                                                  \
+        }                                                                      \
+    } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance)                                \
+    do                                                                         \
+    {                                                                          \
+        double a_ = (actual), e_ = (expected);                                 \
+        if (!(fabs(a_ - e_) <= (tolerance)))                                   \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: %s is %g, expected %g\n", __FILE__,        \
+                    __LINE__, #actual, a_, e_);                                \
+            check_failures++;                                                  \
+        }                                                                      \
+    } while (0)
+
+static inline int check_failed(void)
+{
+    if (check_failures > 0)
+    {
+        fprintf(stderr, "%d checks failed\n", check_failures);
+    }
+    return check_failures > 0;
+}
+
+#endif
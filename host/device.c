@@ -0,0 +1,37 @@
+/* The modules behind the web server that need the real hardware. They report
+ * an idle car, updates are refused. */
+#include <string.h>
+
+#include "ota.h"
+#include "resume.h"
+#include "sync.h"
+
+static modelcar_sync_stats_t sync_stats;
+static modelcar_resume_stats_t resume_stats;
+static modelcar_ota_stats_t ota_stats;
+
+const modelcar_sync_stats_t *modelcar_sync_get_stats(void)
+{
+    return &sync_stats;
+}
+
+const modelcar_resume_stats_t *modelcar_resume_get_stats(void)
+{
+    return &resume_stats;
+}
+
+// no flash to write to
+esp_err_t modelcar_ota_begin(size_t size) { return ESP_ERR_NOT_SUPPORTED; }
+
+esp_err_t modelcar_ota_write(const void *buf, size_t len)
+{
+    return ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t modelcar_ota_end(void) { return ESP_ERR_INVALID_STATE; }
+
+void modelcar_ota_abort(void) {}
+
+bool modelcar_ota_running(void) { return false; }
+
+const modelcar_ota_stats_t *modelcar_ota_get_stats(void) { return &ota_stats; }
@@ -0,0 +1,10 @@
+/* only the constants the duty math needs, see transfer.c */
+#ifndef _DRIVER_LEDC_H_
+#define _DRIVER_LEDC_H_
+
+typedef enum
+{
+    LEDC_TIMER_13_BIT = 13,
+} ledc_timer_bit_t;
+
+#endif
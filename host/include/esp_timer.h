@@ -0,0 +1,9 @@
+#ifndef _ESP_TIMER_H_
+#define _ESP_TIMER_H_
+
+#include <stdint.h>
+
+/* monotonic, since the start of the process */
+int64_t esp_timer_get_time(void);
+
+#endif
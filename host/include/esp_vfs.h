@@ -0,0 +1,4 @@
+/* nothing of it is used on the host */
+#ifndef _ESP_VFS_H_
+#define _ESP_VFS_H_
+#endif
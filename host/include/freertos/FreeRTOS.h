@@ -0,0 +1,32 @@
+/* FreeRTOS on POSIX threads, just what the portal services use */
+#ifndef _FREERTOS_FREERTOS_H_
+#define _FREERTOS_FREERTOS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint8_t StackType_t;
+
+/* one tick per ms */
+#define portTICK_RATE_MS 1
+#define portTICK_PERIOD_MS 1
+#define portMAX_DELAY ((TickType_t)0xffffffff)
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+
+#define tskIDLE_PRIORITY 0
+
+#define BIT0 (1 << 0)
+#define BIT1 (1 << 1)
+#define BIT2 (1 << 2)
+#define BIT3 (1 << 3)
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef _FREERTOS_EVENT_GROUPS_H_
+#define _FREERTOS_EVENT_GROUPS_H_
+
+#include <pthread.h>
+
+#include "freertos/FreeRTOS.h"
+
+typedef uint32_t EventBits_t;
+
+struct host_event_group_s
+{
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    EventBits_t bits;
+};
+typedef struct host_event_group_s StaticEventGroup_t;
+typedef struct host_event_group_s *EventGroupHandle_t;
+
+EventGroupHandle_t xEventGroupCreate(void);
+EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t *buffer);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits,
+                                BaseType_t clear, BaseType_t all,
+                                TickType_t ticks);
+
+#endif
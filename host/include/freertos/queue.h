@@ -0,0 +1,12 @@
+#ifndef _FREERTOS_QUEUE_H_
+#define _FREERTOS_QUEUE_H_
+
+#include "freertos/FreeRTOS.h"
+
+/* no queues on the host, the pulse queue stays NULL */
+typedef struct host_queue_s *QueueHandle_t;
+typedef QueueHandle_t xQueueHandle;
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef _FREERTOS_TASK_H_
+#define _FREERTOS_TASK_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+typedef struct host_task_s *TaskHandle_t;
+
+/* the host task runs on a pthread, the stack buffer is left unused */
+typedef struct
+{
+    void *unused;
+} StaticTask_t;
+
+/* Tasks are detached threads with the default thread stack. Priorities are
+ * ignored, the host scheduler decides. */
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack,
+                       void *arg, UBaseType_t prio, TaskHandle_t *handle);
+TaskHandle_t xTaskCreateStatic(TaskFunction_t fn, const char *name,
+                               uint32_t stack, void *arg, UBaseType_t prio,
+                               StackType_t *stack_buffer,
+                               StaticTask_t *task_buffer);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+
+#endif
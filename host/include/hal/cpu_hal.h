@@ -0,0 +1,9 @@
+#ifndef _HAL_CPU_HAL_H_
+#define _HAL_CPU_HAL_H_
+
+#include <stdint.h>
+
+/* TSC on x86, nanoseconds elsewhere, only differences are meaningful */
+uint32_t cpu_hal_get_cycle_count(void);
+
+#endif
@@ -0,0 +1,10 @@
+/* Force included into every file of the host build for what newlib has and
+ * glibc does not. */
+#ifndef _HOST_COMPAT_H_
+#define _HOST_COMPAT_H_
+
+#include <stddef.h>
+
+size_t strlcpy(char *dst, const char *src, size_t size);
+
+#endif
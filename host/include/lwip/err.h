@@ -0,0 +1,6 @@
+#ifndef _LWIP_ERR_H_
+#define _LWIP_ERR_H_
+
+typedef int err_t;
+
+#endif
@@ -0,0 +1,4 @@
+/* nothing of it is used on the host */
+#ifndef _LWIP_NETDB_H_
+#define _LWIP_NETDB_H_
+#endif
@@ -0,0 +1,16 @@
+/* lwIP follows the BSD socket API, the host one serves as is */
+#ifndef _LWIP_SOCKETS_H_
+#define _LWIP_SOCKETS_H_
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define ip4_addr1(ipaddr) (((const uint8_t *)(&(ipaddr)->addr))[0])
+#define ip4_addr2(ipaddr) (((const uint8_t *)(&(ipaddr)->addr))[1])
+#define ip4_addr3(ipaddr) (((const uint8_t *)(&(ipaddr)->addr))[2])
+#define ip4_addr4(ipaddr) (((const uint8_t *)(&(ipaddr)->addr))[3])
+
+#endif
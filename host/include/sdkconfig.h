@@ -0,0 +1,56 @@
+/* Configuration of the host build, the Kconfig defaults of the firmware.
+ * Only what the code built on the host reads, see host/CMakeLists.txt. */
+#ifndef _SDKCONFIG_H_
+#define _SDKCONFIG_H_
+
+#include <stdint.h>
+
+#define CONFIG_IDF_TARGET "linux"
+
+#define CONFIG_ESP_WIFI_IP "192.168.0.1"
+#define CONFIG_ESP_WIFI_NETMASK "255.255.255.0"
+#define CONFIG_ESP_MAX_STA_CONN 5
+
+#define CONFIG_MODELCAR_PROFILE_COUNT 3
+#define CONFIG_MODELCAR_CONTROL_TASK_PRIORITY 8
+#define CONFIG_MODELCAR_HTTPD_TASK_PRIORITY 4
+#define CONFIG_MODELCAR_METRICS_BUFFER_SIZE 4096
+#define CONFIG_MODELCAR_STATIC_ALLOCATION 1
+#define CONFIG_MODELCAR_NET_TASK_STACK_SIZE 3072
+#define CONFIG_MODELCAR_PULSE_QUEUE_LENGTH 10
+#define CONFIG_MODELCAR_HTTP_QUERY_MAX 512
+#define CONFIG_MODELCAR_OTA_CHUNK_SIZE 4096
+#define CONFIG_MODELCAR_OTA_CONFIRM_S 30
+#define CONFIG_MODELCAR_TRACE 0
+
+/* MODELCAR_HOST_RATELIMIT=OFF lifts the limits to load the handlers */
+#if MODELCAR_HOST_UNLIMITED
+#define CONFIG_MODELCAR_DNS_RATE_LIMIT 1000000
+#define CONFIG_MODELCAR_DNS_RATE_BURST 1000000
+#define CONFIG_MODELCAR_DNS_RATE_LIMIT_TOTAL 1000000
+#define CONFIG_MODELCAR_DNS_RATE_BURST_TOTAL 1000000
+#define CONFIG_MODELCAR_HTTP_RATE_LIMIT 1000000
+#define CONFIG_MODELCAR_HTTP_RATE_BURST 1000000
+#define CONFIG_MODELCAR_HTTP_RATE_LIMIT_TOTAL 1000000
+#define CONFIG_MODELCAR_HTTP_RATE_BURST_TOTAL 1000000
+#else
+#define CONFIG_MODELCAR_DNS_RATE_LIMIT 10
+#define CONFIG_MODELCAR_DNS_RATE_BURST 20
+#define CONFIG_MODELCAR_DNS_RATE_LIMIT_TOTAL 25
+#define CONFIG_MODELCAR_DNS_RATE_BURST_TOTAL 40
+#define CONFIG_MODELCAR_HTTP_RATE_LIMIT 5
+#define CONFIG_MODELCAR_HTTP_RATE_BURST 20
+#define CONFIG_MODELCAR_HTTP_RATE_LIMIT_TOTAL 12
+#define CONFIG_MODELCAR_HTTP_RATE_BURST_TOTAL 30
+#endif
+
+/* as recommended in the README for the captive portal */
+#define CONFIG_HTTPD_MAX_REQ_HDR_LEN 16384
+#define CONFIG_HTTPD_MAX_URI_LEN 8192
+
+/* the ports can be changed at run time, 53 and 80 need root */
+extern uint16_t modelcar_host_http_port;
+extern uint16_t modelcar_host_dns_port;
+#define WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_PORT modelcar_host_dns_port
+
+#endif
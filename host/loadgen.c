@@ -0,0 +1,880 @@
+/* Load generator for the portal services. N simulated phones join at once and
+ * loop through what a phone does on the AP: DNS lookups and the OS
+ * connectivity probe, the captive portal API, the config page with its
+ * assets, the profile and all values, now and then a save.
+ *
+ *   modelcar_loadgen [-c clients] [-t seconds] [-w think_ms] [-k 0|1]
+ *                    [-n nvs_commit_us] [-s server_ip] [-p http_port]
+ *                    [-d dns_port] [-v]
+ *
+ * Without -s the firmware's servers run in this process on the loopback
+ * interface and every phone uses its own source address 127.0.0.x, so the
+ * rate limits see separate clients as on the device. With -s a running
+ * modelcar_host or the car itself (-p 80 -d 53) is loaded instead.
+ *
+ * Reports requests per category with throughput and latency percentiles,
+ * and for the in-process server its heap, peak RSS and counters. */
+#include <errno.h>
+#include <malloc.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include "nvs.h"
+
+#include "httpd.h"
+#include "server.h"
+#include "web_assets.h"
+#include "wifi-captive-portal/wifi-captive-portal-esp-idf-dns.h"
+
+#define CLIENTS_MAX 200
+#define DNS_TIMEOUT_MS 250
+#define HTTP_TIMEOUT_MS 2000
+#define RESP_HDR_MAX 2048
+#define SAVE_EVERY 4 // sessions
+
+/* log-linear latency histogram: 16 buckets per power of two up to 2^24 us */
+#define HIST_SUB 16
+#define HIST_BUCKETS ((24 - 3) * HIST_SUB)
+
+enum category_e
+{
+    CATEGORY_DNS = 0,
+    CATEGORY_PROBE,
+    CATEGORY_PAGE,
+    CATEGORY_API,
+    CATEGORY_SAVE,
+    CATEGORY_COUNT
+};
+typedef enum category_e category_t;
+
+static const char *const category_names[CATEGORY_COUNT] = {
+    "dns", "probe", "page", "api", "save",
+};
+
+enum result_e
+{
+    RESULT_OK = 0,
+    RESULT_DROPPED, // no answer: rate limited, or closed without a response
+    RESULT_FAILED,  // unexpected answer or transport error
+};
+typedef enum result_e result_t;
+
+struct histogram_s
+{
+    uint32_t count[HIST_BUCKETS];
+    uint64_t sum_us;
+    uint32_t max_us;
+    uint32_t n;
+};
+typedef struct histogram_s histogram_t;
+
+struct category_stats_s
+{
+    uint32_t ok;
+    uint32_t dropped;
+    uint32_t failed;
+    histogram_t latency; // answered requests only
+};
+typedef struct category_stats_s category_stats_t;
+
+/* the connectivity check of one client OS */
+struct os_profile_s
+{
+    const char *name;
+    const char *probe_host;
+    const char *probe_path;
+    const char *background_hosts[3];
+};
+typedef struct os_profile_s os_profile_t;
+
+static const os_profile_t os_profiles[] = {
+    {"android",
+     "connectivitycheck.gstatic.com",
+     "/generate_204",
+     {"mtalk.google.com", "play.googleapis.com", "www.googleapis.com"}},
+    {"ios",
+     "captive.apple.com",
+     "/hotspot-detect.html",
+     {"gateway.icloud.com", "gsp-ssl.ls.apple.com", "init.itunes.apple.com"}},
+    {"windows",
+     "www.msftconnecttest.com",
+     "/connecttest.txt",
+     {"settings-win.data.microsoft.com", "login.live.com",
+      "dns.msftncsi.com"}},
+    {"firefox",
+     "detectportal.firefox.com",
+     "/canonical.html",
+     {"push.services.mozilla.com", "firefox.settings.services.mozilla.com",
+      "location.services.mozilla.com"}},
+};
+#define OS_PROFILE_COUNT (sizeof(os_profiles) / sizeof(os_profiles[0]))
+
+/* what the config page reads after loading, see www/app.js */
+static const char *const read_values[] = {
+    "servo1_factor", "servo2_factor", "servo1_offset", "servo2_offset",
+    "servo1_limit",  "servo2_limit",  "servo1_expo",   "servo2_expo",
+    "servo1_curve",  "servo2_curve",  "servo2_accel",  "servo2_decel",
+    "servo2_brake",  "servo2_reverse",
+};
+#define READ_VALUE_COUNT (sizeof(read_values) / sizeof(read_values[0]))
+
+static const char save_path[] =
+    "/save?servo1_factor=1.00&servo2_factor=0.50&servo1_offset=0"
+    "&servo2_offset=0&servo1_limit=1.00&servo2_limit=0.60&servo1_expo=0.20"
+    "&servo2_expo=0.30&servo1_curve=&servo2_curve=&servo2_accel=300"
+    "&servo2_decel=200&servo2_brake=100&servo2_reverse=500";
+
+struct client_s
+{
+    pthread_t thread;
+    int idx;
+    const os_profile_t *os;
+    struct sockaddr_in src; // sin_port 0, sin_addr 0 for any
+    int http_fd;
+    bool http_reused; // http_fd served a request before
+    int dns_fd;
+    uint16_t dns_id;
+    bool cached; // page assets seen, conditional requests from now on
+    category_stats_t stats[CATEGORY_COUNT];
+};
+typedef struct client_s client_t;
+
+struct options_s
+{
+    int clients;
+    int seconds;
+    int think_ms;
+    bool keep_alive;
+    bool in_process;
+    struct sockaddr_in http_addr;
+    struct sockaddr_in dns_addr;
+};
+typedef struct options_s options_t;
+
+static options_t options = {
+    .clients = 5,
+    .seconds = 10,
+    .think_ms = 0,
+    .keep_alive = true,
+    .in_process = true,
+};
+
+static client_t clients[CLIENTS_MAX];
+static volatile bool running;
+
+static volatile size_t heap_peak;
+static volatile bool monitor_running;
+
+static int64_t now_us(void) { return esp_timer_get_time(); }
+
+static int histogram_bucket(uint32_t us)
+{
+    if (us < HIST_SUB)
+    {
+        return us;
+    }
+    int exp = 31 - __builtin_clz(us);
+    int bucket = (exp - 3) * HIST_SUB + ((us >> (exp - 4)) & (HIST_SUB - 1));
+    return bucket < HIST_BUCKETS ? bucket : HIST_BUCKETS - 1;
+}
+
+// the middle of a bucket
+static uint32_t histogram_value(int bucket)
+{
+    if (bucket < HIST_SUB)
+    {
+        return bucket;
+    }
+    int exp = bucket / HIST_SUB + 3;
+    uint32_t low = (uint32_t)(HIST_SUB + bucket % HIST_SUB) << (exp - 4);
+    return low + (1u << (exp - 4)) / 2;
+}
+
+static void histogram_add(histogram_t *h, uint32_t us)
+{
+    h->count[histogram_bucket(us)]++;
+    h->sum_us += us;
+    h->max_us = us > h->max_us ? us : h->max_us;
+    h->n++;
+}
+
+static void histogram_merge(histogram_t *to, const histogram_t *from)
+{
+    for (int i = 0; i < HIST_BUCKETS; ++i)
+    {
+        to->count[i] += from->count[i];
+    }
+    to->sum_us += from->sum_us;
+    to->max_us = from->max_us > to->max_us ? from->max_us : to->max_us;
+    to->n += from->n;
+}
+
+static uint32_t histogram_percentile(const histogram_t *h, double p)
+{
+    uint64_t rank = (uint64_t)(p * h->n + 0.999999);
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; ++i)
+    {
+        seen += h->count[i];
+        if (seen >= rank && seen > 0)
+        {
+            uint32_t value = histogram_value(i);
+            return value < h->max_us ? value : h->max_us;
+        }
+    }
+    return h->max_us;
+}
+
+static void record(client_t *client, category_t category, result_t result,
+                   int64_t start_us)
+{
+    category_stats_t *stats = &client->stats[category];
+    switch (result)
+    {
+    case RESULT_OK:
+        stats->ok++;
+        histogram_add(&stats->latency, now_us() - start_us);
+        break;
+    case RESULT_DROPPED:
+        stats->dropped++;
+        break;
+    case RESULT_FAILED:
+        stats->failed++;
+        break;
+    }
+}
+
+static void think(void)
+{
+    if (options.think_ms > 0)
+    {
+        usleep(options.think_ms * 1000);
+    }
+}
+
+static void set_timeout(int fd, int ms)
+{
+    struct timeval tv = {.tv_sec = ms / 1000, .tv_usec = (ms % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+static int client_socket(client_t *client, int type)
+{
+    int fd = socket(AF_INET, type, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    if (client->src.sin_addr.s_addr != 0 &&
+        bind(fd, (struct sockaddr *)&client->src, sizeof(client->src)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* DNS */
+
+static size_t dns_build_query(uint8_t *buf, uint16_t id, const char *host)
+{
+    DnsHeader *hdr = (DnsHeader *)buf;
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->id = htons(id);
+    hdr->flags = WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_FLAG_RD;
+    hdr->qdcount = htons(1);
+
+    uint8_t *p = buf + sizeof(*hdr);
+    while (*host != 0)
+    {
+        size_t len = strcspn(host, ".");
+        *p++ = len;
+        memcpy(p, host, len);
+        p += len;
+        host += len;
+        if (*host == '.')
+        {
+            ++host;
+        }
+    }
+    *p++ = 0;
+    DnsQuestionFooter footer = {
+        .type = htons(WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_QTYPE_A),
+        .cl = htons(WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_QCLASS_IN),
+    };
+    memcpy(p, &footer, sizeof(footer));
+    return p + sizeof(footer) - buf;
+}
+
+static result_t dns_lookup(client_t *client, const char *host)
+{
+    uint8_t query[WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_LEN];
+    uint8_t reply[WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_LEN];
+    uint16_t id = ++client->dns_id;
+    size_t len = dns_build_query(query, id, host);
+
+    if (sendto(client->dns_fd, query, len, 0,
+               (struct sockaddr *)&options.dns_addr,
+               sizeof(options.dns_addr)) != (ssize_t)len)
+    {
+        return RESULT_FAILED;
+    }
+    while (1)
+    {
+        ssize_t n = recv(client->dns_fd, reply, sizeof(reply), 0);
+        if (n < 0)
+        {
+            return errno == EAGAIN || errno == EWOULDBLOCK ? RESULT_DROPPED
+                                                           : RESULT_FAILED;
+        }
+        const DnsHeader *hdr = (const DnsHeader *)reply;
+        // late answers to earlier queries that timed out
+        if (n < (ssize_t)sizeof(*hdr) || ntohs(hdr->id) != id)
+        {
+            continue;
+        }
+        return (hdr->flags & WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_FLAG_QR) &&
+                       ntohs(hdr->ancount) == 1
+                   ? RESULT_OK
+                   : RESULT_FAILED;
+    }
+}
+
+static void dns_step(client_t *client, const char *host)
+{
+    int64_t start = now_us();
+    record(client, CATEGORY_DNS, dns_lookup(client, host), start);
+    think();
+}
+
+/* HTTP */
+
+static void http_close(client_t *client)
+{
+    if (client->http_fd >= 0)
+    {
+        close(client->http_fd);
+        client->http_fd = -1;
+    }
+}
+
+static bool http_connect(client_t *client)
+{
+    client->http_fd = client_socket(client, SOCK_STREAM);
+    if (client->http_fd < 0)
+    {
+        return false;
+    }
+    int one = 1;
+    setsockopt(client->http_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    set_timeout(client->http_fd, HTTP_TIMEOUT_MS);
+    client->http_reused = false;
+    if (connect(client->http_fd, (struct sockaddr *)&options.http_addr,
+                sizeof(options.http_addr)) != 0)
+    {
+        http_close(client);
+        return false;
+    }
+    return true;
+}
+
+static bool send_all(int fd, const char *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n <= 0)
+        {
+            return false;
+        }
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool recv_discard(int fd, size_t len)
+{
+    char buf[4096];
+    while (len > 0)
+    {
+        ssize_t n = recv(fd, buf, len < sizeof(buf) ? len : sizeof(buf), 0);
+        if (n <= 0)
+        {
+            return false;
+        }
+        len -= n;
+    }
+    return true;
+}
+
+static bool recv_line(int fd, char *buf, size_t size)
+{
+    size_t len = 0;
+    while (len + 1 < size)
+    {
+        if (recv(fd, buf + len, 1, 0) != 1)
+        {
+            return false;
+        }
+        if (buf[len++] == '\n')
+        {
+            buf[len] = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool recv_chunked(int fd)
+{
+    char line[32];
+    while (recv_line(fd, line, sizeof(line)))
+    {
+        size_t len = strtoul(line, NULL, 16);
+        if (!recv_discard(fd, len + 2))
+        {
+            return false;
+        }
+        if (len == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static const char *header_value(const char *headers, const char *field)
+{
+    size_t field_len = strlen(field);
+    for (const char *line = strstr(headers, "\r\n"); line != NULL;
+         line = strstr(line, "\r\n"))
+    {
+        line += 2;
+        if (strncasecmp(line, field, field_len) == 0 && line[field_len] == ':')
+        {
+            return line + field_len + 1 + strspn(line + field_len + 1, " ");
+        }
+    }
+    return NULL;
+}
+
+/* Status code of the response, 0 when the server closed the connection
+ * without an answer, < 0 on errors. The body is read and dropped. */
+static int http_exchange(client_t *client, const char *request, size_t len)
+{
+    if (!send_all(client->http_fd, request, len))
+    {
+        return 0;
+    }
+
+    // the headers arrive in one piece from the server, read until the end
+    char headers[RESP_HDR_MAX];
+    size_t have = 0;
+    char *end = NULL;
+    while (end == NULL)
+    {
+        if (have + 1 >= sizeof(headers))
+        {
+            return -1;
+        }
+        ssize_t n = recv(client->http_fd, headers + have,
+                         sizeof(headers) - 1 - have, MSG_PEEK);
+        if (n <= 0)
+        {
+            // closing with the request unread resets the connection
+            bool closed = n == 0 || errno == ECONNRESET;
+            return closed && have == 0 ? 0 : -1;
+        }
+        headers[have + n] = 0;
+        end = strstr(headers + (have > 3 ? have - 3 : 0), "\r\n\r\n");
+        size_t take = end != NULL ? (size_t)(end + 4 - headers) - have : n;
+        if (recv(client->http_fd, headers + have, take, 0) != (ssize_t)take)
+        {
+            return -1;
+        }
+        have += take;
+    }
+    headers[have] = 0;
+
+    int status = 0;
+    if (sscanf(headers, "HTTP/1.%*d %d", &status) != 1)
+    {
+        return -1;
+    }
+    const char *value = header_value(headers, "Transfer-Encoding");
+    bool ok = value != NULL && strncasecmp(value, "chunked", 7) == 0
+                  ? recv_chunked(client->http_fd)
+                  : recv_discard(client->http_fd,
+                                 (value = header_value(headers,
+                                                       "Content-Length"))
+                                     ? strtoul(value, NULL, 10)
+                                     : 0);
+    if (!ok)
+    {
+        return -1;
+    }
+    value = header_value(headers, "Connection");
+    if (value != NULL && strncasecmp(value, "close", 5) == 0)
+    {
+        http_close(client);
+    }
+    return status;
+}
+
+static result_t http_get(client_t *client, const char *host, const char *path,
+                         const char *etag, int expected)
+{
+    char request[1024];
+    size_t len = snprintf(request, sizeof(request),
+                          "GET %s HTTP/1.1\r\nHost: %s\r\n"
+                          "User-Agent: modelcar-loadgen/%s\r\n"
+                          "Accept-Encoding: gzip\r\n%s%s%s%s\r\n",
+                          path, host, client->os->name,
+                          etag != NULL ? "If-None-Match: " : "",
+                          etag != NULL ? etag : "", etag != NULL ? "\r\n" : "",
+                          options.keep_alive ? "" : "Connection: close\r\n");
+
+    // a kept connection may have been closed by the server meanwhile
+    for (int attempt = 0; attempt < 2; ++attempt)
+    {
+        if (client->http_fd < 0 && !http_connect(client))
+        {
+            return RESULT_DROPPED;
+        }
+        bool reused = client->http_reused;
+        int status = http_exchange(client, request, len);
+        client->http_reused = true;
+        if (status > 0)
+        {
+            if (!options.keep_alive)
+            {
+                http_close(client);
+            }
+            return status == expected ? RESULT_OK : RESULT_FAILED;
+        }
+        http_close(client);
+        if (status < 0)
+        {
+            return RESULT_FAILED;
+        }
+        if (!reused)
+        {
+            // a fresh connection closed unanswered, the rate limit
+            return RESULT_DROPPED;
+        }
+    }
+    return RESULT_DROPPED;
+}
+
+static void http_step(client_t *client, category_t category, const char *host,
+                      const char *path, const char *etag, int expected)
+{
+    int64_t start = now_us();
+    record(client, category, http_get(client, host, path, etag, expected),
+           start);
+    think();
+}
+
+/* one visit of the portal */
+static void client_session(client_t *client, unsigned session)
+{
+    const os_profile_t *os = client->os;
+    const char *portal = CONFIG_ESP_WIFI_IP;
+
+    dns_step(client, os->probe_host);
+    http_step(client, CATEGORY_PROBE, os->probe_host, os->probe_path, NULL,
+              302);
+    http_step(client, CATEGORY_API, portal, "/api/captive", NULL, 200);
+
+    for (size_t i = 0; i < web_assets_count && running; ++i)
+    {
+        const web_asset_t *asset = &web_assets[i];
+        http_step(client, CATEGORY_PAGE, portal, asset->uri,
+                  client->cached ? asset->etag : NULL,
+                  client->cached ? 304 : 200);
+    }
+    client->cached = true;
+
+    http_step(client, CATEGORY_API, portal, "/profile", NULL, 200);
+    for (size_t i = 0; i < READ_VALUE_COUNT && running; ++i)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "/read?value=%s", read_values[i]);
+        http_step(client, CATEGORY_API, portal, path, NULL, 200);
+    }
+    if (session % SAVE_EVERY == SAVE_EVERY - 1)
+    {
+        http_step(client, CATEGORY_SAVE, portal, save_path, NULL, 200);
+    }
+
+    // the apps of the phone keep trying to get online
+    for (int i = 0; i < 3 && running; ++i)
+    {
+        dns_step(client, os->background_hosts[i]);
+    }
+}
+
+static void *client_main(void *arg)
+{
+    client_t *client = arg;
+    for (unsigned session = 0; running; ++session)
+    {
+        client_session(client, session);
+    }
+    http_close(client);
+    close(client->dns_fd);
+    return NULL;
+}
+
+static size_t heap_in_use(void)
+{
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+static void *monitor_main(void *arg)
+{
+    while (monitor_running)
+    {
+        size_t heap = heap_in_use();
+        if (heap > heap_peak)
+        {
+            heap_peak = heap;
+        }
+        usleep(10000);
+    }
+    return NULL;
+}
+
+static long proc_status_kb(const char *field)
+{
+    FILE *f = fopen("/proc/self/status", "r");
+    if (f == NULL)
+    {
+        return -1;
+    }
+    char line[128];
+    long kb = -1;
+    size_t len = strlen(field);
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        if (strncmp(line, field, len) == 0 && line[len] == ':')
+        {
+            kb = strtol(line + len + 1, NULL, 10);
+            break;
+        }
+    }
+    fclose(f);
+    return kb;
+}
+
+static void report(double seconds)
+{
+    printf("\n%-8s %9s %9s %8s %7s %9s %7s %7s %7s %7s %8s\n", "category",
+           "requests", "ok", "dropped", "failed", "ok/s", "p50", "p90", "p99",
+           "p99.9", "max");
+    category_stats_t total = {0};
+    for (int c = 0; c <= CATEGORY_COUNT; ++c)
+    {
+        category_stats_t sum = {0};
+        const char *name = "total";
+        if (c < CATEGORY_COUNT)
+        {
+            name = category_names[c];
+            for (int i = 0; i < options.clients; ++i)
+            {
+                sum.ok += clients[i].stats[c].ok;
+                sum.dropped += clients[i].stats[c].dropped;
+                sum.failed += clients[i].stats[c].failed;
+                histogram_merge(&sum.latency, &clients[i].stats[c].latency);
+            }
+            total.ok += sum.ok;
+            total.dropped += sum.dropped;
+            total.failed += sum.failed;
+            histogram_merge(&total.latency, &sum.latency);
+        }
+        else
+        {
+            sum = total;
+        }
+        const histogram_t *h = &sum.latency;
+        printf("%-8s %9u %9u %8u %7u %9.1f %7u %7u %7u %7u %8u\n", name,
+               sum.ok + sum.dropped + sum.failed, sum.ok, sum.dropped,
+               sum.failed, sum.ok / seconds, histogram_percentile(h, 0.5),
+               histogram_percentile(h, 0.9), histogram_percentile(h, 0.99),
+               histogram_percentile(h, 0.999), h->max_us);
+    }
+    printf("latency in us of answered requests, dropped ones got no answer "
+           "(rate limit)\n");
+}
+
+static void report_server(size_t heap_before, size_t heap_started)
+{
+    printf("\nheap in use: %zu B before start, %zu B serving, %zu B peak "
+           "(+%zu B under load)\n",
+           heap_before, heap_started, heap_peak,
+           heap_peak > heap_started ? heap_peak - heap_started : 0);
+    printf("process RSS: %ld kB peak, %ld kB now\n", proc_status_kb("VmHWM"),
+           proc_status_kb("VmRSS"));
+
+    const modelcar_ratelimit_t *http = modelcar_httpd_get_ratelimit();
+    const modelcar_ratelimit_t *dns =
+        wifi_captive_portal_esp_idf_dns_ratelimit();
+    const modelcar_httpd_dispatch_stats_t *dispatch =
+        modelcar_httpd_get_dispatch_stats();
+    printf("server: http %u passed %u dropped, dns %u passed %u dropped\n",
+           http->passed, http->dropped, dns->passed, dns->dropped);
+    printf("route dispatch: %u requests, %llu cycles avg, %u cycles max\n",
+           dispatch->requests,
+           dispatch->requests
+               ? (unsigned long long)(dispatch->cycles_total /
+                                      dispatch->requests)
+               : 0ull,
+           dispatch->cycles_max);
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-c clients] [-t seconds] [-w think_ms] [-k 0|1]\n"
+            "       [-n nvs_commit_us] [-s server_ip] [-p http_port]\n"
+            "       [-d dns_port] [-v]\n",
+            name);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    const char *server = "127.0.0.1";
+    bool verbose = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:t:w:k:n:s:p:d:v")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c':
+            options.clients = atoi(optarg);
+            break;
+        case 't':
+            options.seconds = atoi(optarg);
+            break;
+        case 'w':
+            options.think_ms = atoi(optarg);
+            break;
+        case 'k':
+            options.keep_alive = atoi(optarg) != 0;
+            break;
+        case 'n':
+            modelcar_host_nvs_commit_us = atoi(optarg);
+            break;
+        case 's':
+            server = optarg;
+            options.in_process = false;
+            break;
+        case 'p':
+            modelcar_host_http_port = atoi(optarg);
+            break;
+        case 'd':
+            modelcar_host_dns_port = atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (options.clients < 1 || options.clients > CLIENTS_MAX ||
+        options.seconds < 1)
+    {
+        usage(argv[0]);
+    }
+
+    options.http_addr.sin_family = AF_INET;
+    options.http_addr.sin_port = htons(modelcar_host_http_port);
+    if (inet_pton(AF_INET, server, &options.http_addr.sin_addr) != 1)
+    {
+        fprintf(stderr, "%s is no IPv4 address\n", server);
+        return 1;
+    }
+    options.dns_addr = options.http_addr;
+    options.dns_addr.sin_port = htons(modelcar_host_dns_port);
+
+    // the handlers log every request, that would measure the terminal
+    esp_log_level_set("*", verbose ? ESP_LOG_INFO : ESP_LOG_WARN);
+    size_t heap_before = heap_in_use();
+    if (options.in_process)
+    {
+        modelcar_host_start();
+    }
+    size_t heap_started = heap_in_use();
+    heap_peak = heap_started;
+
+    bool loopback = (ntohl(options.http_addr.sin_addr.s_addr) >> 24) == 127;
+    for (int i = 0; i < options.clients; ++i)
+    {
+        client_t *client = &clients[i];
+        client->idx = i;
+        client->os = &os_profiles[i % OS_PROFILE_COUNT];
+        client->http_fd = -1;
+        client->src.sin_family = AF_INET;
+        if (loopback)
+        {
+            client->src.sin_addr.s_addr = htonl(0x7f000002 + i);
+        }
+        client->dns_fd = client_socket(client, SOCK_DGRAM);
+        if (client->dns_fd < 0)
+        {
+            fprintf(stderr, "client %d: %s\n", i, strerror(errno));
+            return 1;
+        }
+        set_timeout(client->dns_fd, DNS_TIMEOUT_MS);
+    }
+
+    printf("%d clients for %d s, %s, think time %d ms, %s server %s "
+           "http %d dns %d\n",
+           options.clients, options.seconds,
+           options.keep_alive ? "keep-alive" : "connection per request",
+           options.think_ms, options.in_process ? "in-process" : "remote",
+           server, modelcar_host_http_port, modelcar_host_dns_port);
+
+    pthread_t monitor;
+    monitor_running = true;
+    pthread_create(&monitor, NULL, monitor_main, NULL);
+
+    running = true;
+    int64_t start = now_us();
+    for (int i = 0; i < options.clients; ++i)
+    {
+        pthread_create(&clients[i].thread, NULL, client_main, &clients[i]);
+    }
+    sleep(options.seconds);
+    running = false;
+    for (int i = 0; i < options.clients; ++i)
+    {
+        pthread_join(clients[i].thread, NULL);
+    }
+    double seconds = (now_us() - start) / 1e6;
+    monitor_running = false;
+    pthread_join(monitor, NULL);
+
+    report(seconds);
+    if (options.in_process)
+    {
+        report_server(heap_before, heap_started);
+    }
+    return 0;
+}
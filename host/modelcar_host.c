@@ -0,0 +1,47 @@
+/* The portal web server and DNS of the firmware on Linux, e.g. to work on the
+ * config page in a desktop browser:
+ *   modelcar_host [-p http_port] [-d dns_port] [-n nvs_commit_us] [-q]
+ * then open http://localhost:8080/ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "nvs.h"
+
+#include "server.h"
+
+int main(int argc, char **argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "p:d:n:q")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+            modelcar_host_http_port = atoi(optarg);
+            break;
+        case 'd':
+            modelcar_host_dns_port = atoi(optarg);
+            break;
+        case 'n':
+            modelcar_host_nvs_commit_us = atoi(optarg);
+            break;
+        case 'q':
+            esp_log_level_set("*", ESP_LOG_WARN);
+            break;
+        default:
+            fprintf(stderr,
+                    "usage: %s [-p http_port] [-d dns_port] "
+                    "[-n nvs_commit_us] [-q]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    modelcar_host_start();
+    while (1)
+    {
+        pause();
+    }
+}
@@ -0,0 +1,47 @@
+#include "server.h"
+
+#include <errno.h>
+
+#include "esp_log.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include "nvs_flash.h"
+
+#include "httpd.h"
+#include "net.h"
+#include "portal.h"
+#include "wifi-captive-portal/wifi-captive-portal-esp-idf-dns.h"
+
+#define TAG "modelcar host"
+
+// the network task binds asynchronously, a taken port means it is up
+static bool dns_bound(void)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+        .sin_port = htons(modelcar_host_dns_port),
+    };
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    bool bound = bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 &&
+                 errno == EADDRINUSE;
+    close(fd);
+    return bound;
+}
+
+void modelcar_host_start(void)
+{
+    ESP_ERROR_CHECK(nvs_flash_init());
+    modelcar_portal_init();
+    modelcar_httpd_init();
+    wifi_captive_portal_esp_idf_dns_init();
+    modelcar_net_start();
+    modelcar_portal_station_joined();
+
+    for (int i = 0; i < 100 && !dns_bound(); ++i)
+    {
+        vTaskDelay(20 / portTICK_RATE_MS);
+    }
+    ESP_LOGI(TAG, "http on port %d, dns on port %d", modelcar_host_http_port,
+             modelcar_host_dns_port);
+}
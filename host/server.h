@@ -0,0 +1,9 @@
+#ifndef _SERVER_H_
+#define _SERVER_H_
+
+/* Bring up NVS, the profiles, the portal web server and DNS as the firmware
+ * does, then act as if the first station joined. Returns once both listen on
+ * modelcar_host_http_port and modelcar_host_dns_port. */
+void modelcar_host_start(void);
+
+#endif
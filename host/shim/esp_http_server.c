@@ -0,0 +1,775 @@
+#include "esp_http_server.h"
+
+#include <errno.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/uio.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+
+#define TAG "httpd"
+#define RESP_HDR_MAX 1024
+
+struct httpd_session_s
+{
+    int fd; // -1 for a free slot
+    int64_t last_us;
+};
+
+struct httpd_resp_hdr_s
+{
+    const char *field;
+    const char *value;
+};
+
+struct httpd_req_aux_s
+{
+    struct httpd_session_s *sess;
+    const char *headers; // in the scratch buffer, "Field: value\r\n"...
+    size_t remaining_len;
+    bool keep_alive;
+    bool chunked;
+    const char *status;
+    const char *content_type;
+    struct httpd_resp_hdr_s *resp_hdrs;
+    size_t resp_hdr_count;
+};
+
+struct httpd_data_s
+{
+    httpd_config_t config;
+    int listen_fd;
+    int ctrl_fd[2];
+    pthread_t thread;
+    httpd_uri_t *handlers;
+    size_t handler_count;
+    struct httpd_session_s *sessions;
+    // one request at a time, like the single httpd task on the device
+    char scratch[HTTPD_MAX_REQ_HDR_LEN + 1];
+    httpd_req_t req;
+    struct httpd_req_aux_s aux;
+};
+
+static const struct
+{
+    const char *status;
+    const char *msg;
+} err_codes[HTTPD_ERR_CODE_MAX] = {
+    [HTTPD_500_INTERNAL_SERVER_ERROR] = {"500 Internal Server Error",
+                                         "Server has encountered an "
+                                         "unexpected error"},
+    [HTTPD_501_METHOD_NOT_IMPLEMENTED] = {"501 Method Not Implemented",
+                                          "Request method is not supported "
+                                          "by server"},
+    [HTTPD_505_VERSION_NOT_SUPPORTED] = {"505 Version Not Supported",
+                                         "HTTP version not supported by "
+                                         "server"},
+    [HTTPD_400_BAD_REQUEST] = {"400 Bad Request", "Bad request syntax"},
+    [HTTPD_401_UNAUTHORIZED] = {"401 Unauthorized", "No permission"},
+    [HTTPD_403_FORBIDDEN] = {"403 Forbidden", "Access to this resource is "
+                                              "forbidden"},
+    [HTTPD_404_NOT_FOUND] = {"404 Not Found", "This URI does not exist"},
+    [HTTPD_405_METHOD_NOT_ALLOWED] = {"405 Method Not Allowed",
+                                      "Request method for this URI is not "
+                                      "handled by server"},
+    [HTTPD_408_REQ_TIMEOUT] = {"408 Request Timeout", "Server closed this "
+                                                      "connection"},
+    [HTTPD_411_LENGTH_REQUIRED] = {"411 Length Required", "Chunked encoding "
+                                                          "not supported"},
+    [HTTPD_414_URI_TOO_LONG] = {"414 URI Too Long", "URI is too long"},
+    [HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE] = {"431 Request Header Fields Too "
+                                            "Large",
+                                            "Header fields are too long"},
+};
+
+static esp_err_t send_all(int fd, struct iovec *iov, int count)
+{
+    while (count > 0)
+    {
+        ssize_t n = writev(fd, iov, count);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return ESP_ERR_HTTPD_RESP_SEND;
+        }
+        while (count > 0 && (size_t)n >= iov->iov_len)
+        {
+            n -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return ESP_OK;
+}
+
+static void session_close(struct httpd_session_s *sess)
+{
+    close(sess->fd);
+    sess->fd = -1;
+}
+
+static void session_accept(struct httpd_data_s *hd)
+{
+    int fd = accept(hd->listen_fd, NULL, NULL);
+    if (fd < 0)
+    {
+        return;
+    }
+
+    struct httpd_session_s *slot = NULL;
+    struct httpd_session_s *lru = NULL;
+    for (int i = 0; i < hd->config.max_open_sockets; ++i)
+    {
+        struct httpd_session_s *sess = &hd->sessions[i];
+        if (sess->fd < 0)
+        {
+            slot = sess;
+            break;
+        }
+        if (lru == NULL || sess->last_us < lru->last_us)
+        {
+            lru = sess;
+        }
+    }
+    if (slot == NULL)
+    {
+        if (!hd->config.lru_purge_enable)
+        {
+            close(fd);
+            return;
+        }
+        session_close(lru);
+        slot = lru;
+    }
+
+    struct timeval recv_timeout = {.tv_sec = hd->config.recv_wait_timeout};
+    struct timeval send_timeout = {.tv_sec = hd->config.send_wait_timeout};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &recv_timeout,
+               sizeof(recv_timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout,
+               sizeof(send_timeout));
+    // Linux delays the ACK of small segments, lwIP on the device does not
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (hd->config.open_fn != NULL && hd->config.open_fn(hd, fd) != ESP_OK)
+    {
+        close(fd);
+        return;
+    }
+    slot->fd = fd;
+    slot->last_us = esp_timer_get_time();
+}
+
+/* Receive exactly the request line and the headers, the body stays in the
+ * socket for httpd_req_recv(). Returns the length, 0 when it does not fit
+ * into the scratch buffer, < 0 when the connection is gone. */
+static ssize_t session_read_headers(struct httpd_data_s *hd, int fd)
+{
+    size_t have = 0;
+    while (have < HTTPD_MAX_REQ_HDR_LEN)
+    {
+        ssize_t n = recv(fd, hd->scratch + have, HTTPD_MAX_REQ_HDR_LEN - have,
+                         MSG_PEEK);
+        if (n <= 0)
+        {
+            return -1;
+        }
+        hd->scratch[have + n] = 0;
+        char *end = strstr(hd->scratch + (have > 3 ? have - 3 : 0), "\r\n\r\n");
+        size_t take = end != NULL ? (size_t)(end + 4 - hd->scratch) - have : n;
+        if (recv(fd, hd->scratch + have, take, 0) != (ssize_t)take)
+        {
+            return -1;
+        }
+        have += take;
+        if (end != NULL)
+        {
+            hd->scratch[have] = 0;
+            return have;
+        }
+    }
+    return 0;
+}
+
+static int parse_method(const char *method, size_t len)
+{
+    static const char *const methods[] = {
+        [HTTP_DELETE] = "DELETE", [HTTP_GET] = "GET", [HTTP_HEAD] = "HEAD",
+        [HTTP_POST] = "POST",     [HTTP_PUT] = "PUT",
+    };
+    for (int i = 0; i < sizeof(methods) / sizeof(methods[0]); ++i)
+    {
+        if (strlen(methods[i]) == len && strncmp(methods[i], method, len) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static const httpd_uri_t *find_handler(struct httpd_data_s *hd,
+                                       httpd_req_t *req, bool *uri_match)
+{
+    size_t upto = strcspn(req->uri, "?");
+    *uri_match = false;
+    for (size_t i = 0; i < hd->handler_count; ++i)
+    {
+        const httpd_uri_t *h = &hd->handlers[i];
+        bool match = hd->config.uri_match_fn != NULL
+                         ? hd->config.uri_match_fn(h->uri, req->uri, upto)
+                         : strlen(h->uri) == upto &&
+                               strncmp(h->uri, req->uri, upto) == 0;
+        if (match)
+        {
+            *uri_match = true;
+            if (h->method == req->method)
+            {
+                return h;
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Serve one request, false when the session has to be closed. */
+static bool session_process(struct httpd_data_s *hd,
+                            struct httpd_session_s *sess)
+{
+    httpd_req_t *req = &hd->req;
+    struct httpd_req_aux_s *aux = &hd->aux;
+    struct httpd_resp_hdr_s resp_hdrs[hd->config.max_resp_headers];
+
+    memset(aux, 0, sizeof(*aux));
+    aux->sess = sess;
+    aux->status = "200 OK";
+    aux->content_type = "text/html";
+    aux->resp_hdrs = resp_hdrs;
+    req->handle = hd;
+    req->aux = aux;
+    req->user_ctx = NULL;
+    req->content_len = 0;
+    ((char *)req->uri)[0] = 0;
+
+    ssize_t len = session_read_headers(hd, sess->fd);
+    sess->last_us = esp_timer_get_time();
+    if (len < 0)
+    {
+        return false;
+    }
+    if (len == 0)
+    {
+        httpd_resp_send_err(req, HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE, NULL);
+        return false;
+    }
+
+    // "METHOD URI VERSION\r\n"
+    char *line_end = strstr(hd->scratch, "\r\n");
+    *line_end = 0;
+    aux->headers = line_end + 2;
+    char *uri = strchr(hd->scratch, ' ');
+    char *version = uri != NULL ? strchr(uri + 1, ' ') : NULL;
+    if (version == NULL)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, NULL);
+        return false;
+    }
+    req->method = parse_method(hd->scratch, uri - hd->scratch);
+    if (req->method < 0)
+    {
+        httpd_resp_send_err(req, HTTPD_501_METHOD_NOT_IMPLEMENTED, NULL);
+        return false;
+    }
+    ++uri;
+    ++version;
+    if (version - uri - 1 > HTTPD_MAX_URI_LEN)
+    {
+        httpd_resp_send_err(req, HTTPD_414_URI_TOO_LONG, NULL);
+        return false;
+    }
+    memcpy((char *)req->uri, uri, version - uri - 1);
+    ((char *)req->uri)[version - uri - 1] = 0;
+    if (strcmp(version, "HTTP/1.1") == 0)
+    {
+        char value[16];
+        aux->keep_alive =
+            httpd_req_get_hdr_value_str(req, "Connection", value,
+                                        sizeof(value)) != ESP_OK ||
+            strcasecmp(value, "close") != 0;
+    }
+    else if (strcmp(version, "HTTP/1.0") == 0)
+    {
+        char value[16];
+        aux->keep_alive =
+            httpd_req_get_hdr_value_str(req, "Connection", value,
+                                        sizeof(value)) == ESP_OK &&
+            strcasecmp(value, "keep-alive") == 0;
+    }
+    else
+    {
+        httpd_resp_send_err(req, HTTPD_505_VERSION_NOT_SUPPORTED, NULL);
+        return false;
+    }
+    char value[24];
+    if (httpd_req_get_hdr_value_str(req, "Content-Length", value,
+                                    sizeof(value)) == ESP_OK)
+    {
+        req->content_len = strtoul(value, NULL, 10);
+    }
+    aux->remaining_len = req->content_len;
+
+    bool uri_match;
+    const httpd_uri_t *handler = find_handler(hd, req, &uri_match);
+    esp_err_t err;
+    if (handler == NULL)
+    {
+        err = httpd_resp_send_err(req,
+                                  uri_match ? HTTPD_405_METHOD_NOT_ALLOWED
+                                            : HTTPD_404_NOT_FOUND,
+                                  NULL);
+    }
+    else
+    {
+        req->user_ctx = handler->user_ctx;
+        err = handler->handler(req);
+    }
+    if (err != ESP_OK)
+    {
+        return false;
+    }
+
+    // the next request starts behind the body
+    while (aux->remaining_len > 0)
+    {
+        if (httpd_req_recv(req, hd->scratch, HTTPD_MAX_REQ_HDR_LEN) <= 0)
+        {
+            return false;
+        }
+    }
+    sess->last_us = esp_timer_get_time();
+    return aux->keep_alive;
+}
+
+static void *httpd_thread(void *arg)
+{
+    struct httpd_data_s *hd = arg;
+    pthread_setname_np(pthread_self(), "httpd");
+
+    while (1)
+    {
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(hd->listen_fd, &fds);
+        FD_SET(hd->ctrl_fd[0], &fds);
+        int max_fd = hd->listen_fd > hd->ctrl_fd[0] ? hd->listen_fd
+                                                     : hd->ctrl_fd[0];
+        for (int i = 0; i < hd->config.max_open_sockets; ++i)
+        {
+            int fd = hd->sessions[i].fd;
+            if (fd >= 0)
+            {
+                FD_SET(fd, &fds);
+                max_fd = fd > max_fd ? fd : max_fd;
+            }
+        }
+        if (select(max_fd + 1, &fds, NULL, NULL, NULL) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            ESP_LOGE(TAG, "select failed: %s", strerror(errno));
+            break;
+        }
+        if (FD_ISSET(hd->ctrl_fd[0], &fds))
+        {
+            break;
+        }
+        for (int i = 0; i < hd->config.max_open_sockets; ++i)
+        {
+            struct httpd_session_s *sess = &hd->sessions[i];
+            if (sess->fd >= 0 && FD_ISSET(sess->fd, &fds) &&
+                !session_process(hd, sess))
+            {
+                session_close(sess);
+            }
+        }
+        if (FD_ISSET(hd->listen_fd, &fds))
+        {
+            session_accept(hd);
+        }
+    }
+    return NULL;
+}
+
+static void httpd_free(struct httpd_data_s *hd)
+{
+    if (hd->listen_fd >= 0)
+    {
+        close(hd->listen_fd);
+    }
+    if (hd->ctrl_fd[0] >= 0)
+    {
+        close(hd->ctrl_fd[0]);
+        close(hd->ctrl_fd[1]);
+    }
+    free(hd->handlers);
+    free(hd->sessions);
+    free(hd);
+}
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config)
+{
+    struct httpd_data_s *hd = calloc(1, sizeof(*hd));
+    if (hd == NULL)
+    {
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
+    hd->config = *config;
+    hd->listen_fd = -1;
+    hd->ctrl_fd[0] = -1;
+    hd->handlers = calloc(config->max_uri_handlers, sizeof(httpd_uri_t));
+    hd->sessions =
+        calloc(config->max_open_sockets, sizeof(struct httpd_session_s));
+    if (hd->handlers == NULL || hd->sessions == NULL)
+    {
+        httpd_free(hd);
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
+    for (int i = 0; i < config->max_open_sockets; ++i)
+    {
+        hd->sessions[i].fd = -1;
+    }
+
+    // IPv6 with mapped IPv4 peers, as on the device
+    struct sockaddr_in6 addr = {
+        .sin6_family = AF_INET6,
+        .sin6_addr = in6addr_any,
+        .sin6_port = htons(config->server_port),
+    };
+    int off = 0;
+    int on = 1;
+    hd->listen_fd = socket(AF_INET6, SOCK_STREAM, 0);
+    if (hd->listen_fd < 0 ||
+        setsockopt(hd->listen_fd, IPPROTO_IPV6, IPV6_V6ONLY, &off,
+                   sizeof(off)) != 0 ||
+        setsockopt(hd->listen_fd, SOL_SOCKET, SO_REUSEADDR, &on,
+                   sizeof(on)) != 0 ||
+        bind(hd->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(hd->listen_fd, config->backlog_conn) != 0 ||
+        pipe(hd->ctrl_fd) != 0)
+    {
+        ESP_LOGE(TAG, "port %d: %s", config->server_port, strerror(errno));
+        httpd_free(hd);
+        return ESP_ERR_HTTPD_TASK;
+    }
+    if (pthread_create(&hd->thread, NULL, httpd_thread, hd) != 0)
+    {
+        httpd_free(hd);
+        return ESP_ERR_HTTPD_TASK;
+    }
+    *handle = hd;
+    return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle)
+{
+    struct httpd_data_s *hd = handle;
+    if (hd == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    char stop = 0;
+    if (write(hd->ctrl_fd[1], &stop, 1) != 1)
+    {
+        return ESP_FAIL;
+    }
+    pthread_join(hd->thread, NULL);
+    for (int i = 0; i < hd->config.max_open_sockets; ++i)
+    {
+        if (hd->sessions[i].fd >= 0)
+        {
+            session_close(&hd->sessions[i]);
+        }
+    }
+    httpd_free(hd);
+    return ESP_OK;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle,
+                                     const httpd_uri_t *uri_handler)
+{
+    struct httpd_data_s *hd = handle;
+    if (hd->handler_count == hd->config.max_uri_handlers)
+    {
+        return ESP_ERR_HTTPD_HANDLERS_FULL;
+    }
+    hd->handlers[hd->handler_count++] = *uri_handler;
+    return ESP_OK;
+}
+
+/* A trailing '*' matches any rest, a trailing '?' makes the character before
+ * it optional. */
+bool httpd_uri_match_wildcard(const char *uri_template,
+                              const char *uri_to_match, size_t match_upto)
+{
+    size_t len = strlen(uri_template);
+    bool asterisk = len > 0 && uri_template[len - 1] == '*';
+    if (asterisk)
+    {
+        --len;
+    }
+    bool quest = len > 0 && uri_template[len - 1] == '?';
+    if (quest)
+    {
+        --len;
+    }
+    if (match_upto >= len && strncmp(uri_template, uri_to_match, len) == 0)
+    {
+        return asterisk || match_upto == len;
+    }
+    // without the optional character
+    return quest && match_upto >= len - 1 &&
+           strncmp(uri_template, uri_to_match, len - 1) == 0 &&
+           (asterisk || match_upto == len - 1);
+}
+
+int httpd_req_to_sockfd(httpd_req_t *r)
+{
+    return ((struct httpd_req_aux_s *)r->aux)->sess->fd;
+}
+
+int httpd_req_recv(httpd_req_t *r, char *buf, size_t buf_len)
+{
+    struct httpd_req_aux_s *aux = r->aux;
+    if (aux->remaining_len == 0 || buf_len == 0)
+    {
+        return 0;
+    }
+    if (buf_len > aux->remaining_len)
+    {
+        buf_len = aux->remaining_len;
+    }
+    ssize_t n = recv(aux->sess->fd, buf, buf_len, 0);
+    if (n < 0)
+    {
+        return errno == EAGAIN || errno == EWOULDBLOCK ? HTTPD_SOCK_ERR_TIMEOUT
+                                                       : HTTPD_SOCK_ERR_FAIL;
+    }
+    aux->remaining_len -= n;
+    return n;
+}
+
+static const char *find_hdr(httpd_req_t *r, const char *field, size_t *len)
+{
+    const char *line = ((struct httpd_req_aux_s *)r->aux)->headers;
+    size_t field_len = strlen(field);
+    while (line != NULL && *line != 0 && *line != '\r')
+    {
+        if (strncasecmp(line, field, field_len) == 0 && line[field_len] == ':')
+        {
+            const char *value = line + field_len + 1;
+            value += strspn(value, " \t");
+            *len = strcspn(value, "\r\n");
+            return value;
+        }
+        line = strstr(line, "\r\n");
+        line = line != NULL ? line + 2 : NULL;
+    }
+    return NULL;
+}
+
+size_t httpd_req_get_hdr_value_len(httpd_req_t *r, const char *field)
+{
+    size_t len = 0;
+    return find_hdr(r, field, &len) != NULL ? len : 0;
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *r, const char *field,
+                                      char *val, size_t val_size)
+{
+    size_t len;
+    const char *value = find_hdr(r, field, &len);
+    if (value == NULL)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (val_size == 0)
+    {
+        return ESP_ERR_HTTPD_RESULT_TRUNC;
+    }
+    size_t n = len < val_size - 1 ? len : val_size - 1;
+    memcpy(val, value, n);
+    val[n] = 0;
+    return n < len ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+}
+
+size_t httpd_req_get_url_query_len(httpd_req_t *r)
+{
+    const char *query = strchr(r->uri, '?');
+    return query != NULL ? strlen(query + 1) : 0;
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t *r, char *buf,
+                                      size_t buf_len)
+{
+    const char *query = strchr(r->uri, '?');
+    if (query == NULL)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return strlcpy(buf, query + 1, buf_len) < buf_len
+               ? ESP_OK
+               : ESP_ERR_HTTPD_RESULT_TRUNC;
+}
+
+esp_err_t httpd_query_key_value(const char *qry, const char *key, char *val,
+                                size_t val_size)
+{
+    size_t key_len = strlen(key);
+    while (*qry != 0)
+    {
+        const char *end = qry + strcspn(qry, "&");
+        const char *eq = memchr(qry, '=', end - qry);
+        if (eq != NULL && (size_t)(eq - qry) == key_len &&
+            strncasecmp(qry, key, key_len) == 0)
+        {
+            size_t len = end - eq - 1;
+            if (val_size == 0)
+            {
+                return ESP_ERR_HTTPD_RESULT_TRUNC;
+            }
+            size_t n = len < val_size - 1 ? len : val_size - 1;
+            memcpy(val, eq + 1, n);
+            val[n] = 0;
+            return n < len ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+        }
+        qry = *end != 0 ? end + 1 : end;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status)
+{
+    ((struct httpd_req_aux_s *)r->aux)->status = status;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type)
+{
+    ((struct httpd_req_aux_s *)r->aux)->content_type = type;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field,
+                             const char *value)
+{
+    struct httpd_req_aux_s *aux = r->aux;
+    struct httpd_data_s *hd = r->handle;
+    if (aux->resp_hdr_count == hd->config.max_resp_headers)
+    {
+        return ESP_ERR_HTTPD_RESP_HDR;
+    }
+    aux->resp_hdrs[aux->resp_hdr_count].field = field;
+    aux->resp_hdrs[aux->resp_hdr_count].value = value;
+    aux->resp_hdr_count++;
+    return ESP_OK;
+}
+
+/* status line and headers, length < 0 for a chunked body */
+static size_t resp_format_headers(httpd_req_t *r, char *buf, size_t size,
+                                  ssize_t length)
+{
+    struct httpd_req_aux_s *aux = r->aux;
+    size_t len = snprintf(buf, size, "HTTP/1.1 %s\r\nContent-Type: %s\r\n",
+                          aux->status, aux->content_type);
+    if (length < 0)
+    {
+        len += snprintf(buf + len, size - len,
+                        "Transfer-Encoding: chunked\r\n");
+    }
+    else
+    {
+        len += snprintf(buf + len, size - len, "Content-Length: %zd\r\n",
+                        length);
+    }
+    if (!aux->keep_alive)
+    {
+        len += snprintf(buf + len, size - len, "Connection: close\r\n");
+    }
+    for (size_t i = 0; i < aux->resp_hdr_count && len < size; ++i)
+    {
+        len += snprintf(buf + len, size - len, "%s: %s\r\n",
+                        aux->resp_hdrs[i].field, aux->resp_hdrs[i].value);
+    }
+    len += snprintf(buf + len, size - len, "\r\n");
+    return len < size ? len : size - 1;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+    if (buf_len == HTTPD_RESP_USE_STRLEN)
+    {
+        buf_len = buf != NULL ? strlen(buf) : 0;
+    }
+    char hdr[RESP_HDR_MAX];
+    struct iovec iov[2] = {
+        {.iov_base = hdr,
+         .iov_len = resp_format_headers(r, hdr, sizeof(hdr), buf_len)},
+        {.iov_base = (void *)buf, .iov_len = buf_len},
+    };
+    return send_all(httpd_req_to_sockfd(r), iov, buf_len > 0 ? 2 : 1);
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf,
+                                ssize_t buf_len)
+{
+    struct httpd_req_aux_s *aux = r->aux;
+    if (buf_len == HTTPD_RESP_USE_STRLEN)
+    {
+        buf_len = buf != NULL ? strlen(buf) : 0;
+    }
+    char hdr[RESP_HDR_MAX];
+    size_t hdr_len = 0;
+    if (!aux->chunked)
+    {
+        hdr_len = resp_format_headers(r, hdr, sizeof(hdr), -1);
+        aux->chunked = true;
+    }
+    char size[24];
+    struct iovec iov[4] = {
+        {.iov_base = hdr, .iov_len = hdr_len},
+        {.iov_base = size,
+         .iov_len = snprintf(size, sizeof(size), "%zx\r\n", buf_len)},
+        {.iov_base = (void *)buf, .iov_len = buf_len},
+        {.iov_base = "\r\n", .iov_len = 2},
+    };
+    return send_all(httpd_req_to_sockfd(r), iov, 4);
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error,
+                              const char *msg)
+{
+    if (error < 0 || error >= HTTPD_ERR_CODE_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    httpd_resp_set_status(req, err_codes[error].status);
+    httpd_resp_set_type(req, "text/html");
+    return httpd_resp_send(req, msg != NULL ? msg : err_codes[error].msg,
+                           HTTPD_RESP_USE_STRLEN);
+}
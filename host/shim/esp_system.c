@@ -0,0 +1,155 @@
+#include <malloc.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "hal/cpu_hal.h"
+#include "lwip/sockets.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+uint16_t modelcar_host_http_port = 8080;
+uint16_t modelcar_host_dns_port = 5353;
+
+static esp_log_level_t log_level = ESP_LOG_INFO;
+static int64_t start_us;
+static uint32_t heap_free_min = UINT32_MAX;
+
+static int64_t monotonic_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+__attribute__((constructor)) static void esp_system_start(void)
+{
+    start_us = monotonic_us();
+}
+
+int64_t esp_timer_get_time(void) { return monotonic_us() - start_us; }
+
+uint32_t cpu_hal_get_cycle_count(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return (uint32_t)__rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ull + ts.tv_nsec);
+#endif
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    log_level = level;
+}
+
+uint32_t esp_log_timestamp(void) { return esp_timer_get_time() / 1000; }
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format,
+                   ...)
+{
+    if (level > log_level)
+    {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:
+        return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:
+        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:
+        return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_NVS_NOT_FOUND:
+        return "ESP_ERR_NVS_NOT_FOUND";
+    case ESP_ERR_HTTPD_RESULT_TRUNC:
+        return "ESP_ERR_HTTPD_RESULT_TRUNC";
+    default:
+        return "UNKNOWN ERROR";
+    }
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    struct mallinfo2 info = mallinfo2();
+    uint32_t free_bytes = info.fordblks;
+    if (free_bytes < heap_free_min)
+    {
+        heap_free_min = free_bytes;
+    }
+    return free_bytes;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    esp_get_free_heap_size();
+    return heap_free_min;
+}
+
+void esp_restart(void)
+{
+    ESP_LOGW("modelcar host", "restart requested, exiting");
+    exit(0);
+}
+
+esp_netif_t *esp_netif_get_handle_from_ifkey(const char *if_key)
+{
+    // never dereferenced
+    static char ap;
+    return (esp_netif_t *)&ap;
+}
+
+esp_err_t esp_netif_get_ip_info(esp_netif_t *esp_netif,
+                                esp_netif_ip_info_t *ip_info)
+{
+    memset(ip_info, 0, sizeof(*ip_info));
+    ip_info->ip.addr = inet_addr(CONFIG_ESP_WIFI_IP);
+    ip_info->netmask.addr = inet_addr(CONFIG_ESP_WIFI_NETMASK);
+    ip_info->gw.addr = ip_info->ip.addr;
+    return ESP_OK;
+}
+
+#if !HAVE_STRLCPY
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size > 0)
+    {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = 0;
+    }
+    return len;
+}
+#endif
@@ -0,0 +1,164 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_timer.h"
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+struct host_task_s
+{
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+    char name[16];
+};
+
+static void *task_main(void *arg)
+{
+    struct host_task_s *task = arg;
+    pthread_setname_np(pthread_self(), task->name);
+    task->fn(task->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack,
+                       void *arg, UBaseType_t prio, TaskHandle_t *handle)
+{
+    // lives as long as the task, tasks of the portal never end
+    struct host_task_s *task = calloc(1, sizeof(*task));
+    if (task == NULL)
+    {
+        return pdFAIL;
+    }
+    task->fn = fn;
+    task->arg = arg;
+    strncpy(task->name, name, sizeof(task->name) - 1);
+    if (pthread_create(&task->thread, NULL, task_main, task) != 0)
+    {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    if (handle != NULL)
+    {
+        *handle = task;
+    }
+    return pdPASS;
+}
+
+TaskHandle_t xTaskCreateStatic(TaskFunction_t fn, const char *name,
+                               uint32_t stack, void *arg, UBaseType_t prio,
+                               StackType_t *stack_buffer,
+                               StaticTask_t *task_buffer)
+{
+    TaskHandle_t handle = NULL;
+    xTaskCreate(fn, name, stack, arg, prio, &handle);
+    return handle;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = {
+        .tv_sec = ticks / 1000,
+        .tv_nsec = (long)(ticks % 1000) * 1000000,
+    };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+    {
+    }
+}
+
+TickType_t xTaskGetTickCount(void) { return esp_timer_get_time() / 1000; }
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) { return 0; }
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    StaticEventGroup_t *buffer = malloc(sizeof(*buffer));
+    return buffer != NULL ? xEventGroupCreateStatic(buffer) : NULL;
+}
+
+EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t *buffer)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&buffer->lock, NULL);
+    pthread_cond_init(&buffer->changed, &attr);
+    pthread_condattr_destroy(&attr);
+    buffer->bits = 0;
+    return buffer;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    pthread_mutex_lock(&group->lock);
+    group->bits |= bits;
+    EventBits_t result = group->bits;
+    pthread_cond_broadcast(&group->changed);
+    pthread_mutex_unlock(&group->lock);
+    return result;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    pthread_mutex_lock(&group->lock);
+    EventBits_t result = group->bits;
+    group->bits &= ~bits;
+    pthread_mutex_unlock(&group->lock);
+    return result;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    pthread_mutex_lock(&group->lock);
+    EventBits_t result = group->bits;
+    pthread_mutex_unlock(&group->lock);
+    return result;
+}
+
+static bool event_group_done(EventGroupHandle_t group, EventBits_t bits,
+                             BaseType_t all)
+{
+    return all ? (group->bits & bits) == bits : (group->bits & bits) != 0;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits,
+                                BaseType_t clear, BaseType_t all,
+                                TickType_t ticks)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += ticks / 1000;
+    deadline.tv_nsec += (long)(ticks % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&group->lock);
+    while (!event_group_done(group, bits, all))
+    {
+        if (ticks == portMAX_DELAY)
+        {
+            pthread_cond_wait(&group->changed, &group->lock);
+        }
+        else if (pthread_cond_timedwait(&group->changed, &group->lock,
+                                        &deadline) == ETIMEDOUT)
+        {
+            break;
+        }
+    }
+    EventBits_t result = group->bits;
+    if (clear && event_group_done(group, bits, all))
+    {
+        group->bits &= ~bits;
+    }
+    pthread_mutex_unlock(&group->lock);
+    return result;
+}
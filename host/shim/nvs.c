@@ -0,0 +1,139 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "nvs_flash.h"
+
+#define NVS_ENTRIES 32
+#define NVS_KEY_MAX 16
+
+struct nvs_entry_s
+{
+    char key[NVS_KEY_MAX];
+    void *value;
+    size_t length;
+};
+
+uint32_t modelcar_host_nvs_commit_us;
+
+static struct nvs_entry_s entries[NVS_ENTRIES];
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+esp_err_t nvs_flash_init(void) { return ESP_OK; }
+
+esp_err_t nvs_flash_erase(void)
+{
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < NVS_ENTRIES; ++i)
+    {
+        free(entries[i].value);
+    }
+    memset(entries, 0, sizeof(entries));
+    pthread_mutex_unlock(&lock);
+    return ESP_OK;
+}
+
+// a single namespace is all the firmware uses
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode,
+                   nvs_handle_t *handle)
+{
+    *handle = 1;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {}
+
+static struct nvs_entry_s *nvs_find(const char *key, bool create)
+{
+    struct nvs_entry_s *free_entry = NULL;
+    for (int i = 0; i < NVS_ENTRIES; ++i)
+    {
+        if (strncmp(entries[i].key, key, NVS_KEY_MAX) == 0)
+        {
+            return &entries[i];
+        }
+        if (free_entry == NULL && entries[i].key[0] == 0)
+        {
+            free_entry = &entries[i];
+        }
+    }
+    if (create && free_entry != NULL)
+    {
+        strncpy(free_entry->key, key, NVS_KEY_MAX - 1);
+        return free_entry;
+    }
+    return NULL;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *value,
+                       size_t *length)
+{
+    pthread_mutex_lock(&lock);
+    struct nvs_entry_s *entry = nvs_find(key, false);
+    esp_err_t err = ESP_ERR_NVS_NOT_FOUND;
+    if (entry != NULL)
+    {
+        err = ESP_OK;
+        if (value != NULL)
+        {
+            if (*length < entry->length)
+            {
+                err = ESP_ERR_INVALID_SIZE;
+            }
+            else
+            {
+                memcpy(value, entry->value, entry->length);
+            }
+        }
+        *length = entry->length;
+    }
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value,
+                       size_t length)
+{
+    void *copy = malloc(length);
+    if (copy == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(copy, value, length);
+
+    pthread_mutex_lock(&lock);
+    struct nvs_entry_s *entry = nvs_find(key, true);
+    if (entry == NULL)
+    {
+        pthread_mutex_unlock(&lock);
+        free(copy);
+        return ESP_ERR_NVS_NO_FREE_PAGES;
+    }
+    free(entry->value);
+    entry->value = copy;
+    entry->length = length;
+    pthread_mutex_unlock(&lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *value)
+{
+    size_t length = sizeof(*value);
+    return nvs_get_blob(handle, key, value, &length);
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value)
+{
+    return nvs_set_blob(handle, key, &value, sizeof(value));
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    if (modelcar_host_nvs_commit_us > 0)
+    {
+        usleep(modelcar_host_nvs_commit_us);
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,111 @@
+/* DHCP server of the AP, see main/dhcp.h */
+#include <stdint.h>
+#include <string.h>
+
+#include "dhcp.h"
+#include "net.h"
+#include "portal.h"
+
+#include "check.h"
+
+static uint8_t query[MODELCAR_NET_PACKET_LEN];
+static uint8_t reply[MODELCAR_NET_PACKET_LEN];
+
+static size_t build(uint8_t type, uint8_t mac_last, const uint8_t *requested)
+{
+    memset(query, 0, sizeof(query));
+    query[0] = 1; // BOOTREQUEST
+    query[1] = 1;
+    query[2] = 6;
+    memcpy(&query[4], "\x12\x34\x56\x78", 4);
+    memcpy(&query[28], "\x02\x00\x00\x00\x00", 5);
+    query[33] = mac_last;
+    memcpy(&query[236], "\x63\x82\x53\x63", 4);
+    uint8_t *p = &query[240];
+    *p++ = 53;
+    *p++ = 1;
+    *p++ = type;
+    if (requested != NULL)
+    {
+        *p++ = 50;
+        *p++ = 4;
+        memcpy(p, requested, 4);
+        p += 4;
+    }
+    *p++ = 255;
+    return p - query;
+}
+
+/* the data of option code in the reply, NULL if missing */
+static const uint8_t *option(size_t len, uint8_t code, uint8_t *opt_len)
+{
+    for (size_t i = 240; i + 1 < len && reply[i] != 255; i += 2 + reply[i + 1])
+    {
+        if (reply[i] == code)
+        {
+            *opt_len = reply[i + 1];
+            return &reply[i + 2];
+        }
+    }
+    return NULL;
+}
+
+static void test_lease(void)
+{
+    const uint8_t offered[4] = {192, 168, 0, 2};
+    uint8_t opt_len = 0;
+
+    size_t len = modelcar_dhcp_reply(query, build(1, 1, NULL), reply);
+    CHECK(len >= 300);
+    CHECK_INT(reply[0], 2);
+    CHECK(memcmp(&reply[4], "\x12\x34\x56\x78", 4) == 0);
+    CHECK(memcmp(&reply[16], offered, 4) == 0);
+    const uint8_t *type = option(len, 53, &opt_len);
+    CHECK(type != NULL && *type == 2);
+    const uint8_t *url = option(len, 114, &opt_len);
+    CHECK(url != NULL && opt_len == strlen(MODELCAR_PORTAL_API_URL) &&
+          memcmp(url, MODELCAR_PORTAL_API_URL, opt_len) == 0);
+
+    // the offered address is acknowledged
+    len = modelcar_dhcp_reply(query, build(3, 1, offered), reply);
+    type = option(len, 53, &opt_len);
+    CHECK(type != NULL && *type == 5);
+    CHECK(memcmp(&reply[16], offered, 4) == 0);
+    CHECK(option(len, 114, &opt_len) != NULL);
+
+    // a second station gets the next address, not the one taken
+    len = modelcar_dhcp_reply(query, build(3, 2, offered), reply);
+    type = option(len, 53, &opt_len);
+    CHECK(type != NULL && *type == 6);
+    CHECK(option(len, 114, &opt_len) == NULL);
+    len = modelcar_dhcp_reply(query, build(1, 2, NULL), reply);
+    CHECK_INT(reply[19], 3);
+
+    // released addresses are handed out again
+    CHECK_INT(modelcar_dhcp_reply(query, build(7, 1, NULL), reply), 0);
+    len = modelcar_dhcp_reply(query, build(1, 3, offered), reply);
+    CHECK(memcmp(&reply[16], offered, 4) == 0);
+}
+
+static void test_reject(void)
+{
+    // requests for another server and malformed messages stay unanswered
+    size_t len = build(3, 1, NULL);
+    memcpy(&query[len - 1], "\x36\x04\x0a\x00\x00\x01\xff", 7);
+    CHECK_INT(modelcar_dhcp_reply(query, len + 6, reply), 0);
+    len = build(1, 1, NULL);
+    query[236] = 0;
+    CHECK_INT(modelcar_dhcp_reply(query, len, reply), 0);
+    CHECK_INT(modelcar_dhcp_reply(query, 100, reply), 0);
+    len = build(1, 1, NULL);
+    query[241] = 200; // option runs past the end
+    CHECK_INT(modelcar_dhcp_reply(query, len, reply), 0);
+}
+
+int main(void)
+{
+    modelcar_dhcp_init();
+    test_lease();
+    test_reject();
+    return check_failed();
+}
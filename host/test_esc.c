@@ -0,0 +1,68 @@
+/* One-shot ESC pulse timings, see main/esc.h */
+#include <stdint.h>
+
+#include "esc.h"
+
+#include "check.h"
+
+/* output duties of 1000, 1500 and 2000 us servo pulses */
+static const uint32_t duties[] = {409, 614, 819};
+
+static double ticks_us(modelcar_esc_protocol_t protocol, uint32_t duty)
+{
+    return (double)modelcar_esc_ticks(protocol, duty) /
+           MODELCAR_ESC_TICKS_PER_US;
+}
+
+static void test_oneshot125(void)
+{
+    const modelcar_esc_protocol_t p = MODELCAR_ESC_ONESHOT125;
+    CHECK_INT(modelcar_esc_ticks(p, duties[0]), 9985);
+    CHECK_INT(modelcar_esc_ticks(p, duties[1]), 14990);
+    CHECK_INT(modelcar_esc_ticks(p, duties[2]), 19995);
+    // a duty step is 2.44 us of servo pulse and 0.31 us of OneShot125
+    CHECK_NEAR(ticks_us(p, duties[0]), 125, 0.5);
+    CHECK_NEAR(ticks_us(p, duties[1]), 187.5, 0.5);
+    CHECK_NEAR(ticks_us(p, duties[2]), 250, 0.5);
+}
+
+static void test_oneshot42(void)
+{
+    const modelcar_esc_protocol_t p = MODELCAR_ESC_ONESHOT42;
+    CHECK_INT(modelcar_esc_ticks(p, duties[0]), 3328);
+    CHECK_INT(modelcar_esc_ticks(p, duties[1]), 4996);
+    CHECK_INT(modelcar_esc_ticks(p, duties[2]), 6664);
+    CHECK_NEAR(ticks_us(p, duties[0]), 41.667, 0.2);
+    CHECK_NEAR(ticks_us(p, duties[1]), 62.5, 0.2);
+    CHECK_NEAR(ticks_us(p, duties[2]), 83.333, 0.2);
+}
+
+static void test_clamp(void)
+{
+    // never zero, the zero length half ends the RMT transmission
+    CHECK_INT(modelcar_esc_ticks(MODELCAR_ESC_ONESHOT125, 0), 1);
+    CHECK_INT(modelcar_esc_ticks(MODELCAR_ESC_ONESHOT42, 0), 1);
+    // at most one RMT item
+    CHECK_INT(modelcar_esc_ticks(MODELCAR_ESC_ONESHOT125, 8191), 32767);
+    CHECK_INT(modelcar_esc_ticks(MODELCAR_ESC_ONESHOT42, 8191), 32767);
+}
+
+static void test_pwm(void)
+{
+    // servo pulses are longer than an item, PWM stays on the LEDC
+    for (int i = 0; i < 3; ++i)
+    {
+        CHECK_INT(modelcar_esc_ticks(MODELCAR_ESC_PWM, duties[i]), 0);
+    }
+    CHECK_INT(modelcar_esc_ticks(MODELCAR_ESC_PWM, 0), 0);
+    CHECK_INT(modelcar_esc_ticks(MODELCAR_ESC_PROTOCOLS, duties[1]), 0);
+}
+
+int main(void)
+{
+    test_oneshot125();
+    test_oneshot42();
+    test_clamp();
+    test_pwm();
+    return check_failed();
+}
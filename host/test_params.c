@@ -0,0 +1,123 @@
+/* Profile parameter table, see main/params.h */
+#include <stddef.h>
+#include <string.h>
+
+#include "params.h"
+
+#include "check.h"
+
+static const modelcar_param_t *lookup(const char *name)
+{
+    return modelcar_param_lookup(name, strlen(name));
+}
+
+static void test_lookup(void)
+{
+    // every parameter is found under its own name only
+    for (size_t i = 0; i < modelcar_params_count; ++i)
+    {
+        CHECK(lookup(modelcar_params[i].name) == &modelcar_params[i]);
+    }
+    CHECK(lookup("servo1_factor")->offset ==
+          offsetof(modelcar_params_t, servo1_factor));
+    CHECK(lookup("servo3_factor") == NULL);
+    CHECK(lookup("servo1_facto") == NULL);
+    CHECK(lookup("servo1_factorx") == NULL);
+    CHECK(lookup("") == NULL);
+    // the name needs no terminator, as in a query string
+    const char *query = "servo2_expo=0.5&servo1_limit=1";
+    CHECK(modelcar_param_lookup(query, strlen("servo2_expo")) ==
+          lookup("servo2_expo"));
+    CHECK(modelcar_param_lookup(query, strlen("servo2_exp")) == NULL);
+}
+
+static void test_default(void)
+{
+    modelcar_params_t params;
+    modelcar_params_default(&params);
+    CHECK_NEAR(params.servo1_factor, 1, 0);
+    CHECK_INT(params.servo2_offset, 0);
+    CHECK_NEAR(params.servo1_expo, 0, 0);
+    CHECK_INT(params.servo1_curve.count, 0);
+    CHECK_INT(params.servo2_brake, 0);
+}
+
+static void test_parse(void)
+{
+    modelcar_params_t params;
+    modelcar_params_default(&params);
+    const modelcar_param_t *factor = lookup("servo1_factor");
+    const modelcar_param_t *offset = lookup("servo2_offset");
+
+    CHECK_INT(modelcar_param_parse(factor, &params, "0.5"), 0);
+    CHECK_NEAR(params.servo1_factor, 0.5, 1e-6);
+    CHECK_INT(modelcar_param_parse(offset, &params, "-25"), 0);
+    CHECK_INT(params.servo2_offset, -25);
+
+    // clamped to the range of params.def
+    CHECK_INT(modelcar_param_parse(factor, &params, "3"), 0);
+    CHECK_NEAR(params.servo1_factor, 1, 0);
+    CHECK_INT(modelcar_param_parse(factor, &params, "0"), 0);
+    CHECK_NEAR(params.servo1_factor, 0.05, 1e-6);
+    CHECK_INT(modelcar_param_parse(offset, &params, "1000"), 0);
+    CHECK_INT(params.servo2_offset, 400);
+    CHECK_INT(modelcar_param_parse(offset, &params, "-1000"), 0);
+    CHECK_INT(params.servo2_offset, -400);
+
+    // rejected, the value stays
+    modelcar_param_parse(factor, &params, "0.5");
+    CHECK_INT(modelcar_param_parse(factor, &params, "nan"), -1);
+    CHECK_INT(modelcar_param_parse(factor, &params, "-NaN"), -1);
+    CHECK_INT(modelcar_param_parse(factor, &params, "inf"), -1);
+    CHECK_INT(modelcar_param_parse(factor, &params, "-inf"), -1);
+    CHECK_INT(modelcar_param_parse(factor, &params, "1e40"), -1);
+    CHECK_INT(modelcar_param_parse(factor, &params, "abc"), -1);
+    CHECK_INT(modelcar_param_parse(factor, &params, ""), -1);
+    CHECK_NEAR(params.servo1_factor, 0.5, 1e-6);
+    CHECK_INT(modelcar_param_parse(offset, &params, "nan"), -1);
+    CHECK_INT(params.servo2_offset, -400);
+
+    const modelcar_param_t *curve = lookup("servo1_curve");
+    CHECK_INT(modelcar_param_parse(curve, &params, "-1:-1,0:0.2,1:1"), 0);
+    CHECK_INT(params.servo1_curve.count, 3);
+    CHECK_INT(modelcar_param_parse(curve, &params, "nan:0,1:1"), -1);
+    CHECK_INT(modelcar_param_parse(curve, &params, "-1:nan,1:1"), -1);
+    CHECK_INT(params.servo1_curve.count, 3);
+}
+
+static void test_format(void)
+{
+    modelcar_params_t params;
+    modelcar_params_default(&params);
+    char buf[MODELCAR_CURVE_PARAM_MAX];
+
+    modelcar_param_parse(lookup("servo2_limit"), &params, "0.75");
+    modelcar_param_format(lookup("servo2_limit"), &params, buf, sizeof(buf));
+    CHECK(strcmp(buf, "0.75") == 0);
+    modelcar_param_parse(lookup("servo1_offset"), &params, "-30");
+    modelcar_param_format(lookup("servo1_offset"), &params, buf, sizeof(buf));
+    CHECK(strcmp(buf, "-30") == 0);
+    modelcar_param_parse(lookup("servo2_curve"), &params, "-1:-1,1:0.5");
+    modelcar_param_format(lookup("servo2_curve"), &params, buf, sizeof(buf));
+    CHECK(strcmp(buf, "-1.00:-1.00,1.00:0.50") == 0);
+}
+
+static void test_size_valid(void)
+{
+    // profiles stored before a parameter was appended
+    CHECK(modelcar_params_size_valid(sizeof(modelcar_params_t)));
+    size_t before_slew = offsetof(modelcar_params_t, servo2_accel);
+    CHECK(modelcar_params_size_valid(before_slew));
+    CHECK(!modelcar_params_size_valid(0));
+    CHECK(!modelcar_params_size_valid(sizeof(modelcar_params_t) + 4));
+}
+
+int main(void)
+{
+    test_lookup();
+    test_default();
+    test_parse();
+    test_format();
+    test_size_valid();
+    return check_failed();
+}
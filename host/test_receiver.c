@@ -0,0 +1,152 @@
+/* Receiver signal statistics, see main/receiver.h */
+#include <stdint.h>
+
+#include "receiver.h"
+
+#include "check.h"
+
+#define FRAME_US 20000
+
+static uint32_t fall_us;
+
+/* a pulse of width us that rises period us after the previous one */
+static void pulse(uint32_t period, uint32_t width)
+{
+    static uint32_t rise_us = 1000;
+    rise_us += period;
+    fall_us = rise_us + width;
+    modelcar_receiver_sample(0, width, fall_us);
+}
+
+static void summarize(modelcar_receiver_channel_t *stats,
+                      modelcar_receiver_summary_t *summary)
+{
+    modelcar_receiver_get(0, stats);
+    modelcar_receiver_summarize(stats, summary);
+}
+
+/* the statistics are cleared by the first pulse after a reset */
+static void restart(void) { modelcar_receiver_reset(); }
+
+static void test_empty(void)
+{
+    modelcar_receiver_channel_t stats;
+    modelcar_receiver_summary_t summary;
+    restart();
+    summarize(&stats, &summary);
+    CHECK_INT(stats.pulses, 0);
+    CHECK_INT(summary.score, -1);
+}
+
+static void test_clean(void)
+{
+    modelcar_receiver_channel_t stats;
+    modelcar_receiver_summary_t summary;
+    restart();
+    for (int i = 0; i < 100; ++i)
+    {
+        pulse(FRAME_US, 1500);
+    }
+    summarize(&stats, &summary);
+    CHECK_INT(stats.pulses, 100);
+    CHECK_INT(stats.periods, 99);
+    CHECK_INT(stats.gaps, 0);
+    CHECK_INT(stats.gap_max_us, FRAME_US);
+    CHECK_INT(stats.width_hist[(1500 - MODELCAR_PULSE_MIN_US) /
+                               MODELCAR_RECEIVER_WIDTH_BIN_US],
+              100);
+    CHECK_INT(summary.period_us, FRAME_US);
+    CHECK_NEAR(summary.period_jitter_us, 0, 0.01);
+    CHECK_NEAR(summary.width_noise_us, 0, 0.01);
+    CHECK_INT(summary.score, 100);
+}
+
+static void test_jitter(void)
+{
+    modelcar_receiver_channel_t stats;
+    modelcar_receiver_summary_t summary;
+    restart();
+    pulse(FRAME_US, 1500);
+    for (int i = 0; i < 100; ++i)
+    {
+        pulse(i % 2 ? FRAME_US + 100 : FRAME_US - 100, 1500);
+    }
+    summarize(&stats, &summary);
+    CHECK_INT(summary.period_us, FRAME_US);
+    CHECK_NEAR(summary.period_jitter_us, 100, 0.5);
+    CHECK_INT(stats.gaps, 0);
+    // frame jitter alone costs nothing
+    CHECK_INT(summary.score, 100);
+}
+
+static void test_gap(void)
+{
+    modelcar_receiver_channel_t stats;
+    modelcar_receiver_summary_t summary;
+    restart();
+    for (int i = 0; i < 50; ++i)
+    {
+        pulse(FRAME_US, 1500);
+    }
+    // two frames lost
+    pulse(3 * FRAME_US, 1500);
+    for (int i = 0; i < 48; ++i)
+    {
+        pulse(FRAME_US, 1500);
+    }
+    summarize(&stats, &summary);
+    CHECK_INT(stats.gaps, 1);
+    CHECK_INT(stats.gap_max_us, 3 * FRAME_US);
+    CHECK_INT(stats.periods, 97);
+    // the gap stays out of the average and the jitter
+    CHECK_INT(summary.period_us, FRAME_US);
+    CHECK_NEAR(summary.period_jitter_us, 0, 0.01);
+    CHECK_NEAR(summary.gap_permille, 1000.0 / 99, 0.01);
+    CHECK_INT(summary.score, 80);
+}
+
+static void test_glitch(void)
+{
+    modelcar_receiver_channel_t stats;
+    modelcar_receiver_summary_t summary;
+    restart();
+    for (int i = 0; i < 99; ++i)
+    {
+        pulse(FRAME_US, 1500);
+    }
+    modelcar_receiver_sample(0, MODELCAR_PULSE_MIN_US - 1, fall_us + 100);
+    modelcar_receiver_sample(0, MODELCAR_PULSE_MAX_US + 1, fall_us + 200);
+    summarize(&stats, &summary);
+    CHECK_INT(stats.pulses, 99);
+    CHECK_INT(stats.glitches, 2);
+    CHECK_NEAR(summary.glitch_permille, 2000.0 / 101, 0.01);
+    // 2 points per permille
+    CHECK_INT(summary.score, 60);
+}
+
+static void test_noise(void)
+{
+    modelcar_receiver_channel_t stats;
+    modelcar_receiver_summary_t summary;
+    restart();
+    for (int i = 0; i < 100; ++i)
+    {
+        pulse(FRAME_US, i % 2 ? 1510 : 1500);
+    }
+    summarize(&stats, &summary);
+    // consecutive widths 10 us apart, sqrt(10^2 / 2)
+    CHECK_NEAR(summary.width_noise_us, 7.07, 0.01);
+    // 3 points per us over the first 2
+    CHECK_INT(summary.score, 85);
+}
+
+int main(void)
+{
+    test_empty();
+    test_clean();
+    test_jitter();
+    test_gap();
+    test_glitch();
+    test_noise();
+    return check_failed();
+}
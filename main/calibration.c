@@ -0,0 +1,224 @@
+#include "calibration.h"
+
+#include <string.h>
+
+enum calibration_request_e
+{
+    REQUEST_NONE = 0,
+    REQUEST_START,
+    REQUEST_FINISH,
+    REQUEST_CANCEL,
+};
+
+struct calibration_channel_stats_s
+{
+    uint32_t count;
+    uint64_t sum;
+    uint64_t sum_sq;
+    uint32_t min;
+    uint32_t max;
+};
+
+// request is written by the httpd task, everything else by the control loop
+static volatile uint8_t request;
+static volatile modelcar_calibration_phase_t phase;
+static uint32_t phase_start_us;
+static struct calibration_channel_stats_s stats[MODELCAR_CALIBRATION_CHANNELS];
+static modelcar_calibration_t result;
+
+static const char *phase_names[] = {"idle", "center", "range", "done",
+                                    "failed"};
+
+static uint32_t isqrt(uint64_t v)
+{
+    uint64_t r = 0;
+    uint64_t bit = 1ULL << 62;
+    while (bit > v)
+    {
+        bit >>= 2;
+    }
+    while (bit != 0)
+    {
+        if (v >= r + bit)
+        {
+            v -= r + bit;
+            r = (r >> 1) + bit;
+        }
+        else
+        {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return r;
+}
+
+void modelcar_calibration_default(modelcar_calibration_t *cal)
+{
+    for (int i = 0; i < MODELCAR_CALIBRATION_CHANNELS; ++i)
+    {
+        cal->channel[i].min = 1000;
+        cal->channel[i].center = 1500;
+        cal->channel[i].max = 2000;
+        cal->channel[i].deadband = 0;
+    }
+}
+
+bool modelcar_calibration_valid(const modelcar_calibration_t *cal)
+{
+    for (int i = 0; i < MODELCAR_CALIBRATION_CHANNELS; ++i)
+    {
+        const modelcar_calibration_channel_t *c = &cal->channel[i];
+        if (c->deadband > MODELCAR_CALIBRATION_DEADBAND_MAX_US ||
+            c->center < c->min + MODELCAR_CALIBRATION_MIN_THROW_US ||
+            c->max < c->center + MODELCAR_CALIBRATION_MIN_THROW_US)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void modelcar_calibration_start(void) { request = REQUEST_START; }
+
+void modelcar_calibration_finish(void) { request = REQUEST_FINISH; }
+
+void modelcar_calibration_cancel(void) { request = REQUEST_CANCEL; }
+
+static void calibration_center(modelcar_calibration_channel_t *c,
+                               const struct calibration_channel_stats_s *s)
+{
+    if (s->count == 0)
+    {
+        return;
+    }
+    uint64_t n = s->count;
+    uint64_t mean = (s->sum + n / 2) / n;
+    // n * variance * n, exact in integers unlike sum_sq / n - mean^2
+    uint64_t spread = n * s->sum_sq - s->sum * s->sum;
+    uint32_t stddev = isqrt(spread / (n * n));
+
+    // 4 sigma of the jitter at rest must not move the output
+    uint32_t deadband = 4 * stddev + 1;
+    if (deadband < MODELCAR_CALIBRATION_DEADBAND_MIN_US)
+    {
+        deadband = MODELCAR_CALIBRATION_DEADBAND_MIN_US;
+    }
+    if (deadband > MODELCAR_CALIBRATION_DEADBAND_MAX_US)
+    {
+        deadband = MODELCAR_CALIBRATION_DEADBAND_MAX_US;
+    }
+    c->center = mean;
+    c->deadband = deadband;
+}
+
+static void calibration_handle_request(uint32_t now_us)
+{
+    uint8_t req = request;
+    if (req == REQUEST_NONE)
+    {
+        return;
+    }
+    request = REQUEST_NONE;
+
+    switch (req)
+    {
+    case REQUEST_START:
+        memset(stats, 0, sizeof(stats));
+        for (int i = 0; i < MODELCAR_CALIBRATION_CHANNELS; ++i)
+        {
+            stats[i].min = UINT32_MAX;
+        }
+        modelcar_calibration_default(&result);
+        phase_start_us = now_us;
+        phase = MODELCAR_CALIBRATION_CENTER;
+        break;
+    case REQUEST_FINISH:
+        if (phase == MODELCAR_CALIBRATION_RANGE)
+        {
+            for (int i = 0; i < MODELCAR_CALIBRATION_CHANNELS; ++i)
+            {
+                result.channel[i].min = stats[i].min;
+                result.channel[i].max = stats[i].max;
+            }
+            phase = modelcar_calibration_valid(&result)
+                        ? MODELCAR_CALIBRATION_DONE
+                        : MODELCAR_CALIBRATION_FAILED;
+        }
+        break;
+    case REQUEST_CANCEL:
+        phase = MODELCAR_CALIBRATION_IDLE;
+        break;
+    default:
+        break;
+    }
+}
+
+void modelcar_calibration_sample(uint8_t channel, uint32_t us,
+                                 uint32_t now_us)
+{
+    calibration_handle_request(now_us);
+    if (channel >= MODELCAR_CALIBRATION_CHANNELS)
+    {
+        return;
+    }
+
+    struct calibration_channel_stats_s *s = &stats[channel];
+    switch (phase)
+    {
+    case MODELCAR_CALIBRATION_CENTER:
+        s->count++;
+        s->sum += us;
+        s->sum_sq += (uint64_t)us * us;
+        if (now_us - phase_start_us >= MODELCAR_CALIBRATION_CENTER_MS * 1000)
+        {
+            for (int i = 0; i < MODELCAR_CALIBRATION_CHANNELS; ++i)
+            {
+                calibration_center(&result.channel[i], &stats[i]);
+            }
+            phase = MODELCAR_CALIBRATION_RANGE;
+        }
+        break;
+    case MODELCAR_CALIBRATION_RANGE:
+        if (us < s->min)
+        {
+            s->min = us;
+        }
+        if (us > s->max)
+        {
+            s->max = us;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+bool modelcar_calibration_running(void)
+{
+    return phase == MODELCAR_CALIBRATION_CENTER ||
+           phase == MODELCAR_CALIBRATION_RANGE;
+}
+
+modelcar_calibration_phase_t modelcar_calibration_phase(void) { return phase; }
+
+const char *modelcar_calibration_phase_name(modelcar_calibration_phase_t phase)
+{
+    return phase_names[phase];
+}
+
+void modelcar_calibration_get(modelcar_calibration_t *cal)
+{
+    *cal = result;
+    if (phase == MODELCAR_CALIBRATION_RANGE)
+    {
+        for (int i = 0; i < MODELCAR_CALIBRATION_CHANNELS; ++i)
+        {
+            if (stats[i].max != 0) // seen in this phase
+            {
+                cal->channel[i].min = stats[i].min;
+                cal->channel[i].max = stats[i].max;
+            }
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef _CALIBRATION_H_
+#define _CALIBRATION_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* steering and throttle */
+#define MODELCAR_CALIBRATION_CHANNELS 2
+/* the sticks rest this long at the start of a calibration */
+#define MODELCAR_CALIBRATION_CENTER_MS 2000
+/* each side of center must span at least this much to be accepted */
+#define MODELCAR_CALIBRATION_MIN_THROW_US 200
+#define MODELCAR_CALIBRATION_DEADBAND_MIN_US 2
+#define MODELCAR_CALIBRATION_DEADBAND_MAX_US 50
+
+/* Measured endpoints of one receiver channel. The uncalibrated default of
+ * 1000/1500/2000 us without deadband is what the firmware always assumed. */
+struct modelcar_calibration_channel_s
+{
+    uint16_t min;
+    uint16_t center;
+    uint16_t max;
+    uint16_t deadband; // +- around center that counts as neutral
+};
+typedef struct modelcar_calibration_channel_s modelcar_calibration_channel_t;
+
+struct modelcar_calibration_s
+{
+    modelcar_calibration_channel_t channel[MODELCAR_CALIBRATION_CHANNELS];
+};
+typedef struct modelcar_calibration_s modelcar_calibration_t;
+
+enum modelcar_calibration_phase_e
+{
+    MODELCAR_CALIBRATION_IDLE = 0,
+    MODELCAR_CALIBRATION_CENTER, // sticks released, sampling the rest position
+    MODELCAR_CALIBRATION_RANGE,  // sticks moved to all endpoints
+    MODELCAR_CALIBRATION_DONE,
+    MODELCAR_CALIBRATION_FAILED,
+};
+typedef enum modelcar_calibration_phase_e modelcar_calibration_phase_t;
+
+void modelcar_calibration_default(modelcar_calibration_t *cal);
+bool modelcar_calibration_valid(const modelcar_calibration_t *cal);
+
+/* Requests from the web server, the control loop acts on its next pulse. */
+void modelcar_calibration_start(void);
+void modelcar_calibration_finish(void);
+void modelcar_calibration_cancel(void);
+
+/* Control loop only, feeds every accepted pulse of a calibrated channel. */
+void modelcar_calibration_sample(uint8_t channel, uint32_t us,
+                                 uint32_t now_us);
+/* true while the outputs must be held, the sticks are moved on purpose */
+bool modelcar_calibration_running(void);
+
+modelcar_calibration_phase_t modelcar_calibration_phase(void);
+const char *modelcar_calibration_phase_name(modelcar_calibration_phase_t phase);
+/* Current estimate while running, the result once done. */
+void modelcar_calibration_get(modelcar_calibration_t *cal);
+
+#endif
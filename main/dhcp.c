@@ -0,0 +1,281 @@
+#include "dhcp.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+
+#include "metrics.h"
+#include "net.h"
+#include "portal.h"
+
+#define TAG "modelcar dhcp"
+
+#define DHCP_SERVER_PORT 67
+#define DHCP_LEASE_S 7200
+
+/* RFC 2131 message: fixed BOOTP header, magic cookie, then the options */
+#define DHCP_OP_REQUEST 1
+#define DHCP_OP_REPLY 2
+#define DHCP_HLEN_ETHERNET 6
+#define DHCP_CIADDR 12
+#define DHCP_YIADDR 16
+#define DHCP_GIADDR 24
+#define DHCP_CHADDR 28
+#define DHCP_CHADDR_LEN 16
+#define DHCP_COOKIE 236
+#define DHCP_OPTIONS 240
+#define DHCP_MAGIC 0x63825363
+// some clients drop replies shorter than a BOOTP message
+#define DHCP_MIN_LEN 300
+
+#define DHCP_OPT_PAD 0
+#define DHCP_OPT_SUBNET_MASK 1
+#define DHCP_OPT_ROUTER 3
+#define DHCP_OPT_DNS 6
+#define DHCP_OPT_REQUESTED_IP 50
+#define DHCP_OPT_LEASE_TIME 51
+#define DHCP_OPT_MSG_TYPE 53
+#define DHCP_OPT_SERVER_ID 54
+#define DHCP_OPT_CAPTIVE_PORTAL 114
+#define DHCP_OPT_END 255
+
+#define DHCP_DISCOVER 1
+#define DHCP_OFFER 2
+#define DHCP_REQUEST 3
+#define DHCP_ACK 5
+#define DHCP_NAK 6
+#define DHCP_RELEASE 7
+
+/* lease i is the address right after the server's plus i, the AP admits no
+ * more stations than there are leases */
+#define DHCP_LEASES CONFIG_ESP_MAX_STA_CONN
+
+struct dhcp_lease_s
+{
+    uint8_t mac[6];
+    uint8_t used;
+    int64_t seen_us; // 0 for a free lease, it is reused first
+};
+
+// the network task only, see net.h
+static struct dhcp_lease_s leases[DHCP_LEASES];
+static uint32_t server_ip; // host order
+static uint32_t netmask;
+
+static const char portal_api_url[] = MODELCAR_PORTAL_API_URL;
+
+#if DHCP_MIN_LEN > MODELCAR_NET_PACKET_LEN
+#error "DHCP replies do not fit the buffers of the network task"
+#endif
+
+static uint32_t get32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 |
+           p[3];
+}
+
+static void put32(uint8_t *p, uint32_t value)
+{
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+/* The data of the first option code, NULL if there is none */
+static const uint8_t *dhcp_find_option(const uint8_t *query, size_t len,
+                                       uint8_t code, uint8_t *opt_len)
+{
+    size_t i = DHCP_OPTIONS;
+    while (i < len && query[i] != DHCP_OPT_END)
+    {
+        if (query[i] == DHCP_OPT_PAD)
+        {
+            ++i;
+            continue;
+        }
+        if (i + 2 > len || i + 2 + query[i + 1] > len)
+        {
+            return NULL;
+        }
+        if (query[i] == code)
+        {
+            *opt_len = query[i + 1];
+            return &query[i + 2];
+        }
+        i += 2 + query[i + 1];
+    }
+    return NULL;
+}
+
+static uint8_t *dhcp_option(uint8_t *p, uint8_t code, const void *data,
+                            uint8_t len)
+{
+    *p++ = code;
+    *p++ = len;
+    memcpy(p, data, len);
+    return p + len;
+}
+
+static uint8_t *dhcp_option32(uint8_t *p, uint8_t code, uint32_t value)
+{
+    uint8_t data[4];
+    put32(data, value);
+    return dhcp_option(p, code, data, sizeof(data));
+}
+
+/* The lease of mac. A new station gets the address it asks for if that is
+ * free, else the lease seen least recently. */
+static struct dhcp_lease_s *dhcp_lease(const uint8_t *mac, uint32_t requested)
+{
+    struct dhcp_lease_s *oldest = &leases[0];
+    for (size_t i = 0; i < DHCP_LEASES; ++i)
+    {
+        if (leases[i].used && memcmp(leases[i].mac, mac, 6) == 0)
+        {
+            return &leases[i];
+        }
+        if (leases[i].seen_us < oldest->seen_us)
+        {
+            oldest = &leases[i];
+        }
+    }
+    uint32_t wanted = requested - server_ip - 1;
+    struct dhcp_lease_s *lease =
+        wanted < DHCP_LEASES && !leases[wanted].used ? &leases[wanted] : oldest;
+    memcpy(lease->mac, mac, 6);
+    lease->used = 1;
+    return lease;
+}
+
+static void dhcp_release(const uint8_t *mac)
+{
+    for (size_t i = 0; i < DHCP_LEASES; ++i)
+    {
+        if (leases[i].used && memcmp(leases[i].mac, mac, 6) == 0)
+        {
+            leases[i].used = 0;
+            leases[i].seen_us = 0;
+        }
+    }
+}
+
+size_t modelcar_dhcp_reply(const uint8_t *query, size_t len, uint8_t *reply)
+{
+    if (len < DHCP_OPTIONS || query[0] != DHCP_OP_REQUEST ||
+        query[2] != DHCP_HLEN_ETHERNET ||
+        get32(&query[DHCP_COOKIE]) != DHCP_MAGIC)
+    {
+        return 0;
+    }
+    uint8_t opt_len;
+    const uint8_t *type =
+        dhcp_find_option(query, len, DHCP_OPT_MSG_TYPE, &opt_len);
+    if (type == NULL || opt_len != 1)
+    {
+        return 0;
+    }
+    const uint8_t *mac = &query[DHCP_CHADDR];
+    // renewing stations name their address in ciaddr instead of option 50
+    uint32_t requested = get32(&query[DHCP_CIADDR]);
+    const uint8_t *opt =
+        dhcp_find_option(query, len, DHCP_OPT_REQUESTED_IP, &opt_len);
+    if (opt != NULL && opt_len == 4)
+    {
+        requested = get32(opt);
+    }
+
+    uint8_t reply_type;
+    switch (*type)
+    {
+    case DHCP_DISCOVER:
+        reply_type = DHCP_OFFER;
+        break;
+    case DHCP_REQUEST:
+        opt = dhcp_find_option(query, len, DHCP_OPT_SERVER_ID, &opt_len);
+        if (opt != NULL && (opt_len != 4 || get32(opt) != server_ip))
+        {
+            // the station took the offer of another server
+            return 0;
+        }
+        reply_type = DHCP_ACK;
+        break;
+    case DHCP_RELEASE:
+        dhcp_release(mac);
+        return 0;
+    default:
+        return 0;
+    }
+    struct dhcp_lease_s *lease = dhcp_lease(mac, requested);
+    lease->seen_us = esp_timer_get_time();
+    uint32_t ip = server_ip + 1 + (lease - leases);
+    if (reply_type == DHCP_ACK && requested != ip)
+    {
+        // a stale address, the station starts over with a discover
+        reply_type = DHCP_NAK;
+    }
+
+    memset(reply, 0, DHCP_MIN_LEN);
+    reply[0] = DHCP_OP_REPLY;
+    // htype, hlen, hops, xid, secs and flags as in the query
+    memcpy(&reply[1], &query[1], DHCP_CIADDR - 1);
+    if (reply_type != DHCP_NAK)
+    {
+        memcpy(&reply[DHCP_CIADDR], &query[DHCP_CIADDR], 4);
+        put32(&reply[DHCP_YIADDR], ip);
+    }
+    memcpy(&reply[DHCP_GIADDR], &query[DHCP_GIADDR], 4);
+    memcpy(&reply[DHCP_CHADDR], mac, DHCP_CHADDR_LEN);
+    put32(&reply[DHCP_COOKIE], DHCP_MAGIC);
+
+    uint8_t *p = &reply[DHCP_OPTIONS];
+    p = dhcp_option(p, DHCP_OPT_MSG_TYPE, &reply_type, 1);
+    p = dhcp_option32(p, DHCP_OPT_SERVER_ID, server_ip);
+    if (reply_type != DHCP_NAK)
+    {
+        p = dhcp_option32(p, DHCP_OPT_LEASE_TIME, DHCP_LEASE_S);
+        p = dhcp_option32(p, DHCP_OPT_SUBNET_MASK, netmask);
+        p = dhcp_option32(p, DHCP_OPT_ROUTER, server_ip);
+        // the captive DNS answers every name with the portal
+        p = dhcp_option32(p, DHCP_OPT_DNS, server_ip);
+        // RFC 8910, clients that know it open the page without probing
+        p = dhcp_option(p, DHCP_OPT_CAPTIVE_PORTAL, portal_api_url,
+                        sizeof(portal_api_url) - 1);
+    }
+    *p++ = DHCP_OPT_END;
+    if (reply_type == DHCP_ACK)
+    {
+        MODELCAR_METRIC_INC(dhcp_leases);
+        ESP_LOGI(TAG, "lease %u.%u.%u.%u", reply[DHCP_YIADDR],
+                 reply[DHCP_YIADDR + 1], reply[DHCP_YIADDR + 2],
+                 reply[DHCP_YIADDR + 3]);
+    }
+    size_t reply_len = p - reply;
+    return reply_len < DHCP_MIN_LEN ? DHCP_MIN_LEN : reply_len;
+}
+
+static size_t dhcp_handle(const struct sockaddr_in *from, const uint8_t *query,
+                          size_t len, uint8_t *reply)
+{
+    return modelcar_dhcp_reply(query, len, reply);
+}
+
+// stations ask right after they joined, the socket opens with the first one
+static modelcar_net_service_t dhcp_service = {
+    .name = "DHCP",
+    .port = DHCP_SERVER_PORT,
+    .active_bit = MODELCAR_PORTAL_ACTIVE_BIT,
+    .handler = dhcp_handle,
+};
+
+void modelcar_dhcp_init(void)
+{
+    server_ip = ntohl(inet_addr(CONFIG_ESP_WIFI_IP));
+    netmask = ntohl(inet_addr(CONFIG_ESP_WIFI_NETMASK));
+    // broadcasts from a socket bound to the AP address leave by the AP, also
+    // while the station interface is the default one
+    dhcp_service.addr = htonl(server_ip);
+    modelcar_net_add_service(&dhcp_service);
+}
@@ -0,0 +1,15 @@
+#ifndef _DHCP_H_
+#define _DHCP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* DHCP server for the stations of the AP, in place of the ESP-IDF one, which
+ * cannot announce the captive portal API (option 114, RFC 8910). Register
+ * before modelcar_net_start(). */
+void modelcar_dhcp_init(void);
+/* Answer the DHCP message in query, the network task's handler, for tests.
+ * Returns the reply length, 0 for none. */
+size_t modelcar_dhcp_reply(const uint8_t *query, size_t len, uint8_t *reply);
+
+#endif
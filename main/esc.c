@@ -0,0 +1,39 @@
+#include "esc.h"
+
+#include "driver/rmt.h"
+#include "esp_log.h"
+
+#define TAG "modelcar esc"
+
+// a single output uses it
+#define ESC_RMT_CHANNEL RMT_CHANNEL_0
+
+void modelcar_esc_init(const modelcar_output_channel_t *channel)
+{
+    rmt_config_t config = RMT_DEFAULT_CONFIG_TX(channel->portnum,
+                                                ESC_RMT_CHANNEL);
+    config.clk_div = 80 / MODELCAR_ESC_TICKS_PER_US;
+    // low between the pulses
+    config.tx_config.idle_level = 0;
+    config.tx_config.idle_output_en = true;
+    ESP_ERROR_CHECK(rmt_config(&config));
+    ESP_ERROR_CHECK(rmt_driver_install(ESC_RMT_CHANNEL, 0, 0));
+
+    const modelcar_esc_protocol_info_t *p =
+        &modelcar_esc_protocols[channel->protocol];
+    ESP_LOGI(TAG, "gpio %d sends %s, %u..%u ns", channel->portnum, p->name,
+             p->pulse_min_ns, p->pulse_max_ns);
+}
+
+void modelcar_esc_write(const modelcar_output_channel_t *channel,
+                        uint32_t duty)
+{
+    // the zero length low half ends the transmission
+    rmt_item32_t item = {{{
+        .duration0 = modelcar_esc_ticks(channel->protocol, duty),
+        .level0 = 1,
+        .duration1 = 0,
+        .level1 = 0,
+    }}};
+    rmt_write_items(ESC_RMT_CHANNEL, &item, 1, false);
+}
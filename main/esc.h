@@ -0,0 +1,55 @@
+#ifndef _ESC_H_
+#define _ESC_H_
+
+#include <stdint.h>
+
+#include "modelcar.h"
+
+/* RMT ticks, the APB clock undivided */
+#define MODELCAR_ESC_TICKS_PER_US 80
+
+enum modelcar_esc_protocol_e
+{
+    MODELCAR_ESC_PWM,        // LEDC, one pulse every 20 ms
+    MODELCAR_ESC_ONESHOT125, // 125..250 us, one pulse per update
+    MODELCAR_ESC_ONESHOT42,  // 41.7..83.3 us, one pulse per update
+    MODELCAR_ESC_PROTOCOLS
+};
+typedef enum modelcar_esc_protocol_e modelcar_esc_protocol_t;
+
+/* the pulses that stand for a 1000 and a 2000 us servo pulse */
+struct modelcar_esc_protocol_s
+{
+    const char *name;
+    uint32_t pulse_min_ns;
+    uint32_t pulse_max_ns;
+};
+typedef struct modelcar_esc_protocol_s modelcar_esc_protocol_info_t;
+
+#if CONFIG_MODELCAR_THROTTLE_ONESHOT125
+#define MODELCAR_ESC_THROTTLE_PROTOCOL MODELCAR_ESC_ONESHOT125
+#elif CONFIG_MODELCAR_THROTTLE_ONESHOT42
+#define MODELCAR_ESC_THROTTLE_PROTOCOL MODELCAR_ESC_ONESHOT42
+#else
+#define MODELCAR_ESC_THROTTLE_PROTOCOL MODELCAR_ESC_PWM
+#endif
+
+/* esc_math.c, without the RMT driver */
+extern const modelcar_esc_protocol_info_t
+    modelcar_esc_protocols[MODELCAR_ESC_PROTOCOLS];
+
+/* Pulse length in RMT ticks for an output duty of a one-shot protocol. The
+ * control loop works in duties of the 50 Hz LEDC output, which map to
+ * 1000..2000 us servo pulses, and the protocol scales that range onto its
+ * own pulses. 0 for PWM, servo pulses do not fit an RMT item and stay on the
+ * LEDC. */
+uint32_t modelcar_esc_ticks(modelcar_esc_protocol_t protocol, uint32_t duty);
+
+/* Route a one-shot output to the RMT instead of the LEDC, from
+ * modelcar_init. */
+void modelcar_esc_init(const modelcar_output_channel_t *channel);
+/* Fire one pulse now, the control task only. */
+void modelcar_esc_write(const modelcar_output_channel_t *channel,
+                        uint32_t duty);
+
+#endif
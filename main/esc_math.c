@@ -0,0 +1,35 @@
+#include "esc.h"
+
+/* The pulse math of esc.c, kept apart from the RMT driver so that the host
+ * tests build it. */
+
+// the longest level one RMT item holds
+#define ESC_TICKS_MAX 32767
+
+const modelcar_esc_protocol_info_t
+    modelcar_esc_protocols[MODELCAR_ESC_PROTOCOLS] = {
+        [MODELCAR_ESC_PWM] = {"PWM", 1000000, 2000000},
+        [MODELCAR_ESC_ONESHOT125] = {"OneShot125", 125000, 250000},
+        [MODELCAR_ESC_ONESHOT42] = {"OneShot42", 41667, 83333},
+};
+
+uint32_t modelcar_esc_ticks(modelcar_esc_protocol_t protocol, uint32_t duty)
+{
+    if (protocol == MODELCAR_ESC_PWM || protocol >= MODELCAR_ESC_PROTOCOLS)
+    {
+        return 0;
+    }
+    const modelcar_esc_protocol_info_t *p = &modelcar_esc_protocols[protocol];
+    // 8192 duty ticks per 20 ms period
+    int64_t servo_ns = (int64_t)duty * 78125 / 32;
+    int64_t pulse_ns = p->pulse_min_ns + (servo_ns - 1000000) *
+                                             (p->pulse_max_ns -
+                                              p->pulse_min_ns) /
+                                             1000000;
+    int64_t ticks = pulse_ns * MODELCAR_ESC_TICKS_PER_US / 1000;
+    if (ticks < 1)
+    {
+        return 1;
+    }
+    return ticks > ESC_TICKS_MAX ? ESC_TICKS_MAX : ticks;
+}
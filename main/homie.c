@@ -0,0 +1,370 @@
+#include "homie.h"
+
+#if CONFIG_MODELCAR_MQTT
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_event.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_system.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mqtt_client.h"
+
+#include "metrics.h"
+#include "net.h"
+#include "ota.h"
+#include "profile.h"
+#include "sync.h"
+
+#define TAG "modelcar homie"
+
+// node id = device id, the topic layout start_ota.sh publishes to
+#define HOMIE_DEVICE "homie/" CONFIG_MODELCAR_MQTT_DEVICE_ID "/"
+#define HOMIE_NODE HOMIE_DEVICE CONFIG_MODELCAR_MQTT_DEVICE_ID "/"
+#define HOMIE_UPDATE_URL_MAX 256
+#define HOMIE_UPDATE_STACK_SIZE 6144
+
+struct homie_attr_s
+{
+    const char *topic;
+    const char *value;
+};
+
+static const struct homie_attr_s homie_attrs[] = {
+    {HOMIE_DEVICE "$homie", "4.0"},
+    {HOMIE_DEVICE "$name", "Model Car"},
+    {HOMIE_DEVICE "$nodes", CONFIG_MODELCAR_MQTT_DEVICE_ID},
+    {HOMIE_DEVICE "$extensions", ""},
+    {HOMIE_NODE "$name", "Control"},
+    {HOMIE_NODE "$type", "remote"},
+    {HOMIE_NODE "$properties", "steering,throttle,profile,telemetry,update"},
+    {HOMIE_NODE "steering/$name", "Steering input"},
+    {HOMIE_NODE "steering/$datatype", "integer"},
+    {HOMIE_NODE "steering/$unit", "us"},
+    {HOMIE_NODE "throttle/$name", "Throttle input"},
+    {HOMIE_NODE "throttle/$datatype", "integer"},
+    {HOMIE_NODE "throttle/$unit", "us"},
+    {HOMIE_NODE "profile/$name", "Active profile"},
+    {HOMIE_NODE "profile/$datatype", "integer"},
+    {HOMIE_NODE "telemetry/$name", "Counters since the last report, JSON"},
+    {HOMIE_NODE "telemetry/$datatype", "string"},
+    {HOMIE_NODE "update/$name", "Firmware image URL"},
+    {HOMIE_NODE "update/$datatype", "string"},
+    {HOMIE_NODE "update/$settable", "true"},
+};
+
+static esp_mqtt_client_handle_t client;
+static volatile bool connected;
+static volatile bool mqtt_started;
+
+static char update_url[HOMIE_UPDATE_URL_MAX];
+static volatile bool update_running;
+// the update task is the only user
+static char update_buf[CONFIG_MODELCAR_OTA_CHUNK_SIZE];
+
+static void homie_publish(const char *topic, const char *value, bool retain)
+{
+    esp_mqtt_client_publish(client, topic, value, 0, retain ? 1 : 0, retain);
+}
+
+/* Leave the message to the mqtt task, for callers that must not wait for
+ * the broker */
+static void homie_enqueue(const char *topic, const char *value, bool retain)
+{
+    esp_mqtt_client_enqueue(client, topic, value, 0, retain ? 1 : 0, retain,
+                            true);
+}
+
+static void homie_update_state(const char *state)
+{
+    ESP_LOGI(TAG, "update %s", state);
+    homie_publish(HOMIE_NODE "update", state, true);
+}
+
+/* receive until buf is full or the body ends, returns the length or < 0 */
+static int homie_update_read(esp_http_client_handle_t http, char *buf,
+                             int size)
+{
+    int len = 0;
+    while (len < size)
+    {
+        int n = esp_http_client_read(http, buf + len, size - len);
+        if (n <= 0)
+        {
+            return n == 0 ? len : n;
+        }
+        len += n;
+    }
+    return len;
+}
+
+static esp_err_t homie_update_download(void)
+{
+    esp_http_client_config_t config = {
+        .url = update_url,
+        .timeout_ms = 10000,
+    };
+    esp_http_client_handle_t http = esp_http_client_init(&config);
+    if (http == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = esp_http_client_open(http, 0);
+    int remaining = 0;
+    if (err == ESP_OK)
+    {
+        remaining = esp_http_client_fetch_headers(http);
+        if (esp_http_client_get_status_code(http) != 200 || remaining <= 0)
+        {
+            err = ESP_ERR_INVALID_RESPONSE;
+        }
+    }
+    if (err == ESP_OK)
+    {
+        err = modelcar_ota_begin(remaining);
+    }
+    if (err == ESP_OK)
+    {
+        while (remaining > 0 && err == ESP_OK)
+        {
+            int len = homie_update_read(http, update_buf,
+                                        remaining < sizeof(update_buf)
+                                            ? remaining
+                                            : sizeof(update_buf));
+            if (len <= 0)
+            {
+                err = ESP_ERR_INVALID_SIZE;
+                break;
+            }
+            err = modelcar_ota_write(update_buf, len);
+            remaining -= len;
+        }
+        if (err == ESP_OK)
+        {
+            err = modelcar_ota_end();
+        }
+        else
+        {
+            modelcar_ota_abort();
+        }
+    }
+
+    esp_http_client_cleanup(http);
+    return err;
+}
+
+static void homie_update_task(void *arg)
+{
+    homie_update_state("downloading");
+    esp_err_t err = homie_update_download();
+    if (err == ESP_OK)
+    {
+        const modelcar_ota_stats_t *stats = modelcar_ota_get_stats();
+        char state[64];
+        snprintf(state, sizeof(state), "restarting, %u bytes in %u ms",
+                 stats->bytes, stats->duration_ms);
+        homie_update_state(state);
+        vTaskDelay(1000 / portTICK_RATE_MS);
+        esp_restart();
+    }
+
+    char state[64];
+    snprintf(state, sizeof(state), "failed: %s", esp_err_to_name(err));
+    homie_update_state(state);
+    update_running = false;
+    vTaskDelete(NULL);
+}
+
+static void homie_on_update(const char *data, int len)
+{
+    // empty is our own clear of the retained command below
+    if (len == 0)
+    {
+        return;
+    }
+    if (update_running || len >= sizeof(update_url))
+    {
+        homie_update_state("busy or URL too long");
+        return;
+    }
+    // start_ota.sh retains the command, consume it so that the next
+    // connect does not flash the same image again
+    homie_publish(HOMIE_NODE "update/set", "", true);
+
+    memcpy(update_url, data, len);
+    update_url[len] = '\0';
+    update_running = true;
+    // a long download must not hold up the mqtt task
+    if (xTaskCreate(homie_update_task, "homie_update", HOMIE_UPDATE_STACK_SIZE,
+                    NULL, 2, NULL) != pdPASS)
+    {
+        update_running = false;
+        homie_update_state("failed: no memory");
+    }
+}
+
+static void homie_mqtt_event_handler(void *arg, esp_event_base_t base,
+                                     int32_t event_id, void *event_data)
+{
+    esp_mqtt_event_handle_t event = event_data;
+    switch (event->event_id)
+    {
+    case MQTT_EVENT_CONNECTED:
+        ESP_LOGI(TAG, "connected to %s", CONFIG_MODELCAR_MQTT_BROKER_URI);
+        homie_publish(HOMIE_DEVICE "$state", "init", true);
+        for (int i = 0; i < sizeof(homie_attrs) / sizeof(homie_attrs[0]); ++i)
+        {
+            homie_publish(homie_attrs[i].topic, homie_attrs[i].value, true);
+        }
+        esp_mqtt_client_subscribe(client, HOMIE_NODE "update/set", 1);
+        homie_publish(HOMIE_DEVICE "$state", "ready", true);
+        connected = true;
+        break;
+    case MQTT_EVENT_DISCONNECTED:
+        ESP_LOGI(TAG, "disconnected");
+        connected = false;
+        break;
+    case MQTT_EVENT_DATA:
+        // commands are short, they always arrive in one piece
+        if (event->topic_len == strlen(HOMIE_NODE "update/set") &&
+            strncmp(event->topic, HOMIE_NODE "update/set", event->topic_len) ==
+                0 &&
+            event->data_len == event->total_data_len)
+        {
+            homie_on_update(event->data, event->data_len);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void homie_wifi_event_handler(void *arg, esp_event_base_t base,
+                                     int32_t event_id, void *event_data)
+{
+    if (base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START)
+    {
+        esp_wifi_connect();
+    }
+    else if (base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
+    {
+        // the mqtt client reconnects on its own once the link is back
+        esp_wifi_connect();
+    }
+    else if (base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP)
+    {
+        ESP_LOGI(TAG, "station got an address");
+        if (!mqtt_started)
+        {
+            mqtt_started = true;
+            esp_mqtt_client_start(client);
+        }
+    }
+}
+
+/* Counters since the previous report, one message per period. Runs in the
+ * network task, so it only queues the messages for the mqtt task. */
+static void homie_telemetry(void)
+{
+    static uint32_t pulses[MODELCAR_METRICS_CHANNELS];
+    static uint32_t writes[MODELCAR_METRICS_CHANNELS];
+    static uint32_t latency[MODELCAR_METRICS_CHANNELS];
+    static uint32_t pulse_us[2];
+    static int profile = -1;
+    char buf[256];
+
+    if (!connected)
+    {
+        return;
+    }
+
+    // inputs only when they moved
+    static const char *const inputs[2] = {HOMIE_NODE "steering",
+                                          HOMIE_NODE "throttle"};
+    for (int i = 0; i < 2; ++i)
+    {
+        uint32_t us = modelcar_metrics.pulse_width_us[i];
+        if (us != pulse_us[i])
+        {
+            pulse_us[i] = us;
+            snprintf(buf, sizeof(buf), "%u", us);
+            homie_enqueue(inputs[i], buf, true);
+        }
+    }
+    if (modelcar_profile_active() != profile)
+    {
+        profile = modelcar_profile_active();
+        snprintf(buf, sizeof(buf), "%d", profile);
+        homie_enqueue(HOMIE_NODE "profile", buf, true);
+    }
+
+    size_t len = snprintf(buf, sizeof(buf), "{\"pulses\":[");
+    for (int i = 0; i < 2; ++i)
+    {
+        uint32_t now = modelcar_metrics.pulses[i];
+        len += snprintf(buf + len, sizeof(buf) - len, "%s%u", i ? "," : "",
+                        now - pulses[i]);
+        pulses[i] = now;
+    }
+    len += snprintf(buf + len, sizeof(buf) - len, "],\"latency_us\":[");
+    for (int i = 0; i < 2; ++i)
+    {
+        uint32_t w = modelcar_metrics.output_writes[i];
+        uint32_t l = modelcar_metrics.output_write_latency_us[i];
+        len += snprintf(buf + len, sizeof(buf) - len, "%s%u", i ? "," : "",
+                        w != writes[i] ? (l - latency[i]) / (w - writes[i])
+                                       : 0);
+        writes[i] = w;
+        latency[i] = l;
+    }
+    snprintf(buf + len, sizeof(buf) - len,
+             "],\"dropped\":%u,\"locked\":%u,\"heap\":%u}",
+             modelcar_metrics.pulses_dropped[0] +
+                 modelcar_metrics.pulses_dropped[1],
+             modelcar_sync_get_stats()->locked, esp_get_free_heap_size());
+    homie_enqueue(HOMIE_NODE "telemetry", buf, false);
+}
+
+void modelcar_homie_init(void)
+{
+    esp_netif_create_default_wifi_sta();
+    wifi_config_t sta_config = {
+        .sta = {.ssid = CONFIG_MODELCAR_MQTT_WIFI_SSID,
+                .password = CONFIG_MODELCAR_MQTT_WIFI_PASSWORD},
+    };
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &sta_config));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(
+        WIFI_EVENT, ESP_EVENT_ANY_ID, &homie_wifi_event_handler, NULL, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(
+        IP_EVENT, IP_EVENT_STA_GOT_IP, &homie_wifi_event_handler, NULL, NULL));
+
+    esp_mqtt_client_config_t mqtt_config = {
+        .uri = CONFIG_MODELCAR_MQTT_BROKER_URI,
+        .client_id = CONFIG_MODELCAR_MQTT_DEVICE_ID,
+        // empty means anonymous, not an empty user name
+        .username = sizeof(CONFIG_MODELCAR_MQTT_USERNAME) > 1
+                        ? CONFIG_MODELCAR_MQTT_USERNAME
+                        : NULL,
+        .password = sizeof(CONFIG_MODELCAR_MQTT_PASSWORD) > 1
+                        ? CONFIG_MODELCAR_MQTT_PASSWORD
+                        : NULL,
+        .lwt_topic = HOMIE_DEVICE "$state",
+        .lwt_msg = "lost",
+        .lwt_qos = 1,
+        .lwt_retain = 1,
+    };
+    client = esp_mqtt_client_init(&mqtt_config);
+    esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID,
+                                   homie_mqtt_event_handler, NULL);
+
+    modelcar_net_add_periodic(homie_telemetry,
+                              CONFIG_MODELCAR_MQTT_TELEMETRY_MS);
+}
+
+#endif
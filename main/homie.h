@@ -0,0 +1,13 @@
+#ifndef _HOMIE_H_
+#define _HOMIE_H_
+
+/* Station link to an MQTT broker following the Homie 4 convention, see
+ * MODELCAR_MQTT. Publishes telemetry from the network task (see net.h), the
+ * control task only leaves values in modelcar_metrics, and takes firmware
+ * URLs on homie/<device>/<device>/update/set as start_ota.sh sends them.
+ *
+ * Call after esp_wifi_init() with the mode set to WIFI_MODE_APSTA, before
+ * modelcar_net_start(). */
+void modelcar_homie_init(void);
+
+#endif
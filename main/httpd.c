@@ -1,144 +1,342 @@
 #include "httpd.h"
 
 #include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "hal/cpu_hal.h"
 #include "nvs_flash.h"
-
+#include <ctype.h>
+#include <stdlib.h>
+
+#include "calibration.h"
+#include "metrics.h"
+#include "ota.h"
+#include "params.h"
+#include "portal.h"
+#include "profile.h"
+#include "ratelimit.h"
+#include "receiver.h"
+#include "resume.h"
+#include "trace.h"
+#include "web_assets.h"
 #include "wifi-captive-portal/wifi-captive-portal-esp-idf-httpd.h"
 
 #define TAG "modelcar httpd"
 #define STORAGE_NAMESPACE "storage"
+// receive timeouts in a row before an upload is given up
+#define OTA_RECV_TIMEOUTS 3
 
+/* one profile, stored as a single blob per profile. Blobs from before
+ * parameters were appended end early, see params.def. */
 struct nvs_data_s
 {
-    float servo1_factor;
-    float servo2_factor;
-    int servo1_offset;
-    int servo2_offset;
-    float servo1_limit;
-    float servo2_limit;
+    char name[MODELCAR_PROFILE_NAME_MAX];
+    modelcar_params_t params;
 };
 
-static esp_err_t root_get_handler(httpd_req_t *req);
+static esp_err_t asset_get_handler(httpd_req_t *req);
 static esp_err_t save_get_handler(httpd_req_t *req);
 
 static esp_err_t servo_read_get_handler(httpd_req_t *req);
+static esp_err_t metrics_get_handler(httpd_req_t *req);
+static esp_err_t profile_get_handler(httpd_req_t *req);
+static esp_err_t calibrate_get_handler(httpd_req_t *req);
+static esp_err_t trace_get_handler(httpd_req_t *req);
+static esp_err_t ota_post_handler(httpd_req_t *req);
+static esp_err_t captive_api_get_handler(httpd_req_t *req);
+static esp_err_t signal_get_handler(httpd_req_t *req);
+static esp_err_t params_get_handler(httpd_req_t *req);
+static esp_err_t modelcar_httpd_dispatch(httpd_req_t *req);
+
+struct modelcar_route_s
+{
+    httpd_method_t method;
+    const char *uri;
+    esp_err_t (*handler)(httpd_req_t *req);
+    void *user_ctx;
+};
+typedef struct modelcar_route_s modelcar_route_t;
+
+static modelcar_ratelimit_t http_ratelimit;
+static modelcar_httpd_dispatch_stats_t dispatch_stats;
+
+static char portal_url[] = MODELCAR_PORTAL_URL;
 
-static struct nvs_data_s nvs_data = {
-    .servo1_factor = 1.0f,
-    .servo2_factor = 1.0f,
-    .servo1_offset = 0,
-    .servo2_offset = 0,
-    .servo1_limit = 1.0f,
-    .servo2_limit = 1.0f,
+/* query strings of /save and /read, only the httpd task touches it */
+static char query_buf[CONFIG_MODELCAR_HTTP_QUERY_MAX];
+
+#define MODELCAR_ROUTE(method, uri, handler, ctx) {method, uri, handler, ctx},
+#define MODELCAR_ROUTE_PREFIX(method, prefix, handler, ctx)
+static const modelcar_route_t routes[] = {
+#include "routes.def"
+};
+#undef MODELCAR_ROUTE
+#undef MODELCAR_ROUTE_PREFIX
+
+#define MODELCAR_ROUTE(method, uri, handler, ctx)
+#define MODELCAR_ROUTE_PREFIX(method, prefix, handler, ctx)                    \
+    {method, prefix, handler, ctx},
+static const modelcar_route_t prefix_routes[] = {
+#include "routes.def"
 };
+#undef MODELCAR_ROUTE
+#undef MODELCAR_ROUTE_PREFIX
+
+#include "routes_hash.h"
+
+#define ROUTE_COUNT (sizeof(routes) / sizeof(routes[0]))
+#define PREFIX_ROUTE_COUNT (sizeof(prefix_routes) / sizeof(prefix_routes[0]))
+
+static struct nvs_data_s profiles[MODELCAR_PROFILE_COUNT];
+/* receiver endpoints, shared by all profiles */
+static modelcar_calibration_t calibration;
+static bool calibration_stored;
 
-static httpd_uri_t common_get_uri = {
+static httpd_uri_t uri_dispatch_handler = {
     .uri = "/*",
     .method = HTTP_GET,
-    .handler = rest_common_get_handler,
+    .handler = modelcar_httpd_dispatch,
     .user_ctx = NULL,
 };
 
-static const httpd_uri_t uri_root_handler = {.uri = "/",
-                                             .method = HTTP_GET,
-                                             .handler = root_get_handler,
-                                             .user_ctx = NULL};
+static httpd_uri_t uri_dispatch_post_handler = {
+    .uri = "/*",
+    .method = HTTP_POST,
+    .handler = modelcar_httpd_dispatch,
+    .user_ctx = NULL,
+};
 
-static const httpd_uri_t uri_save_handler = {.uri = "/save",
-                                             .method = HTTP_GET,
-                                             .handler = save_get_handler,
-                                             .user_ctx = NULL};
+/* Charge one token to the requesting client. Over budget requests get no
+ * answer at all, returning ESP_FAIL just closes the socket. */
+static bool modelcar_httpd_admit(httpd_req_t *req)
+{
+    return modelcar_ratelimit_allow(
+        &http_ratelimit,
+        modelcar_ratelimit_sock_addr(httpd_req_to_sockfd(req)));
+}
 
-static const httpd_uri_t uri_servo_read_get_handler = {
-    .uri = "/read",
-    .method = HTTP_GET,
-    .handler = servo_read_get_handler,
-    .user_ctx = NULL};
+/* FNV-1a with the generated seed as offset basis, see tools/gen_routes.py.
+ * The low bits only depend on the low bits of the seed, fold the high half
+ * in so that every seed bit picks a different slot. */
+static uint32_t modelcar_route_hash(const char *uri, size_t len)
+{
+    uint32_t h = MODELCAR_ROUTE_SEED;
+    for (size_t i = 0; i < len; ++i)
+    {
+        h = (h ^ (uint8_t)uri[i]) * 16777619u;
+    }
+    return h ^ (h >> 16);
+}
 
-static esp_err_t root_get_handler(httpd_req_t *req)
+/* Resolve an exact route with a single probe of the perfect hash. Asset hits
+ * are returned as a temporary route in *asset_route. */
+static const modelcar_route_t *
+modelcar_route_lookup(const char *uri, modelcar_route_t *asset_route)
 {
-    ESP_LOGI(TAG, "root handler called");
+    size_t len = strcspn(uri, "?");
+    int idx = modelcar_route_slots[modelcar_route_hash(uri, len) &
+                                   (MODELCAR_ROUTE_SLOTS - 1)];
+    if (idx < 0)
+    {
+        return NULL;
+    }
 
-    const char *resp_str =
-#include "index.html.txt"
-        ;
-    httpd_resp_send(req, resp_str, HTTPD_RESP_USE_STRLEN);
+    const modelcar_route_t *route = asset_route;
+    if (idx < ROUTE_COUNT)
+    {
+        route = &routes[idx];
+    }
+    else
+    {
+        const web_asset_t *asset = &web_assets[idx - ROUTE_COUNT];
+        asset_route->method = HTTP_GET;
+        asset_route->uri = asset->uri;
+        asset_route->handler = asset_get_handler;
+        asset_route->user_ctx = (void *)asset;
+    }
 
+    if (strncmp(route->uri, uri, len) != 0 || route->uri[len] != 0)
+    {
+        return NULL;
+    }
+    return route;
+}
+
+/* Single entry point for all requests. Exact routes resolve through the
+ * perfect hash, prefix routes are the fallback. Nothing is logged here. */
+static esp_err_t modelcar_httpd_dispatch(httpd_req_t *req)
+{
+    uint32_t start = cpu_hal_get_cycle_count();
+
+    if (!modelcar_httpd_admit(req))
+    {
+        return ESP_FAIL;
+    }
+
+    modelcar_route_t asset_route;
+    const modelcar_route_t *route =
+        modelcar_route_lookup(req->uri, &asset_route);
+    for (int i = 0; route == NULL && i < PREFIX_ROUTE_COUNT; ++i)
+    {
+        if (strncmp(req->uri, prefix_routes[i].uri,
+                    strlen(prefix_routes[i].uri)) == 0)
+        {
+            route = &prefix_routes[i];
+        }
+    }
+
+    uint32_t cycles = cpu_hal_get_cycle_count() - start;
+    dispatch_stats.requests++;
+    dispatch_stats.cycles_total += cycles;
+    if (cycles > dispatch_stats.cycles_max)
+    {
+        dispatch_stats.cycles_max = cycles;
+    }
+
+    if (route == NULL)
+    {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, NULL);
+    }
+    if (route->method != req->method)
+    {
+        return httpd_resp_send_err(req, HTTPD_405_METHOD_NOT_ALLOWED, NULL);
+    }
+    req->user_ctx = route->user_ctx;
+    MODELCAR_TRACE_BEGIN("http_request");
+    esp_err_t err = route->handler(req);
+    MODELCAR_TRACE_END("http_request");
+    return err;
+}
+
+static esp_err_t modelcar_httpd_open_fn(httpd_handle_t hd, int sockfd)
+{
+    if (!modelcar_ratelimit_allow(&http_ratelimit,
+                                  modelcar_ratelimit_sock_addr(sockfd)))
+    {
+        return ESP_FAIL;
+    }
     return ESP_OK;
 }
 
+static esp_err_t asset_get_handler(httpd_req_t *req)
+{
+    const web_asset_t *asset = (const web_asset_t *)req->user_ctx;
+
+    httpd_resp_set_hdr(req, "ETag", asset->etag);
+    httpd_resp_set_hdr(req, "Cache-Control", asset->cache_control);
+
+    char etag[24] = {0};
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", etag,
+                                    sizeof(etag)) == ESP_OK &&
+        strcmp(etag, asset->etag) == 0)
+    {
+        httpd_resp_set_status(req, "304 Not Modified");
+        httpd_resp_send(req, NULL, 0);
+        return ESP_OK;
+    }
+
+    // only gzip is embedded, every browser in use accepts it
+    httpd_resp_set_type(req, asset->content_type);
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    httpd_resp_send(req, (const char *)asset->data, asset->len);
+
+    return ESP_OK;
+}
+
+/* Compile a profile for the control loop, it picks up the change on its next
+ * pulse if the profile is active. */
+static void modelcar_httpd_apply_profile(uint8_t idx)
+{
+    const modelcar_params_t *p = &profiles[idx].params;
+    modelcar_transfer_params_t steering = {
+        .factor = p->servo1_factor,
+        .offset = p->servo1_offset,
+        .limit = p->servo1_limit,
+        .expo = p->servo1_expo,
+        .curve = p->servo1_curve,
+        .calibration = calibration.channel[0],
+    };
+    modelcar_transfer_params_t throttle = {
+        .factor = p->servo2_factor,
+        .offset = p->servo2_offset,
+        .limit = p->servo2_limit,
+        .expo = p->servo2_expo,
+        .curve = p->servo2_curve,
+        .calibration = calibration.channel[1],
+    };
+    modelcar_slew_profile_t slew;
+    modelcar_slew_profile_build(&slew, p->servo2_accel, p->servo2_decel,
+                                p->servo2_brake, p->servo2_reverse);
+    modelcar_profile_update(idx, &steering, &throttle, &slew);
+}
+
+static void modelcar_httpd_profile_key(uint8_t idx, char *key, size_t size)
+{
+    snprintf(key, size, "profile%d", idx);
+}
+
+static void modelcar_httpd_profile_default(uint8_t idx)
+{
+    snprintf(profiles[idx].name, sizeof(profiles[idx].name), "profile%d",
+             idx + 1);
+    modelcar_params_default(&profiles[idx].params);
+}
+
+/* Set every key=value of the query that names a parameter, the query is
+ * split in place. */
+static void modelcar_httpd_params_parse(char *query, modelcar_params_t *params)
+{
+    char *save;
+    for (char *pair = strtok_r(query, "&", &save); pair != NULL;
+         pair = strtok_r(NULL, "&", &save))
+    {
+        char *value = strchr(pair, '=');
+        if (value == NULL)
+        {
+            continue;
+        }
+        const modelcar_param_t *param =
+            modelcar_param_lookup(pair, value - pair);
+        ++value;
+        if (param == NULL)
+        {
+            ESP_LOGW(TAG, "unknown parameter in %s", pair);
+        }
+        else if (modelcar_param_parse(param, params, value) != 0)
+        {
+            ESP_LOGW(TAG, "%s %s ignored", param->name, value);
+        }
+        else
+        {
+            ESP_LOGI(TAG, "%s updated to %s", param->name, value);
+        }
+    }
+}
+
 static esp_err_t save_get_handler(httpd_req_t *req)
 {
     char *buf;
     size_t buf_len;
+    // edits always go to the active profile
+    uint8_t idx = modelcar_profile_active();
+    struct nvs_data_s *nvs_data = &profiles[idx];
 
     ESP_LOGI(TAG, "save handler called");
-    /* Read URL query string length and allocate memory for length + 1,
-     * extra byte for null termination */
+    /* Read URL query string length, extra byte for null termination */
     buf_len = httpd_req_get_url_query_len(req) + 1;
+    if (buf_len > sizeof(query_buf))
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "query too long");
+        return ESP_FAIL;
+    }
     if (buf_len > 1)
     {
-        buf = malloc(buf_len);
+        buf = query_buf;
         if (httpd_req_get_url_query_str(req, buf, buf_len) == ESP_OK)
         {
             ESP_LOGI(TAG, "Found URL query => %s", buf);
-            char param[32] = {0};
-            if (httpd_query_key_value(buf, "servo1_factor", param,
-                                      sizeof(param)) == ESP_OK)
-            {
-                ESP_LOGI(TAG, "Found URL query parameter => servo1_factor=%s",
-                         param);
-                sscanf(param, "%f", &nvs_data.servo1_factor);
-                ESP_LOGI(TAG, "servo1_factor updated to %f",
-                         nvs_data.servo1_factor);
-            }
-            if (httpd_query_key_value(buf, "servo2_factor", param,
-                                      sizeof(param)) == ESP_OK)
-            {
-                ESP_LOGI(TAG, "Found URL query parameter => servo2_factor=%s",
-                         param);
-                sscanf(param, "%f", &nvs_data.servo2_factor);
-                ESP_LOGI(TAG, "servo2_factor updated to %f",
-                         nvs_data.servo2_factor);
-            }
-            if (httpd_query_key_value(buf, "servo1_offset", param,
-                                      sizeof(param)) == ESP_OK)
-            {
-                ESP_LOGI(TAG, "Found URL query parameter => servo1_offset=%s",
-                         param);
-                sscanf(param, "%d", &nvs_data.servo1_offset);
-                ESP_LOGI(TAG, "servo1_offset updated to %d",
-                         nvs_data.servo1_offset);
-            }
-            if (httpd_query_key_value(buf, "servo2_offset", param,
-                                      sizeof(param)) == ESP_OK)
-            {
-                ESP_LOGI(TAG, "Found URL query parameter => servo2_offset=%s",
-                         param);
-                sscanf(param, "%d", &nvs_data.servo2_offset);
-                ESP_LOGI(TAG, "servo2_offset updated to %d",
-                         nvs_data.servo2_offset);
-            }
-            if (httpd_query_key_value(buf, "servo1_limit", param,
-                                      sizeof(param)) == ESP_OK)
-            {
-                ESP_LOGI(TAG, "Found URL query parameter => servo1_limit=%s",
-                         param);
-                sscanf(param, "%f", &nvs_data.servo1_limit);
-                ESP_LOGI(TAG, "servo1_limit updated to %f",
-                         nvs_data.servo1_limit);
-            }
-            if (httpd_query_key_value(buf, "servo2_limit", param,
-                                      sizeof(param)) == ESP_OK)
-            {
-                ESP_LOGI(TAG, "Found URL query parameter => servo2_limit=%s",
-                         param);
-                sscanf(param, "%f", &nvs_data.servo2_limit);
-                ESP_LOGI(TAG, "servo2_limit updated to %f",
-                         nvs_data.servo2_limit);
-            }
+            modelcar_httpd_params_parse(buf, &nvs_data->params);
         }
-        free(buf);
     }
 
     nvs_handle_t my_handle;
@@ -146,27 +344,18 @@ static esp_err_t save_get_handler(httpd_req_t *req)
     ESP_LOGI(TAG, "store controller params to NVS");
     ESP_ERROR_CHECK(nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &my_handle));
 
-    ESP_ERROR_CHECK(nvs_set_blob(my_handle, "servo1_factor",
-                                 &nvs_data.servo1_factor,
-                                 sizeof(nvs_data.servo1_factor)));
-    ESP_ERROR_CHECK(nvs_set_blob(my_handle, "servo2_factor",
-                                 &nvs_data.servo2_factor,
-                                 sizeof(nvs_data.servo1_factor)));
-    ESP_ERROR_CHECK(nvs_set_blob(my_handle, "servo1_offset",
-                                 &nvs_data.servo1_offset,
-                                 sizeof(nvs_data.servo1_offset)));
-    ESP_ERROR_CHECK(nvs_set_blob(my_handle, "servo2_offset",
-                                 &nvs_data.servo2_offset,
-                                 sizeof(nvs_data.servo1_offset)));
-    ESP_ERROR_CHECK(nvs_set_blob(my_handle, "servo1_limit",
-                                 &nvs_data.servo1_limit,
-                                 sizeof(nvs_data.servo1_limit)));
-    ESP_ERROR_CHECK(nvs_set_blob(my_handle, "servo2_limit",
-                                 &nvs_data.servo2_limit,
-                                 sizeof(nvs_data.servo1_limit)));
+    char key[16];
+    modelcar_httpd_profile_key(idx, key, sizeof(key));
+    ESP_ERROR_CHECK(
+        nvs_set_blob(my_handle, key, nvs_data, sizeof(*nvs_data)));
 
+    MODELCAR_TRACE_BEGIN("nvs_commit");
     ESP_ERROR_CHECK(nvs_commit(my_handle));
+    MODELCAR_TRACE_END("nvs_commit");
     nvs_close(my_handle);
+    MODELCAR_METRIC_INC(nvs_writes);
+
+    modelcar_httpd_apply_profile(idx);
 
     const char *resp_str = "<html><body>saved</body></html>";
     httpd_resp_send(req, resp_str, HTTPD_RESP_USE_STRLEN);
@@ -177,14 +366,20 @@ static esp_err_t save_get_handler(httpd_req_t *req)
 static esp_err_t servo_read_get_handler(httpd_req_t *req)
 {
     ESP_LOGI(TAG, "servo read handler called");
+    const struct nvs_data_s *nvs_data = &profiles[modelcar_profile_active()];
 
     char resp_str[128] = {0};
 
     char *buf = 0;
     size_t buf_len = httpd_req_get_url_query_len(req) + 1;
+    if (buf_len > sizeof(query_buf))
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "query too long");
+        return ESP_FAIL;
+    }
     if (buf_len > 1)
     {
-        buf = malloc(buf_len);
+        buf = query_buf;
         if (httpd_req_get_url_query_str(req, buf, buf_len) == ESP_OK)
         {
             ESP_LOGI(TAG, "Found URL query => %s", buf);
@@ -192,35 +387,12 @@ static esp_err_t servo_read_get_handler(httpd_req_t *req)
             if (httpd_query_key_value(buf, "value", param, sizeof(param)) ==
                 ESP_OK)
             {
-                if (strcmp(param, "servo1_factor") == 0)
-                {
-                    snprintf(resp_str, sizeof(resp_str), "%.2f",
-                             nvs_data.servo1_factor);
-                }
-                else if (strcmp(param, "servo2_factor") == 0)
+                const modelcar_param_t *p =
+                    modelcar_param_lookup(param, strlen(param));
+                if (p != NULL)
                 {
-                    snprintf(resp_str, sizeof(resp_str), "%.2f",
-                             nvs_data.servo2_factor);
-                }
-                else if (strcmp(param, "servo1_offset") == 0)
-                {
-                    snprintf(resp_str, sizeof(resp_str), "%d",
-                             nvs_data.servo1_offset);
-                }
-                else if (strcmp(param, "servo2_offset") == 0)
-                {
-                    snprintf(resp_str, sizeof(resp_str), "%d",
-                             nvs_data.servo2_offset);
-                }
-                else if (strcmp(param, "servo1_limit") == 0)
-                {
-                    snprintf(resp_str, sizeof(resp_str), "%.2f",
-                             nvs_data.servo1_limit);
-                }
-                else if (strcmp(param, "servo2_limit") == 0)
-                {
-                    snprintf(resp_str, sizeof(resp_str), "%.2f",
-                             nvs_data.servo2_limit);
+                    modelcar_param_format(p, &nvs_data->params, resp_str,
+                                          sizeof(resp_str));
                 }
                 else
                 {
@@ -233,7 +405,6 @@ static esp_err_t servo_read_get_handler(httpd_req_t *req)
                 snprintf(resp_str, sizeof(resp_str), "error no value found");
             }
         }
-        free(buf);
     }
 
     httpd_resp_send(req, resp_str, HTTPD_RESP_USE_STRLEN);
@@ -241,41 +412,542 @@ static esp_err_t servo_read_get_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
-static bool my_uri_match_wildcard(const char *uri_template,
-                                  const char *uri_to_match, size_t match_upto)
+/* names end up in JSON unescaped, so keep them to a safe alphabet */
+static bool modelcar_httpd_profile_name_valid(const char *name)
 {
-    ESP_LOGI(TAG, "%s ~= %s", uri_template, uri_to_match);
-    return httpd_uri_match_wildcard(uri_template, uri_to_match, match_upto);
+    if (*name == 0)
+    {
+        return false;
+    }
+    for (; *name != 0; ++name)
+    {
+        if (!isalnum((unsigned char)*name) && *name != '-' && *name != '_')
+        {
+            return false;
+        }
+    }
+    return true;
 }
 
-httpd_handle_t modelcar_httpd_start_webserver(void)
+/* ?select=N switches to a profile, ?name=xyz renames the active one. Both
+ * answer with the profile list. */
+static esp_err_t profile_get_handler(httpd_req_t *req)
 {
-    httpd_handle_t server = NULL;
-    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    config.lru_purge_enable = true;
-    config.uri_match_fn = my_uri_match_wildcard;
+    size_t buf_len = httpd_req_get_url_query_len(req) + 1;
+    if (buf_len > sizeof(query_buf))
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "query too long");
+        return ESP_FAIL;
+    }
+    if (buf_len > 1 &&
+        httpd_req_get_url_query_str(req, query_buf, buf_len) == ESP_OK)
+    {
+        char param[MODELCAR_PROFILE_NAME_MAX] = {0};
+        bool select = false;
+        bool rename = false;
+        if (httpd_query_key_value(query_buf, "select", param, sizeof(param)) ==
+            ESP_OK)
+        {
+            int idx = atoi(param);
+            if (idx >= 0 && idx < MODELCAR_PROFILE_COUNT)
+            {
+                modelcar_profile_select(idx);
+                select = true;
+            }
+        }
+        if (httpd_query_key_value(query_buf, "name", param, sizeof(param)) ==
+                ESP_OK &&
+            modelcar_httpd_profile_name_valid(param))
+        {
+            strlcpy(profiles[modelcar_profile_active()].name, param,
+                    MODELCAR_PROFILE_NAME_MAX);
+            rename = true;
+        }
+
+        if (select || rename)
+        {
+            uint8_t idx = modelcar_profile_active();
+            nvs_handle_t my_handle;
+            ESP_LOGI(TAG, "store profile %d %s", idx, profiles[idx].name);
+            ESP_ERROR_CHECK(
+                nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &my_handle));
+            ESP_ERROR_CHECK(nvs_set_u8(my_handle, "profile", idx));
+            if (rename)
+            {
+                char key[16];
+                modelcar_httpd_profile_key(idx, key, sizeof(key));
+                ESP_ERROR_CHECK(nvs_set_blob(my_handle, key, &profiles[idx],
+                                             sizeof(profiles[idx])));
+            }
+            MODELCAR_TRACE_BEGIN("nvs_commit");
+            ESP_ERROR_CHECK(nvs_commit(my_handle));
+            MODELCAR_TRACE_END("nvs_commit");
+            nvs_close(my_handle);
+            MODELCAR_METRIC_INC(nvs_writes);
+        }
+    }
+
+    static char resp[32 + MODELCAR_PROFILE_COUNT *
+                              (MODELCAR_PROFILE_NAME_MAX + 3)];
+    size_t len = snprintf(resp, sizeof(resp), "{\"active\":%d,\"profiles\":[",
+                          modelcar_profile_active());
+    for (int i = 0; i < MODELCAR_PROFILE_COUNT; ++i)
+    {
+        len += snprintf(resp + len, sizeof(resp) - len, "%s\"%s\"",
+                        i ? "," : "", profiles[i].name);
+    }
+    len += snprintf(resp + len, sizeof(resp) - len, "]}");
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    httpd_resp_send(req, resp, len);
+
+    return ESP_OK;
+}
+
+/* ?action=start|finish|cancel drives the calibration, the page polls the
+ * plain URL for progress. A finished calibration is stored and applied to all
+ * profiles on the first poll that sees it. */
+static esp_err_t calibrate_get_handler(httpd_req_t *req)
+{
+    size_t buf_len = httpd_req_get_url_query_len(req) + 1;
+    if (buf_len > sizeof(query_buf))
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "query too long");
+        return ESP_FAIL;
+    }
+    if (buf_len > 1 &&
+        httpd_req_get_url_query_str(req, query_buf, buf_len) == ESP_OK)
+    {
+        char param[16] = {0};
+        if (httpd_query_key_value(query_buf, "action", param, sizeof(param)) ==
+            ESP_OK)
+        {
+            ESP_LOGI(TAG, "calibration %s", param);
+            if (strcmp(param, "start") == 0)
+            {
+                calibration_stored = false;
+                modelcar_calibration_start();
+            }
+            else if (strcmp(param, "finish") == 0)
+            {
+                modelcar_calibration_finish();
+            }
+            else if (strcmp(param, "cancel") == 0)
+            {
+                modelcar_calibration_cancel();
+            }
+        }
+    }
+
+    modelcar_calibration_phase_t phase = modelcar_calibration_phase();
+    modelcar_calibration_t cal = calibration;
+    if (phase != MODELCAR_CALIBRATION_IDLE)
+    {
+        modelcar_calibration_get(&cal);
+    }
+
+    if (phase == MODELCAR_CALIBRATION_DONE && !calibration_stored)
+    {
+        calibration = cal;
+        calibration_stored = true;
+
+        nvs_handle_t my_handle;
+        ESP_LOGI(TAG, "store calibration to NVS");
+        ESP_ERROR_CHECK(nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &my_handle));
+        ESP_ERROR_CHECK(nvs_set_blob(my_handle, "calibration", &calibration,
+                                     sizeof(calibration)));
+        MODELCAR_TRACE_BEGIN("nvs_commit");
+        ESP_ERROR_CHECK(nvs_commit(my_handle));
+        MODELCAR_TRACE_END("nvs_commit");
+        nvs_close(my_handle);
+        MODELCAR_METRIC_INC(nvs_writes);
+
+        for (int i = 0; i < MODELCAR_PROFILE_COUNT; ++i)
+        {
+            modelcar_httpd_apply_profile(i);
+        }
+    }
+
+    char resp[256];
+    size_t len =
+        snprintf(resp, sizeof(resp), "{\"phase\":\"%s\",\"channels\":[",
+                 modelcar_calibration_phase_name(phase));
+    for (int i = 0; i < MODELCAR_CALIBRATION_CHANNELS; ++i)
+    {
+        len += snprintf(resp + len, sizeof(resp) - len,
+                        "%s{\"min\":%d,\"center\":%d,\"max\":%d,"
+                        "\"deadband\":%d}",
+                        i ? "," : "", cal.channel[i].min,
+                        cal.channel[i].center, cal.channel[i].max,
+                        cal.channel[i].deadband);
+    }
+    len += snprintf(resp + len, sizeof(resp) - len, "]}");
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    httpd_resp_send(req, resp, len);
+
+    return ESP_OK;
+}
+
+static esp_err_t metrics_get_handler(httpd_req_t *req)
+{
+    // only the httpd task renders, a static buffer is safe
+    static char buf[CONFIG_MODELCAR_METRICS_BUFFER_SIZE];
+    size_t len = modelcar_metrics_render(buf, sizeof(buf));
+
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    httpd_resp_send(req, buf, len);
+
+    return ESP_OK;
+}
+
+/* RFC 8908, the device never has internet so the client stays captive */
+static esp_err_t captive_api_get_handler(httpd_req_t *req)
+{
+    static const char resp[] =
+        "{\"captive\":true,\"user-portal-url\":\"" MODELCAR_PORTAL_URL "\"}";
+
+    MODELCAR_METRIC_INC(captive_api_requests);
+    httpd_resp_set_type(req, "application/captive+json");
+    httpd_resp_set_hdr(req, "Cache-Control", "private");
+    httpd_resp_send(req, resp, sizeof(resp) - 1);
+    return ESP_OK;
+}
+
+/* Receiver statistics of this session as JSON, one chunk per channel with
+ * both histograms. ?reset=1 starts over. */
+static esp_err_t signal_get_handler(httpd_req_t *req)
+{
+    size_t buf_len = httpd_req_get_url_query_len(req) + 1;
+    if (buf_len > 1 && buf_len <= sizeof(query_buf) &&
+        httpd_req_get_url_query_str(req, query_buf, buf_len) == ESP_OK)
+    {
+        char param[4];
+        if (httpd_query_key_value(query_buf, "reset", param, sizeof(param)) ==
+                ESP_OK &&
+            strcmp(param, "1") == 0)
+        {
+            ESP_LOGI(TAG, "signal statistics reset");
+            modelcar_receiver_reset();
+        }
+    }
+
+    // only the httpd task renders, a static buffer is safe
+    static char resp[1280];
+    static modelcar_receiver_channel_t stats;
+    modelcar_receiver_summary_t summary;
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    size_t len = snprintf(resp, sizeof(resp),
+                          "{\"width_min_us\":%d,\"width_bin_us\":%d,"
+                          "\"period_bin_us\":%d,\"channels\":[",
+                          MODELCAR_PULSE_MIN_US, MODELCAR_RECEIVER_WIDTH_BIN_US,
+                          MODELCAR_RECEIVER_PERIOD_BIN_US);
+    httpd_resp_send_chunk(req, resp, len);
+    for (int i = 0; i < MODELCAR_RECEIVER_CHANNELS; ++i)
+    {
+        modelcar_receiver_get(i, &stats);
+        modelcar_receiver_summarize(&stats, &summary);
+        len = snprintf(resp, sizeof(resp),
+                       "%s{\"score\":%d,\"pulses\":%u,\"glitches\":%u,"
+                       "\"gaps\":%u,\"gap_max_us\":%u,\"period_us\":%u,"
+                       "\"period_jitter_us\":%.1f,\"width_noise_us\":%.1f,"
+                       "\"width_hist\":[",
+                       i ? "," : "", summary.score, stats.pulses,
+                       stats.glitches, stats.gaps, stats.gap_max_us,
+                       summary.period_us, summary.period_jitter_us,
+                       summary.width_noise_us);
+        for (int j = 0; j < MODELCAR_RECEIVER_WIDTH_BINS; ++j)
+        {
+            len += snprintf(resp + len, sizeof(resp) - len, "%s%u",
+                            j ? "," : "", stats.width_hist[j]);
+        }
+        len += snprintf(resp + len, sizeof(resp) - len, "],\"period_hist\":[");
+        for (int j = 0; j < MODELCAR_RECEIVER_PERIOD_BINS; ++j)
+        {
+            len += snprintf(resp + len, sizeof(resp) - len, "%s%u",
+                            j ? "," : "", stats.period_hist[j]);
+        }
+        len += snprintf(resp + len, sizeof(resp) - len, "]}");
+        httpd_resp_send_chunk(req, resp, len);
+    }
+    httpd_resp_send_chunk(req, "]}", 2);
+    httpd_resp_send_chunk(req, NULL, 0);
+
+    return ESP_OK;
+}
+
+static const char *const param_types[] = {"float", "int", "curve"};
+
+/* The parameter table with the values of the active profile, the page builds
+ * its form from it. */
+static esp_err_t params_get_handler(httpd_req_t *req)
+{
+    const modelcar_params_t *params =
+        &profiles[modelcar_profile_active()].params;
+    // only the httpd task renders, a static buffer is safe
+    static char resp[192 + MODELCAR_CURVE_PARAM_MAX];
+    char value[MODELCAR_CURVE_PARAM_MAX];
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    httpd_resp_send_chunk(req, "{\"params\":[", HTTPD_RESP_USE_STRLEN);
+    for (size_t i = 0; i < modelcar_params_count; ++i)
+    {
+        const modelcar_param_t *param = &modelcar_params[i];
+        modelcar_param_format(param, params, value, sizeof(value));
+        // curves are text, the alphabet of modelcar_curve_format needs no
+        // escaping
+        const char *quote = param->type == MODELCAR_PARAM_CURVE ? "\"" : "";
+        size_t len = snprintf(
+            resp, sizeof(resp),
+            "%s{\"name\":\"%s\",\"type\":\"%s\",\"min\":%g,\"max\":%g,"
+            "\"step\":%g,\"default\":%g,\"channel\":%d,\"label\":\"%s\","
+            "\"unit\":\"%s\",\"value\":%s%s%s}",
+            i ? "," : "", param->name, param_types[param->type], param->min,
+            param->max, param->step, param->def, param->channel, param->label,
+            param->unit, quote, value, quote);
+        httpd_resp_send_chunk(req, resp, len);
+    }
+    httpd_resp_send_chunk(req, "]}", 2);
+    httpd_resp_send_chunk(req, NULL, 0);
+
+    return ESP_OK;
+}
+
+#if CONFIG_MODELCAR_TRACE
+static int trace_write_chunk(void *ctx, const char *buf, size_t len)
+{
+    return httpd_resp_send_chunk((httpd_req_t *)ctx, buf, len) != ESP_OK;
+}
+#endif
+
+static esp_err_t trace_get_handler(httpd_req_t *req)
+{
+#if CONFIG_MODELCAR_TRACE
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Content-Disposition",
+                       "attachment; filename=\"modelcar_trace.json\"");
+    modelcar_trace_export(trace_write_chunk, req);
+    return httpd_resp_send_chunk(req, NULL, 0);
+#else
+    return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND,
+                               "tracing is off, see MODELCAR_TRACE");
+#endif
+}
+
+/* receive until buf is full or the body ends, returns the length or < 0 */
+static int ota_recv_chunk(httpd_req_t *req, char *buf, size_t size)
+{
+    size_t len = 0;
+    int timeouts = 0;
+    while (len < size)
+    {
+        int n = httpd_req_recv(req, buf + len, size - len);
+        // a stalled client would hold the httpd task and the OTA partition
+        if (n == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts < OTA_RECV_TIMEOUTS)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return n == 0 ? len : n;
+        }
+        len += n;
+        timeouts = 0;
+    }
+    return len;
+}
+
+/* The raw image as request body, e.g.
+ * curl --data-binary @build/model_car_remote.bin http://IP/api/ota
+ * Written chunk by chunk while the control loop keeps running, boots into the
+ * new image on success. */
+static esp_err_t ota_post_handler(httpd_req_t *req)
+{
+    // only the httpd task uploads, a static buffer is safe
+    static char buf[CONFIG_MODELCAR_OTA_CHUNK_SIZE];
+
+    if (req->content_len == 0)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "no image");
+    }
+    esp_err_t err = modelcar_ota_begin(req->content_len);
+    if (err != ESP_OK)
+    {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
+                                   esp_err_to_name(err));
+    }
+
+    size_t remaining = req->content_len;
+    while (remaining > 0)
+    {
+        int len = ota_recv_chunk(
+            req, buf, remaining < sizeof(buf) ? remaining : sizeof(buf));
+        if (len <= 0)
+        {
+            // connection lost, nothing to answer to
+            modelcar_ota_abort();
+            return ESP_FAIL;
+        }
+        err = modelcar_ota_write(buf, len);
+        if (err != ESP_OK)
+        {
+            modelcar_ota_abort();
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST,
+                                       esp_err_to_name(err));
+        }
+        remaining -= len;
+    }
+
+    err = modelcar_ota_end();
+    if (err != ESP_OK)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST,
+                                   esp_err_to_name(err));
+    }
+
+    const modelcar_ota_stats_t *stats = modelcar_ota_get_stats();
+    char resp[192];
+    snprintf(resp, sizeof(resp),
+             "{\"bytes\":%u,\"ms\":%u,\"kbyte_per_s\":%u,"
+             "\"write_us_max\":%u,\"latency_us\":[%u,%u],"
+             "\"pulses_dropped\":%u}",
+             stats->bytes, stats->duration_ms,
+             stats->duration_ms ? stats->bytes / stats->duration_ms : 0,
+             stats->write_us_max, stats->latency_us_avg[0],
+             stats->latency_us_avg[1], stats->pulses_dropped);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, resp, HTTPD_RESP_USE_STRLEN);
+
+    // give the response a moment to leave
+    ESP_LOGI(TAG, "restarting into the new image");
+    vTaskDelay(500 / portTICK_RATE_MS);
+    esp_restart();
+    return ESP_OK;
+}
+
+/* the params of releases before profiles, one key each */
+static void modelcar_httpd_load_legacy(nvs_handle_t my_handle,
+                                       struct nvs_data_s *nvs_data)
+{
+    for (size_t i = 0; i < modelcar_params_count; ++i)
+    {
+        const modelcar_param_t *param = &modelcar_params[i];
+        size_t s = param->end - param->offset;
+        nvs_get_blob(my_handle, param->name,
+                     (uint8_t *)&nvs_data->params + param->offset, &s);
+    }
+}
+
+void modelcar_httpd_init(void)
+{
+    modelcar_ratelimit_init(&http_ratelimit, CONFIG_MODELCAR_HTTP_RATE_LIMIT,
+                            CONFIG_MODELCAR_HTTP_RATE_BURST,
+                            CONFIG_MODELCAR_HTTP_RATE_LIMIT_TOTAL,
+                            CONFIG_MODELCAR_HTTP_RATE_BURST_TOTAL);
+    wifi_captive_portal_esp_idf_httpd_probe_init();
 
     nvs_handle_t my_handle;
+    uint8_t active = 0;
 
-    ESP_LOGI(TAG, "read data params from NVS");
+    for (int i = 0; i < MODELCAR_PROFILE_COUNT; ++i)
+    {
+        modelcar_httpd_profile_default(i);
+    }
+
+    ESP_LOGI(TAG, "read profiles from NVS");
     if (nvs_open(STORAGE_NAMESPACE, NVS_READONLY, &my_handle) == ESP_OK)
     {
-        size_t s = sizeof(float);
-        nvs_get_blob(my_handle, "servo1_factor", &nvs_data.servo1_factor, &s);
-        nvs_get_blob(my_handle, "servo2_factor", &nvs_data.servo2_factor, &s);
-        nvs_get_blob(my_handle, "servo1_offset", &nvs_data.servo1_offset, &s);
-        nvs_get_blob(my_handle, "servo2_offset", &nvs_data.servo2_offset, &s);
-        nvs_get_blob(my_handle, "servo1_limit", &nvs_data.servo1_limit, &s);
-        nvs_get_blob(my_handle, "servo2_limit", &nvs_data.servo2_limit, &s);
+        for (int i = 0; i < MODELCAR_PROFILE_COUNT; ++i)
+        {
+            char key[16];
+            modelcar_httpd_profile_key(i, key, sizeof(key));
+            size_t s = sizeof(profiles[i]);
+            if (nvs_get_blob(my_handle, key, &profiles[i], &s) == ESP_OK &&
+                s >= offsetof(struct nvs_data_s, params) &&
+                modelcar_params_size_valid(
+                    s - offsetof(struct nvs_data_s, params)))
+            {
+                // the parameters appended since keep their defaults
+                continue;
+            }
+            // missing or from another firmware layout
+            modelcar_httpd_profile_default(i);
+            if (i == 0)
+            {
+                modelcar_httpd_load_legacy(my_handle, &profiles[0]);
+            }
+        }
+        nvs_get_u8(my_handle, "profile", &active);
+        size_t s = sizeof(calibration);
+        if (nvs_get_blob(my_handle, "calibration", &calibration, &s) !=
+                ESP_OK ||
+            s != sizeof(calibration) ||
+            !modelcar_calibration_valid(&calibration))
+        {
+            modelcar_calibration_default(&calibration);
+        }
         nvs_close(my_handle);
     }
+    else
+    {
+        modelcar_calibration_default(&calibration);
+    }
+    if (active >= MODELCAR_PROFILE_COUNT)
+    {
+        active = 0;
+    }
+    for (int i = 0; i < MODELCAR_CALIBRATION_CHANNELS; ++i)
+    {
+        ESP_LOGI(TAG, "servo%d calibration %d/%d/%d us, deadband %d us",
+                 i + 1, calibration.channel[i].min,
+                 calibration.channel[i].center, calibration.channel[i].max,
+                 calibration.channel[i].deadband);
+    }
 
-    ESP_LOGI(TAG, "servo1_factor is %.2f", nvs_data.servo1_factor);
-    ESP_LOGI(TAG, "servo2_factor is %.2f", nvs_data.servo2_factor);
-    ESP_LOGI(TAG, "servo1_offset is %d", nvs_data.servo1_offset);
-    ESP_LOGI(TAG, "servo2_offset is %d", nvs_data.servo2_offset);
-    ESP_LOGI(TAG, "servo1_limit is %.2f", nvs_data.servo1_limit);
-    ESP_LOGI(TAG, "servo2_limit is %.2f", nvs_data.servo2_limit);
+    for (int i = 0; i < MODELCAR_PROFILE_COUNT; ++i)
+    {
+        profiles[i].name[MODELCAR_PROFILE_NAME_MAX - 1] = 0;
+        ESP_LOGI(TAG, "profile %d is %s", i, profiles[i].name);
+        modelcar_httpd_apply_profile(i);
+    }
+    if (modelcar_resume_get_stats()->resumed)
+    {
+        // the car already drives with the profile active before the reset,
+        // e.g. one picked by the profile switch, which NVS does not keep
+        active = modelcar_profile_active();
+    }
+    else
+    {
+        modelcar_profile_select(active);
+    }
+
+    const struct nvs_data_s *nvs_data = &profiles[active];
+    ESP_LOGI(TAG, "active profile %s", nvs_data->name);
+    for (size_t i = 0; i < modelcar_params_count; ++i)
+    {
+        char value[MODELCAR_CURVE_PARAM_MAX];
+        modelcar_param_format(&modelcar_params[i], &nvs_data->params, value,
+                              sizeof(value));
+        ESP_LOGI(TAG, "%s is %s %s", modelcar_params[i].name, value,
+                 modelcar_params[i].unit);
+    }
+}
+
+httpd_handle_t modelcar_httpd_start_webserver(void)
+{
+    httpd_handle_t server = NULL;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.lru_purge_enable = true;
+    // only the catch-all dispatcher is registered, see routes.def
+    config.uri_match_fn = httpd_uri_match_wildcard;
+    config.open_fn = modelcar_httpd_open_fn;
+    // stay below the control loop, see CONFIG_MODELCAR_CONTROL_TASK_PRIORITY
+    config.task_priority = CONFIG_MODELCAR_HTTPD_TASK_PRIORITY;
 
     // Start the httpd server
     ESP_LOGI(TAG, "Starting server on port: '%d'", config.server_port);
@@ -283,15 +955,8 @@ httpd_handle_t modelcar_httpd_start_webserver(void)
     {
         // Set URI handlers
         ESP_LOGI(TAG, "Registering URI handlers");
-
-        httpd_register_uri_handler(server, &uri_root_handler);
-        httpd_register_uri_handler(server, &uri_save_handler);
-        httpd_register_uri_handler(server, &uri_servo_read_get_handler);
-
-        common_get_uri.user_ctx = malloc(100);
-        snprintf((char *)common_get_uri.user_ctx, 100, "http://%s/",
-                 CONFIG_ESP_WIFI_IP);
-        httpd_register_uri_handler(server, &common_get_uri);
+        httpd_register_uri_handler(server, &uri_dispatch_handler);
+        httpd_register_uri_handler(server, &uri_dispatch_post_handler);
 
         return server;
     }
@@ -300,14 +965,22 @@ httpd_handle_t modelcar_httpd_start_webserver(void)
     return NULL;
 }
 
-float modelcar_httpd_get_servo1_factor() { return nvs_data.servo1_factor; }
-
-float modelcar_httpd_get_servo2_factor() { return nvs_data.servo2_factor; }
-
-int modelcar_httpd_get_servo1_offset() { return nvs_data.servo1_offset; }
+const modelcar_params_t *modelcar_httpd_get_params(uint8_t idx)
+{
+    return &profiles[idx].params;
+}
 
-int modelcar_httpd_get_servo2_offset() { return nvs_data.servo2_offset; }
+const char *modelcar_httpd_get_profile_name(uint8_t idx)
+{
+    return profiles[idx].name;
+}
 
-float modelcar_httpd_get_servo1_limit() { return nvs_data.servo1_limit; }
+const modelcar_ratelimit_t *modelcar_httpd_get_ratelimit()
+{
+    return &http_ratelimit;
+}
 
-float modelcar_httpd_get_servo2_limit() { return nvs_data.servo2_limit; }
+const modelcar_httpd_dispatch_stats_t *modelcar_httpd_get_dispatch_stats()
+{
+    return &dispatch_stats;
+}
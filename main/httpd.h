@@ -3,12 +3,25 @@
 
 #include <esp_http_server.h>
 
+#include "params.h"
+#include "ratelimit.h"
+
+/* cost of resolving a request to its handler, in CPU cycles */
+struct modelcar_httpd_dispatch_stats_s
+{
+    uint32_t requests;
+    uint64_t cycles_total;
+    uint32_t cycles_max;
+};
+typedef struct modelcar_httpd_dispatch_stats_s modelcar_httpd_dispatch_stats_t;
+
+/* load the profiles from NVS and compile them, call once at boot */
+void modelcar_httpd_init(void);
+/* started and stopped by the portal as stations come and go */
 httpd_handle_t modelcar_httpd_start_webserver(void);
-float modelcar_httpd_get_servo1_factor();
-float modelcar_httpd_get_servo2_factor();
-int modelcar_httpd_get_servo1_offset();
-int modelcar_httpd_get_servo2_offset();
-float modelcar_httpd_get_servo1_limit();
-float modelcar_httpd_get_servo2_limit();
+const modelcar_params_t *modelcar_httpd_get_params(uint8_t idx);
+const char *modelcar_httpd_get_profile_name(uint8_t idx);
+const modelcar_ratelimit_t *modelcar_httpd_get_ratelimit();
+const modelcar_httpd_dispatch_stats_t *modelcar_httpd_get_dispatch_stats();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,184 @@
+#include "idle.h"
+
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "driver/rtc_io.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+
+#include "esc.h"
+#include "portal.h"
+#include "sync.h"
+
+#define TAG "modelcar idle"
+
+// neutral frames the ESC sees before the outputs stop
+#define IDLE_NEUTRAL_FRAMES 5
+
+static modelcar_idle_stats_t stats;
+
+#if CONFIG_MODELCAR_IDLE_POWERDOWN
+
+// control task only
+static uint32_t station_us;
+static int64_t wake_us;
+static uint8_t wake_pending;
+
+void modelcar_idle_init(void)
+{
+#if CONFIG_MODELCAR_IDLE_DEEP_SLEEP
+    // the app start is the wake, the ROM and the bootloader are not counted
+    if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_EXT0)
+    {
+        wake_us = 0;
+        wake_pending = 1;
+        ESP_LOGI(TAG, "woke from deep sleep");
+    }
+#endif
+}
+
+bool modelcar_idle_due(uint32_t last_pulse_us)
+{
+    uint32_t now = esp_timer_get_time();
+    if (modelcar_portal_get_stations() > 0)
+    {
+        station_us = now;
+    }
+    uint32_t timeout_us = CONFIG_MODELCAR_IDLE_TIMEOUT_S * 1000000u;
+    return now - last_pulse_us >= timeout_us && now - station_us >= timeout_us;
+}
+
+static void idle_wifi_start(void *arg1, uint32_t arg2)
+{
+    ESP_ERROR_CHECK(esp_wifi_start());
+    ESP_LOGI(TAG, "radio back on");
+}
+
+static void idle_light_sleep(modelcar_config_t *config)
+{
+    for (int i = 0; i < config->input_channel_count; ++i)
+    {
+        gpio_num_t pin = config->input_channel[i].portnum;
+        // a level interrupt would fire for as long as the pulse lasts
+        gpio_intr_disable(pin);
+        // wake on the first edge, whichever level the line rests at
+        gpio_wakeup_enable(pin, gpio_get_level(pin) ? GPIO_INTR_LOW_LEVEL
+                                                    : GPIO_INTR_HIGH_LEVEL);
+    }
+    esp_sleep_enable_gpio_wakeup();
+
+    int64_t sleep_us = esp_timer_get_time();
+    esp_light_sleep_start();
+    wake_us = esp_timer_get_time();
+    wake_pending = 1;
+    stats.slept_ms = (wake_us - sleep_us) / 1000;
+
+    for (int i = 0; i < config->input_channel_count; ++i)
+    {
+        gpio_num_t pin = config->input_channel[i].portnum;
+        gpio_wakeup_disable(pin);
+        gpio_set_intr_type(pin, GPIO_INTR_ANYEDGE);
+        gpio_intr_enable(pin);
+    }
+    // the outputs are stopped, a good time to line the sync model up with
+    // the LEDC timer again
+    modelcar_sync_reanchor();
+    // back to the staged neutral duties until the first pulse replaces them
+    for (int i = 0; i < config->output_channel_count; ++i)
+    {
+        if (config->output_channel[i].protocol == MODELCAR_ESC_PWM)
+        {
+            ledc_update_duty(LEDC_LOW_SPEED_MODE,
+                             config->output_channel[i].ledchannel);
+        }
+    }
+    // takes tens of ms, left to the timer service task below the control one
+    xTimerPendFunctionCall(idle_wifi_start, NULL, 0, 0);
+    ESP_LOGI(TAG, "woke after %u ms", stats.slept_ms);
+}
+
+#if CONFIG_MODELCAR_IDLE_DEEP_SLEEP
+static void idle_deep_sleep(modelcar_config_t *config)
+{
+    // ext0 watches a single RTC pin, the throttle input wakes the car
+    gpio_num_t pin = config->input_channel[1].portnum;
+    if (!rtc_gpio_is_valid_gpio(pin))
+    {
+        ESP_LOGW(TAG, "gpio %d cannot wake from deep sleep, light sleep", pin);
+        idle_light_sleep(config);
+        return;
+    }
+    int level = gpio_get_level(pin);
+    // modelcar_init's pull-up is a digital one, it is off in deep sleep
+    rtc_gpio_pullup_en(pin);
+    rtc_gpio_pulldown_dis(pin);
+    esp_sleep_enable_ext0_wakeup(pin, !level);
+    // holds the neutral outputs modelcar_resume_restore drives on with
+    esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_SLOW_MEM, ESP_PD_OPTION_ON);
+    esp_deep_sleep_start();
+}
+#endif
+
+void modelcar_idle_enter(modelcar_config_t *config)
+{
+    ESP_LOGI(TAG, "no pulses and no stations for %d s, powering down",
+             CONFIG_MODELCAR_IDLE_TIMEOUT_S);
+    vTaskDelay(IDLE_NEUTRAL_FRAMES * 20 / portTICK_PERIOD_MS);
+    // low between the pulses, a frozen high level would read as full throw
+    // one-shot outputs just send no more pulses
+    for (int i = 0; i < config->output_channel_count; ++i)
+    {
+        if (config->output_channel[i].protocol == MODELCAR_ESC_PWM)
+        {
+            ledc_stop(LEDC_LOW_SPEED_MODE,
+                      config->output_channel[i].ledchannel, 0);
+        }
+    }
+    esp_wifi_stop();
+    stats.sleeps++;
+#if CONFIG_MODELCAR_IDLE_DEEP_SLEEP
+    idle_deep_sleep(config);
+#else
+    idle_light_sleep(config);
+#endif
+}
+
+void modelcar_idle_output(void)
+{
+    if (!wake_pending)
+    {
+        return;
+    }
+    wake_pending = 0;
+    stats.wake_output_us = esp_timer_get_time() - wake_us;
+    if (stats.wake_output_us > stats.wake_output_max_us)
+    {
+        stats.wake_output_max_us = stats.wake_output_us;
+    }
+    if (stats.wake_output_us > CONFIG_MODELCAR_IDLE_WAKE_TARGET_MS * 1000u)
+    {
+        stats.wake_late++;
+        ESP_LOGW(TAG, "first output %u us after the wake, target %d ms",
+                 stats.wake_output_us, CONFIG_MODELCAR_IDLE_WAKE_TARGET_MS);
+    }
+    else
+    {
+        ESP_LOGI(TAG, "first output %u us after the wake",
+                 stats.wake_output_us);
+    }
+}
+
+#else
+
+void modelcar_idle_init(void) {}
+bool modelcar_idle_due(uint32_t last_pulse_us) { return false; }
+void modelcar_idle_enter(modelcar_config_t *config) {}
+void modelcar_idle_output(void) {}
+
+#endif
+
+const modelcar_idle_stats_t *modelcar_idle_get_stats(void) { return &stats; }
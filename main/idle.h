@@ -0,0 +1,36 @@
+#ifndef _IDLE_H_
+#define _IDLE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "modelcar.h"
+
+/* how the car got through its idle periods, see MODELCAR_IDLE_POWERDOWN */
+struct modelcar_idle_stats_s
+{
+    uint32_t sleeps;
+    uint32_t slept_ms;        // of the last light sleep
+    uint32_t wake_output_us;  // last wake to the first pulse driven output
+    uint32_t wake_output_max_us;
+    uint32_t wake_late;       // wakes over MODELCAR_IDLE_WAKE_TARGET_MS
+};
+typedef struct modelcar_idle_stats_s modelcar_idle_stats_t;
+
+/* Early at boot, notes whether this boot is a wake from deep sleep. */
+void modelcar_idle_init(void);
+
+/* Control task only, on a queue timeout. True once neither a valid pulse
+ * since last_pulse_us nor a station was seen for the idle timeout. */
+bool modelcar_idle_due(uint32_t last_pulse_us);
+/* Control task only, with the outputs already staged at neutral. Stops the
+ * outputs and the radio and sleeps until the first edge on an input. Returns
+ * after a light sleep with the outputs running again at neutral, a deep
+ * sleep wake goes through the boot and modelcar_resume_restore instead. */
+void modelcar_idle_enter(modelcar_config_t *config);
+/* Control task only, after every pulse driven output. */
+void modelcar_idle_output(void);
+
+const modelcar_idle_stats_t *modelcar_idle_get_stats(void);
+
+#endif
@@ -1,6 +1,8 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
+#include "freertos/task.h"
+#include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,18 +10,48 @@
 #include "esp_event.h"
 #include "esp_log.h"
 #include "esp_ota_ops.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "nvs_flash.h"
 
 #include "driver/gpio.h"
 #include "driver/ledc.h"
 
+#include "calibration.h"
+#include "dhcp.h"
+#include "esc.h"
+#include "homie.h"
 #include "httpd.h"
+#include "idle.h"
+#include "metrics.h"
 #include "modelcar.h"
+#include "net.h"
+#include "ota.h"
+#include "portal.h"
+#include "profile.h"
+#include "receiver.h"
+#include "resume.h"
+#include "sync.h"
+#include "trace.h"
 #include "wifi-captive-portal/wifi-captive-portal-esp-idf-dns.h"
 
 #define TAG "modelcar_main"
 
+// the gpio isr keeps pointers into it
+static modelcar_config_t car_config = {
+#if CONFIG_MODELCAR_PROFILE_SWITCH
+    .input_channel_count = 3,
+#else
+    .input_channel_count = 2,
+#endif
+    .output_channel_count = 2,
+};
+
+#if CONFIG_MODELCAR_STATIC_ALLOCATION
+static StackType_t control_task_stack[CONFIG_MODELCAR_CONTROL_TASK_STACK_SIZE];
+static StaticTask_t control_task_buffer;
+#endif
+
 static void wifi_event_handler(void *arg, esp_event_base_t event_base,
                                int32_t event_id, void *event_data)
 {
@@ -29,6 +61,7 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
             (wifi_event_ap_staconnected_t *)event_data;
         ESP_LOGI(TAG, "station " MACSTR " join, AID=%d", MAC2STR(event->mac),
                  event->aid);
+        modelcar_portal_station_joined();
     }
     else if (event_id == WIFI_EVENT_AP_STADISCONNECTED)
     {
@@ -36,6 +69,7 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
             (wifi_event_ap_stadisconnected_t *)event_data;
         ESP_LOGI(TAG, "station " MACSTR " leave, AID=%d", MAC2STR(event->mac),
                  event->aid);
+        modelcar_portal_station_left();
     }
 }
 
@@ -43,7 +77,16 @@ void wifi_init_softap(void)
 {
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_t *ap_netif = esp_netif_create_default_wifi_ap();
+    // esp_netif_create_default_wifi_ap() without the DHCP server, dhcp.c
+    // answers instead
+    esp_netif_config_t netif_cfg = ESP_NETIF_DEFAULT_WIFI_AP();
+    esp_netif_inherent_config_t netif_base = *netif_cfg.base;
+    netif_base.flags &= ~ESP_NETIF_DHCP_SERVER;
+    netif_cfg.base = &netif_base;
+    esp_netif_t *ap_netif = esp_netif_new(&netif_cfg);
+    assert(ap_netif);
+    ESP_ERROR_CHECK(esp_netif_attach_wifi_ap(ap_netif));
+    ESP_ERROR_CHECK(esp_wifi_set_default_wifi_ap_handlers());
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
@@ -64,7 +107,13 @@ void wifi_init_softap(void)
         wifi_config.ap.authmode = WIFI_AUTH_OPEN;
     }
 
+#if CONFIG_MODELCAR_MQTT
+    // join the home network as well, for the broker
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA));
+    modelcar_homie_init();
+#else
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP));
+#endif
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &wifi_config));
     ESP_ERROR_CHECK(esp_wifi_start());
 
@@ -79,67 +128,95 @@ void wifi_init_softap(void)
     ip_info.netmask.addr =
         esp_ip4addr_aton((const char *)CONFIG_ESP_WIFI_NETMASK);
 
-    ESP_ERROR_CHECK(esp_netif_dhcps_stop(ap_netif));
     esp_netif_set_ip_info(ap_netif, &ip_info);
-    ESP_ERROR_CHECK(esp_netif_dhcps_start(ap_netif));
     ESP_LOGI(TAG, "wifi_network setup finished IP %s Netmask %s",
              CONFIG_ESP_WIFI_IP, CONFIG_ESP_WIFI_NETMASK);
 
+    modelcar_dhcp_init();
     wifi_captive_portal_esp_idf_dns_init();
+    modelcar_net_start();
 }
 
-void app_main(void)
+/* Receiver pulses to outputs, started as soon as a profile is in place */
+static void control_task(void *arg)
 {
-    const esp_partition_t *current_partition = esp_ota_get_running_partition();
-    const esp_app_desc_t *app_desc = esp_ota_get_app_description();
-    ESP_LOGI(TAG, "running partition %s version %s", current_partition->label,
-             app_desc->version);
-
-    // Initialize NVS
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES ||
-        ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
+    modelcar_slew_t throttle_slew = {0};
+    uint8_t switch_pos = MODELCAR_PROFILE_COUNT; // unknown until stable
+    uint8_t switch_pending = 0;
+    uint8_t switch_count = 0;
+    uint8_t last_profile_idx = modelcar_profile_active();
+    const modelcar_profile_t *saved_profile = NULL;
+    modelcar_resume_state_t resume_state = {
+        .throttle_mode = car_config.drive_mode[1],
+        .duty = {car_config.output_channel[0].duty,
+                 car_config.output_channel[1].duty},
+    };
+    uint32_t last_pulse_us = esp_timer_get_time();
+    const modelcar_resume_stats_t *resume = modelcar_resume_get_stats();
+    if (resume->resumed)
     {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
+        // a brownout mid-drive must not snap the throttle back to neutral
+        modelcar_slew_seed(&throttle_slew, resume_state.duty[1],
+                           resume->restore_us);
     }
-    ESP_ERROR_CHECK(ret);
-
-    modelcar_config_t car_config = {
-        .input_channel_count = 2,
-        .output_channel_count = 2,
-    };
-    modelcar_init_output_channel(&car_config.output_channel[0],
-                                 CONFIG_SERVO1_OUTPUT_PORT_NUM, LEDC_CHANNEL_0);
-    modelcar_init_input_channel(&car_config.input_channel[0],
-                                CONFIG_SERVO1_INPUT_PORT_NUM);
-    modelcar_init_output_channel(&car_config.output_channel[1],
-                                 CONFIG_SERVO2_OUTPUT_PORT_NUM, LEDC_CHANNEL_1);
-    modelcar_init_input_channel(&car_config.input_channel[1],
-                                CONFIG_SERVO2_INPUT_PORT_NUM);
-    modelcar_init(&car_config);
-
-    wifi_init_softap();
-    modelcar_httpd_start_webserver();
-
-    ESP_LOGI(TAG, "Minimum free heap size: %d bytes",
-             esp_get_minimum_free_heap_size());
 
     while (1)
     {
+        modelcar_ota_check_health();
         modelcar_queue_value_t value;
         if (xQueueReceive(car_config.gpio_evt_queue, &value,
                           500 / portTICK_RATE_MS))
         {
+            modelcar_receiver_sample(value.channel_idx, value.pulse_width,
+                                     value.timestamp);
+            if (value.pulse_width < MODELCAR_PULSE_MIN_US ||
+                value.pulse_width > MODELCAR_PULSE_MAX_US)
+            {
+                MODELCAR_METRIC_INC(pulses_rejected[value.channel_idx]);
+                continue;
+            }
+            MODELCAR_METRIC_INC(pulses[value.channel_idx]);
+            last_pulse_us = value.timestamp;
+            modelcar_metrics.pulse_width_us[value.channel_idx] =
+                value.pulse_width;
+            MODELCAR_TRACE_BEGIN("pulse");
+
+            // one profile for the whole pulse, switches apply on the next
+            uint8_t profile_idx = modelcar_profile_active();
+            const modelcar_profile_t *profile = modelcar_profile_current();
+            if (profile_idx != last_profile_idx)
+            {
+                last_profile_idx = profile_idx;
+                MODELCAR_METRIC_INC(profile_switches);
+            }
+            // every update flips the buffer, so a new pointer means new data
+            if (profile != saved_profile)
+            {
+                saved_profile = profile;
+                modelcar_resume_save_profile(profile_idx, profile);
+            }
+            modelcar_calibration_sample(value.channel_idx, value.pulse_width,
+                                        value.timestamp);
+            modelcar_sync_input(value.channel_idx,
+                                value.timestamp - value.pulse_width);
+
             switch (value.channel_idx)
             {
             case 0:
             {
-                uint32_t modified_dc = modelcar_update_output_by_us(
-                    &car_config.output_channel[0], value.pulse_width,
-                    modelcar_httpd_get_servo1_factor(),
-                    modelcar_httpd_get_servo1_offset(),
-                    modelcar_httpd_get_servo1_limit());
+                uint32_t modified_dc = modelcar_transfer_lookup(
+                    &profile->transfer[MODELCAR_TRANSFER_STEERING],
+                    value.pulse_width);
+                if (!value.written)
+                {
+                    modelcar_update_output_by_duty(&car_config, 0, modified_dc);
+                    MODELCAR_METRIC_WRITE_LATENCY(
+                        0, (uint32_t)esp_timer_get_time() - value.timestamp);
+                }
+                resume_state.duty[0] = modified_dc;
+                modelcar_resume_save_state(&resume_state);
+                modelcar_resume_first_output();
+                modelcar_idle_output();
 #if 1
                 ESP_LOGI(TAG, "val servo%d: %d us %d us %f %% %d us",
                          value.channel_idx + 1, value.pulse_width,
@@ -154,14 +231,33 @@ void app_main(void)
             {
                 modelcar_update_drivemode(&car_config.drive_mode[1],
                                           value.pulse_width,
-                                          modelcar_httpd_get_servo2_offset());
-                uint32_t modified_dc = modelcar_update_output_by_us(
-                    &car_config.output_channel[1], value.pulse_width,
+                                          profile->throttle_offset);
+                modelcar_transfer_id_t id =
                     (car_config.drive_mode[1] >= BREAK)
-                        ? 1
-                        : modelcar_httpd_get_servo2_factor(),
-                    modelcar_httpd_get_servo2_offset(),
-                    modelcar_httpd_get_servo2_limit());
+                        ? MODELCAR_TRANSFER_THROTTLE_BRAKE
+                        : MODELCAR_TRANSFER_THROTTLE;
+                // the sticks go to their endpoints while calibrating
+                uint32_t target = modelcar_calibration_running()
+                                      ? profile->throttle_neutral[id]
+                                      : modelcar_transfer_lookup(
+                                            &profile->transfer[id],
+                                            value.pulse_width);
+                uint32_t modified_dc = modelcar_slew_step(
+                    &throttle_slew, &profile->slew, car_config.drive_mode[1],
+                    profile->throttle_neutral[id], target, value.timestamp);
+                modelcar_update_output_by_duty(&car_config, 1, modified_dc);
+                MODELCAR_METRIC_WRITE_LATENCY(
+                    1, (uint32_t)esp_timer_get_time() - value.timestamp);
+                // the throttle frame is the reference for the output phase
+                if (modelcar_sync_output(1))
+                {
+                    modelcar_rescale_outputs(&car_config);
+                }
+                resume_state.throttle_mode = car_config.drive_mode[1];
+                resume_state.duty[1] = modified_dc;
+                modelcar_resume_save_state(&resume_state);
+                modelcar_resume_first_output();
+                modelcar_idle_output();
 #if 1
                 ESP_LOGI(TAG, "val servo%d: %d us %d us %f %% %d us %d mode",
                          value.channel_idx + 1, value.pulse_width,
@@ -172,13 +268,141 @@ void app_main(void)
 #endif
             };
             break;
+#if CONFIG_MODELCAR_PROFILE_SWITCH
+            case 2:
+            {
+                // act on a new position once it was seen on a few pulses
+                uint8_t pos = modelcar_profile_by_us(value.pulse_width);
+                if (pos != switch_pending)
+                {
+                    switch_pending = pos;
+                    switch_count = 0;
+                }
+                else if (switch_count < 3 && ++switch_count == 3 &&
+                         pos != switch_pos)
+                {
+                    switch_pos = pos;
+                    modelcar_profile_select(pos);
+                    ESP_LOGI(TAG, "profile switch to %d", pos);
+                }
+            };
+            break;
+#endif
             default:
                 break;
             }
+            MODELCAR_TRACE_END("pulse");
+        }
+        else if (modelcar_idle_due(last_pulse_us))
+        {
+            // park at neutral, also what a deep sleep wake resumes with
+            const modelcar_profile_t *profile = modelcar_profile_current();
+            car_config.drive_mode[1] = NEUTRAL;
+            throttle_slew = (modelcar_slew_t){0};
+            resume_state.throttle_mode = NEUTRAL;
+            resume_state.duty[0] = profile->steering_neutral;
+            resume_state.duty[1] =
+                profile->throttle_neutral[MODELCAR_TRANSFER_THROTTLE];
+            for (int i = 0; i < MODELCAR_RESUME_OUTPUTS; ++i)
+            {
+                // the isr owns a pass-through output, it holds the last pulse
+                if (car_config.input_channel[i].passthrough != NULL)
+                {
+                    continue;
+                }
+                modelcar_update_output_by_duty(&car_config, i,
+                                               resume_state.duty[i]);
+            }
+            modelcar_resume_save_state(&resume_state);
+            modelcar_idle_enter(&car_config);
+            last_pulse_us = esp_timer_get_time();
         }
         else
         {
             ESP_LOGW(TAG, "timeout");
         }
     }
-}
\ No newline at end of file
+}
+
+static void control_start(void)
+{
+#if CONFIG_MODELCAR_STEERING_PASSTHROUGH
+    // steering is stateless, let the isr write it once the profiles are built
+    car_config.input_channel[0].passthrough_transfer =
+        MODELCAR_TRANSFER_STEERING;
+    car_config.input_channel[0].passthrough = &car_config.output_channel[0];
+    car_config.output_frame_mask &= ~(1 << 0);
+#endif
+    // above the portal services, so their traffic cannot delay the outputs
+#if CONFIG_MODELCAR_STATIC_ALLOCATION
+    xTaskCreateStatic(control_task, "control",
+                      CONFIG_MODELCAR_CONTROL_TASK_STACK_SIZE, NULL,
+                      CONFIG_MODELCAR_CONTROL_TASK_PRIORITY, control_task_stack,
+                      &control_task_buffer);
+#else
+    xTaskCreate(control_task, "control",
+                CONFIG_MODELCAR_CONTROL_TASK_STACK_SIZE, NULL,
+                CONFIG_MODELCAR_CONTROL_TASK_PRIORITY, NULL);
+#endif
+}
+
+void app_main(void)
+{
+    const esp_partition_t *current_partition = esp_ota_get_running_partition();
+    const esp_app_desc_t *app_desc = esp_ota_get_app_description();
+    ESP_LOGI(TAG, "running partition %s version %s", current_partition->label,
+             app_desc->version);
+
+    modelcar_init_output_channel(&car_config.output_channel[0],
+                                 CONFIG_SERVO1_OUTPUT_PORT_NUM, LEDC_CHANNEL_0);
+    modelcar_init_input_channel(&car_config.input_channel[0],
+                                CONFIG_SERVO1_INPUT_PORT_NUM);
+    modelcar_init_output_channel(&car_config.output_channel[1],
+                                 CONFIG_SERVO2_OUTPUT_PORT_NUM, LEDC_CHANNEL_1);
+    car_config.output_channel[1].protocol = MODELCAR_ESC_THROTTLE_PROTOCOL;
+    modelcar_init_input_channel(&car_config.input_channel[1],
+                                CONFIG_SERVO2_INPUT_PORT_NUM);
+#if CONFIG_MODELCAR_PROFILE_SWITCH
+    modelcar_init_input_channel(&car_config.input_channel[2],
+                                CONFIG_SERVO3_INPUT_PORT_NUM);
+#endif
+
+    // after a brownout mid-drive, drive on before NVS and WiFi are up
+    modelcar_resume_state_t resume_state;
+    bool resumed = modelcar_resume_restore(&resume_state);
+    modelcar_idle_init();
+    modelcar_init(&car_config);
+    if (resumed)
+    {
+        car_config.drive_mode[1] = resume_state.throttle_mode;
+        for (int i = 0; i < MODELCAR_RESUME_OUTPUTS; ++i)
+        {
+            modelcar_update_output_by_duty(&car_config, i,
+                                           resume_state.duty[i]);
+        }
+        control_start();
+    }
+
+    // Initialize NVS
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES ||
+        ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
+    {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(ret);
+    modelcar_ota_init();
+
+    // portal services wait for the first station, see wifi_event_handler
+    modelcar_portal_init();
+    modelcar_httpd_init();
+    if (!resumed)
+    {
+        control_start();
+    }
+    wifi_init_softap();
+
+    ESP_LOGI(TAG, "Minimum free heap size: %d bytes",
+             esp_get_minimum_free_heap_size());
+}
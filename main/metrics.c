@@ -0,0 +1,322 @@
+#include "metrics.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "esp_system.h"
+#include "freertos/task.h"
+
+#include "httpd.h"
+#include "idle.h"
+#include "portal.h"
+#include "profile.h"
+#include "resume.h"
+#include "sync.h"
+#include "wifi-captive-portal/wifi-captive-portal-esp-idf-dns.h"
+#include "wifi-captive-portal/wifi-captive-portal-esp-idf-httpd.h"
+
+#define METRICS_MAX_TASKS 24
+
+modelcar_metrics_t modelcar_metrics;
+
+static xQueueHandle pulse_queue;
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY &&                                      \
+    CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+static TaskStatus_t task_status[METRICS_MAX_TASKS];
+// run time counters of the previous scrape to report the share in between
+static TaskHandle_t prev_handle[METRICS_MAX_TASKS];
+static uint32_t prev_runtime[METRICS_MAX_TASKS];
+static uint32_t prev_total;
+#endif
+
+struct metrics_writer_s
+{
+    char *buf;
+    size_t size;
+    size_t len;
+};
+typedef struct metrics_writer_s metrics_writer_t;
+
+static void metrics_printf(metrics_writer_t *w, const char *fmt, ...)
+{
+    if (w->len >= w->size)
+    {
+        return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(w->buf + w->len, w->size - w->len, fmt, args);
+    va_end(args);
+    if (n > 0)
+    {
+        w->len += n;
+    }
+}
+
+static void metrics_header(metrics_writer_t *w, const char *name,
+                           const char *type, const char *help)
+{
+    metrics_printf(w, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void metrics_channels(metrics_writer_t *w, const char *name,
+                             const char *help,
+                             const volatile uint32_t *counter)
+{
+    metrics_header(w, name, "counter", help);
+    for (int i = 0; i < MODELCAR_METRICS_CHANNELS; ++i)
+    {
+        metrics_printf(w, "%s{channel=\"%d\"} %u\n", name, i + 1, counter[i]);
+    }
+}
+
+static void metrics_tasks(metrics_writer_t *w)
+{
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY &&                                      \
+    CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    uint32_t total = 0;
+    UBaseType_t count =
+        uxTaskGetSystemState(task_status, METRICS_MAX_TASKS, &total);
+    uint32_t elapsed = total - prev_total;
+
+    metrics_header(w, "modelcar_task_cpu_percent", "gauge",
+                   "CPU share since the previous scrape");
+    for (int i = 0; i < count; ++i)
+    {
+        uint32_t before = 0;
+        for (int j = 0; j < METRICS_MAX_TASKS; ++j)
+        {
+            if (prev_handle[j] == task_status[i].xHandle)
+            {
+                before = prev_runtime[j];
+                break;
+            }
+        }
+        uint32_t share =
+            elapsed ? (uint64_t)(task_status[i].ulRunTimeCounter - before) *
+                          100 / elapsed
+                    : 0;
+        metrics_printf(w, "modelcar_task_cpu_percent{task=\"%s\"} %u\n",
+                       task_status[i].pcTaskName, share);
+    }
+
+    metrics_header(w, "modelcar_task_stack_free_bytes", "gauge",
+                   "Stack high water mark");
+    for (int i = 0; i < count; ++i)
+    {
+        metrics_printf(w, "modelcar_task_stack_free_bytes{task=\"%s\"} %u\n",
+                       task_status[i].pcTaskName,
+                       task_status[i].usStackHighWaterMark);
+    }
+
+    for (int i = 0; i < METRICS_MAX_TASKS; ++i)
+    {
+        prev_handle[i] = i < count ? task_status[i].xHandle : NULL;
+        prev_runtime[i] = i < count ? task_status[i].ulRunTimeCounter : 0;
+    }
+    prev_total = total;
+#else
+    metrics_printf(w, "# task metrics need "
+                      "CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS\n");
+#endif
+}
+
+void modelcar_metrics_set_queue(xQueueHandle queue) { pulse_queue = queue; }
+
+size_t modelcar_metrics_render(char *buf, size_t size)
+{
+    metrics_writer_t w = {.buf = buf, .size = size, .len = 0};
+
+    metrics_header(&w, "modelcar_heap_free_bytes", "gauge", "Free heap");
+    metrics_printf(&w, "modelcar_heap_free_bytes %u\n",
+                   esp_get_free_heap_size());
+    metrics_header(&w, "modelcar_heap_min_free_bytes", "gauge",
+                   "Lowest free heap since boot");
+    metrics_printf(&w, "modelcar_heap_min_free_bytes %u\n",
+                   esp_get_minimum_free_heap_size());
+
+    metrics_tasks(&w);
+
+    const modelcar_resume_stats_t *boot = modelcar_resume_get_stats();
+    metrics_header(&w, "modelcar_boot_resumed", "gauge",
+                   "1 when the outputs came from the RTC snapshot");
+    metrics_printf(&w, "modelcar_boot_resumed %u\n", boot->resumed);
+    metrics_header(&w, "modelcar_boot_reset_reason", "gauge",
+                   "esp_reset_reason_t of this boot");
+    metrics_printf(&w, "modelcar_boot_reset_reason %u\n", boot->reset_reason);
+    metrics_header(&w, "modelcar_boot_restore_us", "gauge",
+                   "Time after boot the snapshot was applied");
+    metrics_printf(&w, "modelcar_boot_restore_us %u\n", boot->restore_us);
+    metrics_header(&w, "modelcar_boot_first_output_us", "gauge",
+                   "Time after boot of the first pulse driven output");
+    metrics_printf(&w, "modelcar_boot_first_output_us %u\n",
+                   boot->first_output_us);
+
+#if CONFIG_MODELCAR_IDLE_POWERDOWN
+    const modelcar_idle_stats_t *idle = modelcar_idle_get_stats();
+    metrics_header(&w, "modelcar_idle_sleeps_total", "counter",
+                   "Idle power downs since boot");
+    metrics_printf(&w, "modelcar_idle_sleeps_total %u\n", idle->sleeps);
+    metrics_header(&w, "modelcar_idle_slept_ms", "gauge",
+                   "Length of the last light sleep");
+    metrics_printf(&w, "modelcar_idle_slept_ms %u\n", idle->slept_ms);
+    metrics_header(&w, "modelcar_idle_wake_output_us", "gauge",
+                   "Last wake to the first pulse driven output");
+    metrics_printf(&w, "modelcar_idle_wake_output_us %u\n",
+                   idle->wake_output_us);
+    metrics_header(&w, "modelcar_idle_wake_output_us_max", "gauge",
+                   "Slowest wake to the first pulse driven output");
+    metrics_printf(&w, "modelcar_idle_wake_output_us_max %u\n",
+                   idle->wake_output_max_us);
+    metrics_header(&w, "modelcar_idle_wake_late_total", "counter",
+                   "Wakes over MODELCAR_IDLE_WAKE_TARGET_MS");
+    metrics_printf(&w, "modelcar_idle_wake_late_total %u\n", idle->wake_late);
+#endif
+
+    metrics_header(&w, "modelcar_portal_stations", "gauge",
+                   "Associated stations, portal services run while > 0");
+    metrics_printf(&w, "modelcar_portal_stations %u\n",
+                   modelcar_portal_get_stations());
+
+    metrics_header(&w, "modelcar_pulse_queue_depth", "gauge",
+                   "Pulses waiting for the control loop");
+    metrics_printf(&w, "modelcar_pulse_queue_depth %u\n",
+                   pulse_queue ? uxQueueMessagesWaiting(pulse_queue) : 0);
+    metrics_channels(&w, "modelcar_pulses_total", "Processed pulses",
+                     modelcar_metrics.pulses);
+    metrics_header(&w, "modelcar_pulse_width_us", "gauge",
+                   "Last accepted pulse width");
+    for (int i = 0; i < MODELCAR_METRICS_CHANNELS; ++i)
+    {
+        metrics_printf(&w, "modelcar_pulse_width_us{channel=\"%d\"} %u\n",
+                       i + 1, modelcar_metrics.pulse_width_us[i]);
+    }
+    metrics_channels(&w, "modelcar_pulses_rejected_total",
+                     "Pulses outside the plausible width",
+                     modelcar_metrics.pulses_rejected);
+    metrics_channels(&w, "modelcar_pulses_dropped_total",
+                     "Pulses lost on a full queue",
+                     modelcar_metrics.pulses_dropped);
+    metrics_channels(&w, "modelcar_output_writes_total",
+                     "Duty writes per input channel",
+                     modelcar_metrics.output_writes);
+    metrics_channels(&w, "modelcar_output_write_latency_us_total",
+                     "Summed time from falling input edge to duty write",
+                     modelcar_metrics.output_write_latency_us);
+    metrics_channels(&w, "modelcar_output_duty_writes_total",
+                     "Changed duties written to the LEDC per output",
+                     modelcar_metrics.output_duty_writes);
+    metrics_channels(&w, "modelcar_output_duty_skipped_total",
+                     "Unchanged duties not written per output",
+                     modelcar_metrics.output_duty_skipped);
+    metrics_header(&w, "modelcar_output_commits_total", "counter",
+                   "Batches of staged duties handed to the LEDC");
+    metrics_printf(&w, "modelcar_output_commits_total %u\n",
+                   modelcar_metrics.output_commits);
+    metrics_header(&w, "modelcar_output_write_latency_us_max", "gauge",
+                   "Slowest falling input edge to duty write");
+    for (int i = 0; i < MODELCAR_METRICS_CHANNELS; ++i)
+    {
+        metrics_printf(&w,
+                       "modelcar_output_write_latency_us_max{channel=\"%d\"}"
+                       " %u\n",
+                       i + 1, modelcar_metrics.output_write_latency_us_max[i]);
+    }
+
+    const modelcar_sync_stats_t *sync = modelcar_sync_get_stats();
+    metrics_header(&w, "modelcar_input_period_us", "gauge",
+                   "Averaged receiver frame period per channel");
+    for (int i = 0; i < MODELCAR_SYNC_CHANNELS; ++i)
+    {
+        metrics_printf(&w, "modelcar_input_period_us{channel=\"%d\"} %u\n",
+                       i + 1, sync->input_period_us[i]);
+    }
+    metrics_header(&w, "modelcar_output_phase_error_us", "gauge",
+                   "Averaged distance of the duty write from its target lead");
+    metrics_printf(&w, "modelcar_output_phase_error_us %d\n",
+                   sync->phase_error_us);
+    metrics_header(&w, "modelcar_output_latency_us", "gauge",
+                   "Averaged time from throttle duty write to LEDC latch");
+    metrics_printf(&w, "modelcar_output_latency_us %u\n", sync->latency_us);
+    metrics_header(&w, "modelcar_output_latency_saved_us", "gauge",
+                   "Latency saved against an output at a random phase");
+    metrics_printf(&w, "modelcar_output_latency_saved_us %d\n",
+                   sync->latency_saved_us);
+    metrics_header(&w, "modelcar_output_period_us", "gauge",
+                   "Output period, trimmed to follow the receiver");
+    metrics_printf(&w, "modelcar_output_period_us %u\n",
+                   sync->output_period_us);
+    metrics_header(&w, "modelcar_output_locked", "gauge",
+                   "1 while the output period follows the receiver frame");
+    metrics_printf(&w, "modelcar_output_locked %u\n", sync->locked);
+
+    metrics_header(&w, "modelcar_profile_active", "gauge",
+                   "1 for the profile the control loop uses");
+    for (int i = 0; i < MODELCAR_PROFILE_COUNT; ++i)
+    {
+        metrics_printf(&w,
+                       "modelcar_profile_active{profile=\"%d\",name=\"%s\"}"
+                       " %d\n",
+                       i, modelcar_httpd_get_profile_name(i),
+                       i == modelcar_profile_active());
+    }
+    metrics_header(&w, "modelcar_profile_switches_total", "counter",
+                   "Profile changes seen by the control loop");
+    metrics_printf(&w, "modelcar_profile_switches_total %u\n",
+                   modelcar_metrics.profile_switches);
+
+    metrics_header(&w, "modelcar_nvs_writes_total", "counter",
+                   "Config commits to NVS");
+    metrics_printf(&w, "modelcar_nvs_writes_total %u\n",
+                   modelcar_metrics.nvs_writes);
+
+    const modelcar_ratelimit_t *http = modelcar_httpd_get_ratelimit();
+    const modelcar_ratelimit_t *dns =
+        wifi_captive_portal_esp_idf_dns_ratelimit();
+    metrics_header(&w, "modelcar_requests_total", "counter",
+                   "Requests by service and rate limit result");
+    metrics_printf(&w,
+                   "modelcar_requests_total{service=\"http\",result=\"passed\"}"
+                   " %u\n",
+                   http->passed);
+    metrics_printf(&w,
+                   "modelcar_requests_total{service=\"http\",result="
+                   "\"dropped\"} %u\n",
+                   http->dropped);
+    metrics_printf(&w,
+                   "modelcar_requests_total{service=\"dns\",result=\"passed\"}"
+                   " %u\n",
+                   dns->passed);
+    metrics_printf(&w,
+                   "modelcar_requests_total{service=\"dns\",result=\"dropped\"}"
+                   " %u\n",
+                   dns->dropped);
+
+    metrics_header(&w, "modelcar_portal_probes_total", "counter",
+                   "OS connectivity probes redirected to the portal");
+    metrics_printf(&w, "modelcar_portal_probes_total %u\n",
+                   wifi_captive_portal_esp_idf_httpd_probe_hits());
+
+    metrics_header(&w, "modelcar_portal_api_requests_total", "counter",
+                   "RFC 8908 captive portal API lookups");
+    metrics_printf(&w, "modelcar_portal_api_requests_total %u\n",
+                   modelcar_metrics.captive_api_requests);
+    metrics_header(&w, "modelcar_dhcp_leases_total", "counter",
+                   "DHCP leases acknowledged, each announcing the portal API");
+    metrics_printf(&w, "modelcar_dhcp_leases_total %u\n",
+                   modelcar_metrics.dhcp_leases);
+
+    const modelcar_httpd_dispatch_stats_t *dispatch =
+        modelcar_httpd_get_dispatch_stats();
+    metrics_header(&w, "modelcar_http_dispatch_cycles_total", "counter",
+                   "CPU cycles spent resolving routes");
+    metrics_printf(&w, "modelcar_http_dispatch_cycles_total %llu\n",
+                   (unsigned long long)dispatch->cycles_total);
+    metrics_header(&w, "modelcar_http_dispatch_cycles_max", "gauge",
+                   "Slowest route resolution");
+    metrics_printf(&w, "modelcar_http_dispatch_cycles_max %u\n",
+                   dispatch->cycles_max);
+
+    return w.len < size ? w.len : size - 1;
+}
@@ -0,0 +1,61 @@
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#define MODELCAR_METRICS_CHANNELS 4
+
+/* Counters updated from the hot paths without locking. Every field has exactly
+ * one writer (noted per field) and aligned 32 bit stores are atomic, so a
+ * reader always sees a consistent value. */
+struct modelcar_metrics_s
+{
+    // control task
+    volatile uint32_t pulses[MODELCAR_METRICS_CHANNELS];
+    volatile uint32_t pulses_rejected[MODELCAR_METRICS_CHANNELS];
+    volatile uint32_t pulse_width_us[MODELCAR_METRICS_CHANNELS]; // last one
+    volatile uint32_t profile_switches;
+    volatile uint32_t output_duty_writes[MODELCAR_METRICS_CHANNELS];
+    volatile uint32_t output_duty_skipped[MODELCAR_METRICS_CHANNELS];
+    volatile uint32_t output_commits;
+    // gpio isr, pulse lost because the queue was full
+    volatile uint32_t pulses_dropped[MODELCAR_METRICS_CHANNELS];
+    // gpio isr for pass-through channels, control task for the others
+    volatile uint32_t output_writes[MODELCAR_METRICS_CHANNELS];
+    volatile uint32_t output_write_latency_us[MODELCAR_METRICS_CHANNELS];
+    volatile uint32_t output_write_latency_us_max[MODELCAR_METRICS_CHANNELS];
+    // httpd task
+    volatile uint32_t nvs_writes;
+    volatile uint32_t captive_api_requests;
+    // network task
+    volatile uint32_t dhcp_leases;
+};
+typedef struct modelcar_metrics_s modelcar_metrics_t;
+
+extern modelcar_metrics_t modelcar_metrics;
+
+#define MODELCAR_METRIC_INC(counter) (modelcar_metrics.counter++)
+
+/* falling input edge to duty register write, usable from the isr */
+#define MODELCAR_METRIC_WRITE_LATENCY(ch, us)                                  \
+    do                                                                         \
+    {                                                                          \
+        uint32_t latency_ = (us);                                              \
+        modelcar_metrics.output_writes[ch]++;                                  \
+        modelcar_metrics.output_write_latency_us[ch] += latency_;              \
+        if (latency_ > modelcar_metrics.output_write_latency_us_max[ch])       \
+        {                                                                      \
+            modelcar_metrics.output_write_latency_us_max[ch] = latency_;       \
+        }                                                                      \
+    } while (0)
+
+void modelcar_metrics_set_queue(xQueueHandle queue);
+/* Render all metrics in Prometheus text format into buf, returns the length.
+ * Not reentrant, only call it from the httpd task. */
+size_t modelcar_metrics_render(char *buf, size_t size);
+
+#endif
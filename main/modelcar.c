@@ -1,20 +1,57 @@
 #include "modelcar.h"
+#include "esc.h"
+#include "metrics.h"
+#include "profile.h"
+#include "sync.h"
+#include "trace.h"
 
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "driver/gpio.h"
 #include "driver/ledc.h"
-#include <math.h>
+#include "hal/gpio_ll.h"
+#include "soc/gpio_struct.h"
+
+#if CONFIG_MODELCAR_STEERING_PASSTHROUGH
+#include "hal/ledc_ll.h"
+#include "soc/ledc_struct.h"
+#endif
 
 #define TAG "modelcar modelcar"
 
-#define ESP_INTR_FLAG_DEFAULT 0
+#if CONFIG_MODELCAR_STATIC_ALLOCATION
+static uint8_t gpio_evt_queue_storage[CONFIG_MODELCAR_PULSE_QUEUE_LENGTH *
+                                      sizeof(modelcar_queue_value_t)];
+static StaticQueue_t gpio_evt_queue_buffer;
+#endif
+
+#if CONFIG_MODELCAR_STEERING_PASSTHROUGH
+/* What ledc_set_duty() + ledc_update_duty() do, minus the driver's checks and
+ * locks. Only the isr writes to a pass-through channel, so no other context
+ * touches these registers. */
+static inline void IRAM_ATTR passthrough_write(uint8_t ledchannel,
+                                               uint32_t duty)
+{
+    ledc_ll_set_duty_int_part(&LEDC, LEDC_LOW_SPEED_MODE, ledchannel, duty);
+    ledc_ll_set_duty_direction(&LEDC, LEDC_LOW_SPEED_MODE, ledchannel,
+                               LEDC_DUTY_DIR_INCREASE);
+    ledc_ll_set_duty_num(&LEDC, LEDC_LOW_SPEED_MODE, ledchannel, 1);
+    ledc_ll_set_duty_cycle(&LEDC, LEDC_LOW_SPEED_MODE, ledchannel, 1);
+    ledc_ll_set_duty_scale(&LEDC, LEDC_LOW_SPEED_MODE, ledchannel, 0);
+    ledc_ll_set_duty_start(&LEDC, LEDC_LOW_SPEED_MODE, ledchannel, true);
+    ledc_ll_ls_channel_update(&LEDC, LEDC_LOW_SPEED_MODE, ledchannel);
+}
+#endif
 
 static void IRAM_ATTR gpio_isr_handler(void *arg)
 {
     modelcar_input_channel_t *channel = (modelcar_input_channel_t *)arg;
+    BaseType_t woken = pdFALSE;
+    MODELCAR_TRACE_ISR_BEGIN("gpio_isr");
 
-    if (gpio_get_level(channel->portnum))
+    // gpio_get_level() lives in flash
+    if (gpio_ll_get_level(&GPIO, channel->portnum))
     {
         channel->val_begin_of_sample = esp_timer_get_time();
         channel->val_end_of_sample = channel->val_begin_of_sample;
@@ -25,42 +62,38 @@ static void IRAM_ATTR gpio_isr_handler(void *arg)
         modelcar_queue_value_t value = {
             .pulse_width =
                 channel->val_end_of_sample - channel->val_begin_of_sample,
+            .timestamp = channel->val_end_of_sample,
             .channel_idx = channel->channel_idx,
         };
-        xQueueSendFromISR(*(channel->gpio_evt_queue), &value, NULL);
-    }
-}
-
-uint32_t DutyCyclePercentageToDuty(float per)
-{
-    return per / 100.0f * pow(2, LEDC_TIMER_13_BIT);
-}
-
-float DutyCycleScale(float per, float scale)
-{
-    return 7.5f + ((per - 7.5f) * scale);
-}
-
-float DutyCycleUsToPercentage(int32_t us)
-{
-    return us / 200.0f /* us to percent at 50hz*/;
-}
-
-uint32_t DutyCycleOffset(uint32_t us, int offset) { return us + offset; }
-
-float DutyCycleLimit(float per, float limit, int offset)
-{
-    per -= 7.5f - DutyCycleUsToPercentage(offset);
-    const float neutral = 7.5f * 0.5f;
-    if (per > neutral * limit)
-    {
-        per = neutral * limit;
+#if CONFIG_MODELCAR_STEERING_PASSTHROUGH
+        const modelcar_output_channel_t *out = channel->passthrough;
+        if (out && value.pulse_width >= MODELCAR_PULSE_MIN_US &&
+            value.pulse_width <= MODELCAR_PULSE_MAX_US)
+        {
+            const modelcar_profile_t *profile = modelcar_profile_current();
+            passthrough_write(
+                out->ledchannel,
+                modelcar_sync_duty(modelcar_transfer_lookup(
+                    &profile->transfer[channel->passthrough_transfer],
+                    value.pulse_width)));
+            value.written = 1;
+            MODELCAR_METRIC_WRITE_LATENCY(
+                channel->channel_idx,
+                (uint32_t)esp_timer_get_time() - value.timestamp);
+        }
+#endif
+        if (xQueueSendFromISR(*(channel->gpio_evt_queue), &value, &woken) !=
+            pdTRUE)
+        {
+            MODELCAR_METRIC_INC(pulses_dropped[channel->channel_idx]);
+        }
     }
-    else if (per < -neutral * limit)
+    MODELCAR_TRACE_ISR_END("gpio_isr");
+    // switch to the control task right away, not with the next tick
+    if (woken)
     {
-        per = -neutral * limit;
+        portYIELD_FROM_ISR();
     }
-    return 7.5f - DutyCycleUsToPercentage(offset) + per;
 }
 
 void modelcar_init_output_channel(modelcar_output_channel_t *channel,
@@ -68,6 +101,9 @@ void modelcar_init_output_channel(modelcar_output_channel_t *channel,
 {
     channel->portnum = portnum;
     channel->ledchannel = ledchannel;
+    channel->duty = 0;
+    channel->pending = 0;
+    channel->protocol = MODELCAR_ESC_PWM;
 }
 
 void modelcar_init_input_channel(modelcar_input_channel_t *channel,
@@ -76,11 +112,20 @@ void modelcar_init_input_channel(modelcar_input_channel_t *channel,
     channel->portnum = portnum;
     channel->val_begin_of_sample = 0;
     channel->val_end_of_sample = 0;
+    channel->passthrough = NULL;
 }
 
 void modelcar_init(modelcar_config_t *config)
 {
-    config->gpio_evt_queue = xQueueCreate(10, sizeof(modelcar_queue_value_t));
+#if CONFIG_MODELCAR_STATIC_ALLOCATION
+    config->gpio_evt_queue = xQueueCreateStatic(
+        CONFIG_MODELCAR_PULSE_QUEUE_LENGTH, sizeof(modelcar_queue_value_t),
+        gpio_evt_queue_storage, &gpio_evt_queue_buffer);
+#else
+    config->gpio_evt_queue = xQueueCreate(CONFIG_MODELCAR_PULSE_QUEUE_LENGTH,
+                                          sizeof(modelcar_queue_value_t));
+#endif
+    modelcar_metrics_set_queue(config->gpio_evt_queue);
 
     // zero-initialize the config structure.
     gpio_config_t io_conf = {};
@@ -99,8 +144,9 @@ void modelcar_init(modelcar_config_t *config)
     io_conf.pull_up_en = 1;
     gpio_config(&io_conf);
 
-    // install gpio isr service
-    gpio_install_isr_service(ESP_INTR_FLAG_DEFAULT);
+    // install gpio isr service, in IRAM it keeps measuring pulses while the
+    // flash cache is off, e.g. during OTA writes
+    gpio_install_isr_service(ESP_INTR_FLAG_IRAM);
     // hook isr handler for specific gpio pin
     for (int i = 0; i < config->input_channel_count; ++i)
     {
@@ -120,13 +166,23 @@ void modelcar_init(modelcar_config_t *config)
         .freq_hz = 50,                        // frequency of PWM signal
         .speed_mode = LEDC_LOW_SPEED_MODE,    // timer mode
         .timer_num = LEDC_TIMER_1,            // timer index
-        .clk_cfg = LEDC_AUTO_CLK,             // Auto select the source clock
+        .clk_cfg = LEDC_USE_APB_CLK,          // sync.c trims its divider
     };
     // Set configuration of timer0 for high speed channels
     ledc_timer_config(&ledc_timer);
 
+    config->output_frame_mask = (1 << config->output_channel_count) - 1;
+    config->output_frame_seen = 0;
     for (int i = 0; i < config->output_channel_count; ++i)
     {
+        if (config->output_channel[i].protocol != MODELCAR_ESC_PWM)
+        {
+            // fired on every update, nothing to wait for in the frame
+            modelcar_esc_init(&config->output_channel[i]);
+            config->output_channel[i].duty = DutyCyclePercentageToDuty(7.5f);
+            config->output_frame_mask &= ~(1 << i);
+            continue;
+        }
         ledc_channel_config_t ledc_channel = {
             .channel = config->output_channel[i].ledchannel,
             .duty = 0,
@@ -135,25 +191,98 @@ void modelcar_init(modelcar_config_t *config)
             .hpoint = 0,
             .timer_sel = LEDC_TIMER_1};
         ledc_channel_config(&ledc_channel);
+        config->output_channel[i].duty = DutyCyclePercentageToDuty(7.5f);
         ledc_set_duty(LEDC_LOW_SPEED_MODE, config->output_channel[i].ledchannel,
-                      DutyCyclePercentageToDuty(7.5f));
+                      config->output_channel[i].duty);
         ledc_update_duty(LEDC_LOW_SPEED_MODE,
                          config->output_channel[i].ledchannel);
     }
+    // start the periods at a known time, see sync.c
+    ledc_timer_rst(LEDC_LOW_SPEED_MODE, LEDC_TIMER_1);
+    modelcar_sync_init();
+}
+
+static void commit_outputs(modelcar_config_t *config)
+{
+    uint8_t committed = 0;
+    for (int i = 0; i < config->output_channel_count; ++i)
+    {
+        modelcar_output_channel_t *channel = &config->output_channel[i];
+        if (channel->pending)
+        {
+            ledc_update_duty(LEDC_LOW_SPEED_MODE, channel->ledchannel);
+            channel->pending = 0;
+            committed = 1;
+        }
+    }
+    if (committed)
+    {
+        MODELCAR_METRIC_INC(output_commits);
+    }
+    config->output_frame_seen = 0;
+}
+
+void modelcar_update_output_by_duty(modelcar_config_t *config, uint8_t idx,
+                                    uint32_t duty)
+{
+    modelcar_output_channel_t *channel = &config->output_channel[idx];
+    uint8_t bit = 1 << idx;
+
+    // a one-shot ESC wants a pulse per update, changed or not
+    if (channel->protocol != MODELCAR_ESC_PWM)
+    {
+        modelcar_esc_write(channel, duty);
+        channel->duty = duty;
+        MODELCAR_METRIC_INC(output_duty_writes[idx]);
+        return;
+    }
+
+    // seen twice, the rest of the frame got lost, do not hold this one back
+    if (config->output_frame_seen & bit)
+    {
+        commit_outputs(config);
+    }
+    config->output_frame_seen |= bit;
+
+    if (duty == channel->duty)
+    {
+        MODELCAR_METRIC_INC(output_duty_skipped[idx]);
+    }
+    else
+    {
+        ledc_set_duty(LEDC_LOW_SPEED_MODE, channel->ledchannel,
+                      modelcar_sync_duty(duty));
+        channel->duty = duty;
+        channel->pending = 1;
+        MODELCAR_METRIC_INC(output_duty_writes[idx]);
+    }
+
+    uint8_t mask = config->output_frame_mask;
+    if ((config->output_frame_seen & mask) == mask)
+    {
+        commit_outputs(config);
+    }
 }
 
-uint32_t modelcar_update_output_by_us(modelcar_output_channel_t *channel,
-                                      uint32_t us, float scale, int offset,
-                                      float limit)
+void modelcar_rescale_outputs(modelcar_config_t *config)
 {
-    uint32_t dc = DutyCyclePercentageToDuty(DutyCycleScale(
-        DutyCycleLimit(DutyCycleUsToPercentage(DutyCycleOffset(us, offset)),
-                       limit, offset),
-        scale));
-
-    ledc_set_duty(LEDC_LOW_SPEED_MODE, channel->ledchannel, dc);
-    ledc_update_duty(LEDC_LOW_SPEED_MODE, channel->ledchannel);
-    return dc;
+    for (int i = 0; i < config->output_channel_count; ++i)
+    {
+        modelcar_output_channel_t *channel = &config->output_channel[i];
+        // one-shot outputs have no period, the isr scales a pass-through one
+        // from its next pulse on
+        if (!(config->output_frame_mask & (1 << i)))
+        {
+            continue;
+        }
+        ledc_set_duty(LEDC_LOW_SPEED_MODE, channel->ledchannel,
+                      modelcar_sync_duty(channel->duty));
+        // a pending duty goes out with the rest of its frame
+        if (!channel->pending)
+        {
+            ledc_update_duty(LEDC_LOW_SPEED_MODE, channel->ledchannel);
+        }
+    }
 }
 
 void modelcar_update_drivemode(drive_mode_t *channel, uint32_t us, int offset)
@@ -161,7 +290,7 @@ void modelcar_update_drivemode(drive_mode_t *channel, uint32_t us, int offset)
     const float hist1 = 0.3;
     const float hist2 = 0.2;
     drive_mode_t cur = NEUTRAL;
-    float dc = DutyCycleUsToPercentage(DutyCycleOffset(us, offset));
+    float dc = DutyCycleUsToPercentage(us + offset);
     if (dc < 7.5f - hist1)
     {
         cur = FORWARD;
@@ -4,6 +4,20 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 
+/* anything outside is a glitch, not a receiver pulse */
+#define MODELCAR_PULSE_MIN_US 500
+#define MODELCAR_PULSE_MAX_US 2500
+
+struct modelcar_output_channel_s
+{
+    uint8_t portnum;
+    uint8_t ledchannel;
+    uint32_t duty;   // shadow of the duty register, at the nominal period
+    uint8_t pending; // duty set, waiting for the frame's commit
+    uint8_t protocol; // modelcar_esc_protocol_t, all but PWM skip the LEDC
+};
+typedef struct modelcar_output_channel_s modelcar_output_channel_t;
+
 struct modelcar_input_channel_s
 {
     uint32_t val_begin_of_sample;
@@ -11,16 +25,12 @@ struct modelcar_input_channel_s
     uint8_t portnum;
     uint8_t channel_idx;
     xQueueHandle *gpio_evt_queue;
+    // stateless channels only, the isr writes the duty of this output itself
+    const modelcar_output_channel_t *passthrough;
+    uint8_t passthrough_transfer; // modelcar_transfer_id_t
 };
 typedef struct modelcar_input_channel_s modelcar_input_channel_t;
 
-struct modelcar_output_channel_s
-{
-    uint8_t portnum;
-    uint8_t ledchannel;
-};
-typedef struct modelcar_output_channel_s modelcar_output_channel_t;
-
 enum drive_mode_e
 {
     NEUTRAL = 0,
@@ -41,13 +51,19 @@ struct modelcar_config_s
     drive_mode_t drive_mode[4];
     uint8_t output_channel_count;
     modelcar_output_channel_t output_channel[4];
+    // outputs updated by the control task, committed together once all of
+    // them were seen in a frame
+    uint8_t output_frame_mask;
+    uint8_t output_frame_seen;
 };
 typedef struct modelcar_config_s modelcar_config_t;
 
 struct modelcar_queue_value_s
 {
     uint32_t pulse_width;
+    uint32_t timestamp; // falling edge in us, wraps every ~71 minutes
     uint8_t channel_idx;
+    uint8_t written; // output already updated by the isr, see passthrough
 };
 typedef struct modelcar_queue_value_s modelcar_queue_value_t;
 
@@ -57,9 +73,16 @@ void modelcar_init_input_channel(modelcar_input_channel_t *channel,
                                  uint8_t portnum);
 void modelcar_init(modelcar_config_t *config);
 
-uint32_t modelcar_update_output_by_us(modelcar_output_channel_t *channel,
-                                      uint32_t us, float scale, int offset,
-                                      float limit);
+/* the linear transfer function the transfer tables are built from */
+uint32_t modelcar_duty_by_us(uint32_t us, float scale, int offset, float limit);
+/* Stage the duty of an output, unchanged duties are skipped. The staged
+ * outputs go to the LEDC together when the last output of the frame was
+ * updated, so they switch in the same PWM period. */
+void modelcar_update_output_by_duty(modelcar_config_t *config, uint8_t idx,
+                                    uint32_t duty);
+/* Control task, after modelcar_sync_output() changed the LEDC period. Writes
+ * the duties of the control task's outputs again for the new period. */
+void modelcar_rescale_outputs(modelcar_config_t *config);
 void modelcar_update_drivemode(drive_mode_t *channel, uint32_t us, int offset);
 
 uint32_t DutyCyclePercentageToDuty(float per);
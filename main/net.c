@@ -0,0 +1,261 @@
+#include "net.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+
+#include "portal.h"
+
+#define TAG "modelcar net"
+
+// longest sleep, bounds how late a socket is closed once its bit is cleared
+#define NET_POLL_MS 1000
+
+struct net_slot_s
+{
+    const modelcar_net_service_t *service;
+    int sock; // -1 while closed
+};
+
+struct net_periodic_s
+{
+    void (*fn)(void);
+    uint32_t period_us;
+    int64_t next_us;
+};
+
+// written before the task starts, read by the task only
+static struct net_slot_s slots[MODELCAR_NET_SERVICES_MAX];
+static size_t slot_count;
+static struct net_periodic_s periodics[MODELCAR_NET_PERIODICS_MAX];
+static size_t periodic_count;
+static bool (*watches[MODELCAR_NET_WATCHES_MAX])(EventBits_t bits);
+static size_t watch_count;
+
+static uint8_t net_query[MODELCAR_NET_PACKET_LEN];
+static uint8_t net_reply[MODELCAR_NET_PACKET_LEN];
+
+#if CONFIG_MODELCAR_STATIC_ALLOCATION
+static StackType_t net_task_stack[CONFIG_MODELCAR_NET_TASK_STACK_SIZE];
+static StaticTask_t net_task_buffer;
+#endif
+
+void modelcar_net_add_service(const modelcar_net_service_t *service)
+{
+    if (slot_count == MODELCAR_NET_SERVICES_MAX)
+    {
+        ESP_LOGE(TAG, "no slot left for %s", service->name);
+        return;
+    }
+    slots[slot_count].service = service;
+    slots[slot_count].sock = -1;
+    ++slot_count;
+}
+
+void modelcar_net_add_periodic(void (*fn)(void), uint32_t period_ms)
+{
+    if (periodic_count == MODELCAR_NET_PERIODICS_MAX)
+    {
+        ESP_LOGE(TAG, "no periodic slot left");
+        return;
+    }
+    periodics[periodic_count].fn = fn;
+    periodics[periodic_count].period_us = period_ms * 1000;
+    periodics[periodic_count].next_us =
+        esp_timer_get_time() + period_ms * 1000;
+    ++periodic_count;
+}
+
+void modelcar_net_add_watch(bool (*fn)(EventBits_t bits))
+{
+    if (watch_count == MODELCAR_NET_WATCHES_MAX)
+    {
+        ESP_LOGE(TAG, "no watch slot left");
+        return;
+    }
+    watches[watch_count++] = fn;
+}
+
+static int net_open(const modelcar_net_service_t *service)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = service->addr;
+    addr.sin_port = htons(service->port);
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0)
+    {
+        ESP_LOGI(TAG, "%s failed to create sock!", service->name);
+        return -1;
+    }
+    int broadcast = 1;
+    setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &broadcast, sizeof(broadcast));
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        // retried on the next round, at most NET_POLL_MS later
+        ESP_LOGI(TAG, "%s failed to bind sock!", service->name);
+        close(sock);
+        return -1;
+    }
+    ESP_LOGI(TAG, "%s started on port %u", service->name, service->port);
+    return sock;
+}
+
+/* Open and close the sockets as their bits say and run the watches, returns
+ * the highest socket. retry is set when an active service could not be
+ * opened or a watch waits. */
+static int net_update_sockets(fd_set *readable, bool *retry)
+{
+    EventBits_t bits = xEventGroupGetBits(modelcar_portal_events());
+    int max_sock = -1;
+
+    *retry = false;
+    for (size_t i = 0; i < watch_count; ++i)
+    {
+        *retry |= watches[i](bits);
+    }
+    FD_ZERO(readable);
+    for (size_t i = 0; i < slot_count; ++i)
+    {
+        struct net_slot_s *slot = &slots[i];
+        EventBits_t active_bit = slot->service->active_bit;
+        bool active = active_bit == 0 || (bits & active_bit) != 0;
+        if (active && slot->sock < 0)
+        {
+            slot->sock = net_open(slot->service);
+            *retry |= slot->sock < 0;
+        }
+        else if (!active && slot->sock >= 0)
+        {
+            close(slot->sock);
+            slot->sock = -1;
+            ESP_LOGI(TAG, "%s stopped", slot->service->name);
+        }
+        if (slot->sock >= 0)
+        {
+            FD_SET(slot->sock, readable);
+            max_sock = slot->sock > max_sock ? slot->sock : max_sock;
+        }
+    }
+    return max_sock;
+}
+
+/* Run the due jobs, returns the time to the next one */
+static int64_t net_run_periodics(void)
+{
+    int64_t wait_us = NET_POLL_MS * 1000;
+    for (size_t i = 0; i < periodic_count; ++i)
+    {
+        struct net_periodic_s *periodic = &periodics[i];
+        int64_t now = esp_timer_get_time();
+        if (periodic->next_us <= now)
+        {
+            periodic->fn();
+            periodic->next_us += periodic->period_us;
+            // skip the periods missed, no catching up in a burst
+            if (periodic->next_us <= now)
+            {
+                periodic->next_us = now + periodic->period_us;
+            }
+        }
+        if (periodic->next_us - now < wait_us)
+        {
+            wait_us = periodic->next_us - now;
+        }
+    }
+    return wait_us;
+}
+
+static void net_serve(struct net_slot_s *slot)
+{
+    struct sockaddr_in from;
+    socklen_t fromlen = sizeof(from);
+    memset(&from, 0, sizeof(from));
+    int len = recvfrom(slot->sock, net_query, sizeof(net_query), 0,
+                       (struct sockaddr *)&from, &fromlen);
+    if (len <= 0)
+    {
+        return;
+    }
+    size_t reply_len = slot->service->handler(&from, net_query, len, net_reply);
+    if (reply_len > 0)
+    {
+        if (from.sin_addr.s_addr == htonl(INADDR_ANY))
+        {
+            from.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+        }
+        sendto(slot->sock, net_reply, reply_len, 0, (struct sockaddr *)&from,
+               sizeof(from));
+    }
+}
+
+static void net_task(void *arg)
+{
+    EventBits_t wake_bits = 0;
+    for (size_t i = 0; i < slot_count; ++i)
+    {
+        wake_bits |= slots[i].service->active_bit;
+    }
+    if (watch_count > 0)
+    {
+        wake_bits |= MODELCAR_PORTAL_ACTIVE_BIT;
+    }
+
+    while (1)
+    {
+        fd_set readable;
+        bool retry;
+        int max_sock = net_update_sockets(&readable, &retry);
+        if (max_sock < 0 && periodic_count == 0 && retry)
+        {
+            // no bit change would wake the task for the retry, poll instead
+            vTaskDelay(NET_POLL_MS / portTICK_PERIOD_MS);
+            continue;
+        }
+        if (max_sock < 0 && periodic_count == 0)
+        {
+            // nothing to serve, sleep until a service is switched on
+            xEventGroupWaitBits(modelcar_portal_events(), wake_bits, pdFALSE,
+                                pdFALSE, portMAX_DELAY);
+            continue;
+        }
+
+        int64_t wait_us = net_run_periodics();
+        struct timeval timeout = {.tv_sec = wait_us / 1000000,
+                                  .tv_usec = wait_us % 1000000};
+        if (select(max_sock + 1, &readable, NULL, NULL, &timeout) <= 0)
+        {
+            continue;
+        }
+        for (size_t i = 0; i < slot_count; ++i)
+        {
+            if (slots[i].sock >= 0 && FD_ISSET(slots[i].sock, &readable))
+            {
+                net_serve(&slots[i]);
+            }
+        }
+    }
+}
+
+void modelcar_net_start(void)
+{
+    if (slot_count == 0 && periodic_count == 0 && watch_count == 0)
+    {
+        return;
+    }
+    // below the HTTP server and the control loop, see Kconfig
+#if CONFIG_MODELCAR_STATIC_ALLOCATION
+    xTaskCreateStatic(net_task, "net", CONFIG_MODELCAR_NET_TASK_STACK_SIZE,
+                      NULL, 3, net_task_stack, &net_task_buffer);
+#else
+    xTaskCreate(net_task, "net", CONFIG_MODELCAR_NET_TASK_STACK_SIZE, NULL, 3,
+                NULL);
+#endif
+}
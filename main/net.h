@@ -0,0 +1,53 @@
+#ifndef _NET_H_
+#define _NET_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "lwip/sockets.h"
+
+/* One task serves all UDP sockets and periodic jobs with select(), in place
+ * of a task per service. It handles one datagram at a time, so the receive
+ * and reply buffers are shared by all services. */
+#define MODELCAR_NET_PACKET_LEN 512
+#define MODELCAR_NET_SERVICES_MAX 4
+#define MODELCAR_NET_PERIODICS_MAX 2
+#define MODELCAR_NET_WATCHES_MAX 2
+
+/* Answer the datagram in query, the reply buffer holds
+ * MODELCAR_NET_PACKET_LEN bytes. Returns the reply length, 0 for none. */
+typedef size_t (*modelcar_net_handler_t)(const struct sockaddr_in *from,
+                                         const uint8_t *query, size_t len,
+                                         uint8_t *reply);
+
+struct modelcar_net_service_s
+{
+    const char *name;
+    uint16_t port;
+    /* address to bind in network order, 0 for any. Replies to senders without
+     * an address, e.g. DHCP clients, are broadcast. */
+    uint32_t addr;
+    /* one bit of modelcar_portal_events(), the socket is only open while it
+     * is set. 0 keeps it open all the time. */
+    EventBits_t active_bit;
+    modelcar_net_handler_t handler;
+};
+typedef struct modelcar_net_service_s modelcar_net_service_t;
+
+/* Register before modelcar_net_start(). service must stay valid. */
+void modelcar_net_add_service(const modelcar_net_service_t *service);
+/* Call fn from the network task every period_ms. It shares the task with
+ * the services, so it must not block. */
+void modelcar_net_add_periodic(void (*fn)(void), uint32_t period_ms);
+/* Call fn from the network task whenever it wakes up, at the latest when a
+ * station joins, with the bits of modelcar_portal_events(), e.g. to start
+ * and stop a server as they change.
+ * fn returns true while it waits for something the bits do not signal, the
+ * task then calls it again within a second. */
+void modelcar_net_add_watch(bool (*fn)(EventBits_t bits));
+void modelcar_net_start(void);
+
+#endif
@@ -0,0 +1,174 @@
+#include "ota.h"
+
+#include <string.h>
+
+#include "esp_image_format.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#include "metrics.h"
+
+#define TAG "modelcar ota"
+
+// esp_app_desc_t follows the image header and the first segment header
+#define OTA_APP_DESC_OFFSET                                                    \
+    (sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t))
+
+static modelcar_ota_stats_t stats;
+static esp_ota_handle_t handle;
+static const esp_partition_t *partition;
+static int64_t started_us;
+static uint32_t latency_start[MODELCAR_OTA_LATENCY_CHANNELS];
+static uint32_t writes_start[MODELCAR_OTA_LATENCY_CHANNELS];
+static uint32_t dropped_start;
+static bool pending_verify;
+// web upload and mqtt update may race for it
+static portMUX_TYPE busy_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool busy;
+
+void modelcar_ota_init(void)
+{
+    esp_ota_img_states_t state;
+    if (esp_ota_get_state_partition(esp_ota_get_running_partition(),
+                                    &state) == ESP_OK &&
+        state == ESP_OTA_IMG_PENDING_VERIFY)
+    {
+        ESP_LOGI(TAG, "new image, confirm after %d s",
+                 CONFIG_MODELCAR_OTA_CONFIRM_S);
+        pending_verify = true;
+    }
+}
+
+void modelcar_ota_check_health(void)
+{
+    if (!pending_verify ||
+        esp_timer_get_time() < CONFIG_MODELCAR_OTA_CONFIRM_S * 1000000LL)
+    {
+        return;
+    }
+    pending_verify = false;
+    ESP_LOGI(TAG, "image confirmed");
+    esp_ota_mark_app_valid_cancel_rollback();
+}
+
+static esp_err_t ota_release(esp_err_t err)
+{
+    portENTER_CRITICAL(&busy_lock);
+    busy = false;
+    portEXIT_CRITICAL(&busy_lock);
+    return err;
+}
+
+esp_err_t modelcar_ota_begin(size_t size)
+{
+    portENTER_CRITICAL(&busy_lock);
+    bool was_busy = busy;
+    busy = true;
+    portEXIT_CRITICAL(&busy_lock);
+    if (was_busy)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    partition = esp_ota_get_next_update_partition(NULL);
+    if (partition == NULL)
+    {
+        return ota_release(ESP_ERR_NOT_FOUND);
+    }
+    if (size > partition->size)
+    {
+        return ota_release(ESP_ERR_INVALID_SIZE);
+    }
+    ESP_LOGI(TAG, "writing %u bytes to %s", (unsigned)size, partition->label);
+
+    memset(&stats, 0, sizeof(stats));
+    for (int i = 0; i < MODELCAR_OTA_LATENCY_CHANNELS; ++i)
+    {
+        latency_start[i] = modelcar_metrics.output_write_latency_us[i];
+        writes_start[i] = modelcar_metrics.output_writes[i];
+    }
+    dropped_start = 0;
+    for (int i = 0; i < MODELCAR_METRICS_CHANNELS; ++i)
+    {
+        dropped_start += modelcar_metrics.pulses_dropped[i];
+    }
+    started_us = esp_timer_get_time();
+
+    // erase sector by sector while writing instead of all at once, that
+    // would stall the control task for the whole partition
+    esp_err_t err =
+        esp_ota_begin(partition, OTA_WITH_SEQUENTIAL_WRITES, &handle);
+    return err == ESP_OK ? err : ota_release(err);
+}
+
+esp_err_t modelcar_ota_write(const void *buf, size_t len)
+{
+    // refuse images of other projects before anything is written
+    if (stats.bytes == 0)
+    {
+        const esp_app_desc_t *desc =
+            (const esp_app_desc_t *)((const uint8_t *)buf +
+                                     OTA_APP_DESC_OFFSET);
+        if (len < OTA_APP_DESC_OFFSET + sizeof(esp_app_desc_t) ||
+            strncmp(desc->project_name,
+                    esp_ota_get_app_description()->project_name,
+                    sizeof(desc->project_name)) != 0)
+        {
+            return ESP_ERR_OTA_VALIDATE_FAILED;
+        }
+        ESP_LOGI(TAG, "new version %s", desc->version);
+    }
+
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = esp_ota_write(handle, buf, len);
+    uint32_t took = esp_timer_get_time() - start;
+    if (took > stats.write_us_max)
+    {
+        stats.write_us_max = took;
+    }
+    stats.bytes += len;
+    return err;
+}
+
+esp_err_t modelcar_ota_end(void)
+{
+    stats.duration_ms = (esp_timer_get_time() - started_us) / 1000;
+    for (int i = 0; i < MODELCAR_OTA_LATENCY_CHANNELS; ++i)
+    {
+        uint32_t writes = modelcar_metrics.output_writes[i] - writes_start[i];
+        stats.latency_us_avg[i] =
+            writes ? (modelcar_metrics.output_write_latency_us[i] -
+                      latency_start[i]) /
+                         writes
+                   : 0;
+    }
+    uint32_t dropped = 0;
+    for (int i = 0; i < MODELCAR_METRICS_CHANNELS; ++i)
+    {
+        dropped += modelcar_metrics.pulses_dropped[i];
+    }
+    stats.pulses_dropped = dropped - dropped_start;
+
+    // checks the image, including its hash
+    esp_err_t err = esp_ota_end(handle);
+    if (err != ESP_OK)
+    {
+        return ota_release(err);
+    }
+    ESP_LOGI(TAG, "%u bytes in %u ms, longest write %u us", stats.bytes,
+             stats.duration_ms, stats.write_us_max);
+    return ota_release(esp_ota_set_boot_partition(partition));
+}
+
+void modelcar_ota_abort(void)
+{
+    ESP_LOGW(TAG, "upload aborted after %u bytes", stats.bytes);
+    esp_ota_abort(handle);
+    ota_release(ESP_OK);
+}
+
+bool modelcar_ota_running(void) { return busy; }
+
+const modelcar_ota_stats_t *modelcar_ota_get_stats(void) { return &stats; }
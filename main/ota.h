@@ -0,0 +1,46 @@
+#ifndef _OTA_H_
+#define _OTA_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#define MODELCAR_OTA_LATENCY_CHANNELS 2
+
+/* the last upload, while it runs only the httpd task touches it */
+struct modelcar_ota_stats_s
+{
+    uint32_t bytes;
+    uint32_t duration_ms;
+    // longest single flash write, the control task cannot run meanwhile
+    uint32_t write_us_max;
+    // mean falling edge to duty write per output channel during the upload
+    uint32_t latency_us_avg[MODELCAR_OTA_LATENCY_CHANNELS];
+    uint32_t pulses_dropped;
+};
+typedef struct modelcar_ota_stats_s modelcar_ota_stats_t;
+
+/* check whether the running image still has to prove itself */
+void modelcar_ota_init(void);
+/* Call regularly from the control loop. Once a freshly updated image ran for
+ * CONFIG_MODELCAR_OTA_CONFIRM_S it is marked valid, if it crashes or hangs
+ * before that the bootloader rolls back to the previous one. */
+void modelcar_ota_check_health(void);
+
+/* One upload at a time, begin fails with ESP_ERR_INVALID_STATE while another
+ * one runs. The rest of an upload has to come from the task that began it.
+ * The image is written to the inactive OTA partition and only booted after
+ * modelcar_ota_end(). */
+esp_err_t modelcar_ota_begin(size_t size);
+esp_err_t modelcar_ota_write(const void *buf, size_t len);
+/* validate the image and make it the boot partition */
+esp_err_t modelcar_ota_end(void);
+void modelcar_ota_abort(void);
+/* true from a successful begin until the end or the abort */
+bool modelcar_ota_running(void);
+
+const modelcar_ota_stats_t *modelcar_ota_get_stats(void);
+
+#endif
@@ -0,0 +1,152 @@
+#include "params.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "params_hash.h"
+
+#define MODELCAR_PARAM(name, type, min, max, step, def, channel, label, unit) \
+    {#name,                                                                    \
+     MODELCAR_PARAM_##type,                                                    \
+     offsetof(modelcar_params_t, name),                                        \
+     offsetof(modelcar_params_t, name) +                                       \
+         sizeof(((modelcar_params_t *)0)->name),                               \
+     min,                                                                      \
+     max,                                                                      \
+     step,                                                                     \
+     def,                                                                      \
+     channel,                                                                  \
+     label,                                                                    \
+     unit},
+const modelcar_param_t modelcar_params[] = {
+#include "params.def"
+};
+#undef MODELCAR_PARAM
+
+const size_t modelcar_params_count =
+    sizeof(modelcar_params) / sizeof(modelcar_params[0]);
+
+/* FNV-1a with the generated seed, the same as modelcar_route_hash in httpd.c,
+ * see tools/gen_params.py */
+static uint32_t modelcar_param_hash(const char *name, size_t len)
+{
+    uint32_t h = MODELCAR_PARAM_SEED;
+    for (size_t i = 0; i < len; ++i)
+    {
+        h = (h ^ (uint8_t)name[i]) * 16777619u;
+    }
+    return h ^ (h >> 16);
+}
+
+const modelcar_param_t *modelcar_param_lookup(const char *name, size_t len)
+{
+    int idx = modelcar_param_slots[modelcar_param_hash(name, len) &
+                                   (MODELCAR_PARAM_SLOTS - 1)];
+    if (idx < 0)
+    {
+        return NULL;
+    }
+    const modelcar_param_t *param = &modelcar_params[idx];
+    if (strncmp(param->name, name, len) != 0 || param->name[len] != 0)
+    {
+        return NULL;
+    }
+    return param;
+}
+
+static void *modelcar_param_field(const modelcar_param_t *param,
+                                  const modelcar_params_t *params)
+{
+    return (uint8_t *)params + param->offset;
+}
+
+void modelcar_params_default(modelcar_params_t *params)
+{
+    memset(params, 0, sizeof(*params));
+    for (size_t i = 0; i < modelcar_params_count; ++i)
+    {
+        const modelcar_param_t *param = &modelcar_params[i];
+        void *field = modelcar_param_field(param, params);
+        if (param->type == MODELCAR_PARAM_FLOAT)
+        {
+            *(float *)field = param->def;
+        }
+        else if (param->type == MODELCAR_PARAM_INT)
+        {
+            *(int *)field = param->def;
+        }
+    }
+}
+
+static float modelcar_param_clamp(const modelcar_param_t *param, float value)
+{
+    return value < param->min ? param->min
+                              : (value > param->max ? param->max : value);
+}
+
+int modelcar_param_parse(const modelcar_param_t *param,
+                         modelcar_params_t *params, const char *str)
+{
+    void *field = modelcar_param_field(param, params);
+    char *end;
+    switch (param->type)
+    {
+    case MODELCAR_PARAM_FLOAT:
+    {
+        float value = strtof(str, &end);
+        // "nan" and "inf" parse, NaN would pass the clamp
+        if (end == str || !isfinite(value))
+        {
+            return -1;
+        }
+        *(float *)field = modelcar_param_clamp(param, value);
+        return 0;
+    }
+    case MODELCAR_PARAM_INT:
+    {
+        long value = strtol(str, &end, 10);
+        if (end == str)
+        {
+            return -1;
+        }
+        *(int *)field = modelcar_param_clamp(param, value);
+        return 0;
+    }
+    case MODELCAR_PARAM_CURVE:
+        return modelcar_curve_parse((modelcar_curve_t *)field, str);
+    }
+    return -1;
+}
+
+void modelcar_param_format(const modelcar_param_t *param,
+                           const modelcar_params_t *params, char *buf,
+                           size_t size)
+{
+    const void *field = modelcar_param_field(param, params);
+    switch (param->type)
+    {
+    case MODELCAR_PARAM_FLOAT:
+        snprintf(buf, size, "%.2f", *(const float *)field);
+        break;
+    case MODELCAR_PARAM_INT:
+        snprintf(buf, size, "%d", *(const int *)field);
+        break;
+    case MODELCAR_PARAM_CURVE:
+        modelcar_curve_format((const modelcar_curve_t *)field, buf, size);
+        break;
+    }
+}
+
+bool modelcar_params_size_valid(size_t size)
+{
+    for (size_t i = 0; i < modelcar_params_count; ++i)
+    {
+        if (modelcar_params[i].end == size)
+        {
+            return true;
+        }
+    }
+    return size == sizeof(modelcar_params_t);
+}
@@ -0,0 +1,69 @@
+#ifndef _PARAMS_H_
+#define _PARAMS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "transfer.h"
+
+#define MODELCAR_PARAM_CTYPE_FLOAT float
+#define MODELCAR_PARAM_CTYPE_INT int
+#define MODELCAR_PARAM_CTYPE_CURVE modelcar_curve_t
+
+/* the tunables of one profile, one field per line of params.def */
+struct modelcar_params_s
+{
+#define MODELCAR_PARAM(name, type, min, max, step, def, channel, label, unit) \
+    MODELCAR_PARAM_CTYPE_##type name;
+#include "params.def"
+#undef MODELCAR_PARAM
+};
+typedef struct modelcar_params_s modelcar_params_t;
+
+enum modelcar_param_type_e
+{
+    MODELCAR_PARAM_FLOAT,
+    MODELCAR_PARAM_INT,
+    MODELCAR_PARAM_CURVE,
+};
+typedef enum modelcar_param_type_e modelcar_param_type_t;
+
+struct modelcar_param_s
+{
+    const char *name;
+    modelcar_param_type_t type;
+    uint16_t offset; // in modelcar_params_t
+    uint16_t end;    // offset of the field after it
+    float min;
+    float max;
+    float step;
+    float def;
+    uint8_t channel; // 1 steering, 2 throttle
+    const char *label;
+    const char *unit;
+};
+typedef struct modelcar_param_s modelcar_param_t;
+
+/* in params.def order */
+extern const modelcar_param_t modelcar_params[];
+extern const size_t modelcar_params_count;
+
+/* The parameter of that name, or NULL. One hash and one compare, the name
+ * needs no terminator. */
+const modelcar_param_t *modelcar_param_lookup(const char *name, size_t len);
+
+void modelcar_params_default(modelcar_params_t *params);
+/* Set from the text /save takes, clamped to the range. -1 when it does not
+ * parse or is not finite, the value is unchanged then. */
+int modelcar_param_parse(const modelcar_param_t *param,
+                         modelcar_params_t *params, const char *str);
+/* the text /read answers with, curves take up to MODELCAR_CURVE_PARAM_MAX */
+void modelcar_param_format(const modelcar_param_t *param,
+                           const modelcar_params_t *params, char *buf,
+                           size_t size);
+/* True when size is the size of modelcar_params_t up to some parameter,
+ * i.e. a profile stored before the parameters behind it were appended. */
+bool modelcar_params_size_valid(size_t size);
+
+#endif
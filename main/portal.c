@@ -0,0 +1,98 @@
+#include "portal.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "httpd.h"
+#include "net.h"
+#include "ota.h"
+#include "receiver.h"
+
+#define TAG "modelcar portal"
+
+// a phone that roams off and back keeps its server, no start/stop churn
+#define PORTAL_SERVER_LINGER_US (30 * 1000000LL)
+
+static EventGroupHandle_t portal_events;
+#if CONFIG_MODELCAR_STATIC_ALLOCATION
+static StaticEventGroup_t portal_events_buffer;
+#endif
+
+// only changed from the event loop task
+static uint32_t stations;
+// net task only
+static httpd_handle_t server;
+static int64_t idle_since_us;
+
+/* Runs in the net task. httpd_stop() waits for the running handler, the
+ * event loop must not, and an upload must not be cut off. */
+static bool portal_watch(EventBits_t bits)
+{
+    int64_t now = esp_timer_get_time();
+    if (bits & MODELCAR_PORTAL_ACTIVE_BIT)
+    {
+        idle_since_us = 0;
+        if (server == NULL)
+        {
+            server = modelcar_httpd_start_webserver();
+        }
+        return server == NULL;
+    }
+    if (server == NULL)
+    {
+        return false;
+    }
+    if (idle_since_us == 0)
+    {
+        idle_since_us = now;
+    }
+    if (now - idle_since_us < PORTAL_SERVER_LINGER_US || modelcar_ota_running())
+    {
+        return true;
+    }
+    ESP_LOGI(TAG, "portal idle, stopping the web server");
+    httpd_stop(server);
+    server = NULL;
+    return false;
+}
+
+void modelcar_portal_init(void)
+{
+#if CONFIG_MODELCAR_STATIC_ALLOCATION
+    portal_events = xEventGroupCreateStatic(&portal_events_buffer);
+#else
+    portal_events = xEventGroupCreate();
+#endif
+    xEventGroupSetBits(portal_events, MODELCAR_PORTAL_IDLE_BIT);
+    modelcar_net_add_watch(portal_watch);
+}
+
+EventGroupHandle_t modelcar_portal_events(void) { return portal_events; }
+
+void modelcar_portal_station_joined(void)
+{
+    if (stations++ > 0)
+    {
+        return;
+    }
+
+    ESP_LOGI(TAG, "first station joined, starting portal services");
+    // signal statistics per config session
+    modelcar_receiver_reset();
+    xEventGroupClearBits(portal_events, MODELCAR_PORTAL_IDLE_BIT);
+    xEventGroupSetBits(portal_events, MODELCAR_PORTAL_ACTIVE_BIT);
+}
+
+void modelcar_portal_station_left(void)
+{
+    if (stations == 0 || --stations > 0)
+    {
+        return;
+    }
+
+    ESP_LOGI(TAG, "last station left, stopping portal services");
+    xEventGroupClearBits(portal_events, MODELCAR_PORTAL_ACTIVE_BIT);
+    xEventGroupSetBits(portal_events, MODELCAR_PORTAL_IDLE_BIT);
+}
+
+uint32_t modelcar_portal_get_stations(void) { return stations; }
@@ -0,0 +1,23 @@
+#ifndef _PORTAL_H_
+#define _PORTAL_H_
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+#define MODELCAR_PORTAL_URL "http://" CONFIG_ESP_WIFI_IP "/"
+/* RFC 8908 captive portal API, announced by DHCP option 114 (RFC 8910) */
+#define MODELCAR_PORTAL_API_URL MODELCAR_PORTAL_URL "api/captive"
+
+/* set while at least one station is associated with the AP */
+#define MODELCAR_PORTAL_ACTIVE_BIT BIT0
+/* the complement, event groups can only wait for bits to become set */
+#define MODELCAR_PORTAL_IDLE_BIT BIT1
+
+void modelcar_portal_init(void);
+EventGroupHandle_t modelcar_portal_events(void);
+/* called from the wifi event handler */
+void modelcar_portal_station_joined(void);
+void modelcar_portal_station_left(void);
+uint32_t modelcar_portal_get_stations(void);
+
+#endif
@@ -0,0 +1,80 @@
+#include "profile.h"
+
+#include "esp_attr.h"
+
+struct profile_slot_s
+{
+    modelcar_profile_t buf[2];
+    volatile uint8_t front;
+};
+
+static struct profile_slot_s slots[MODELCAR_PROFILE_COUNT];
+static volatile uint8_t active;
+
+void modelcar_profile_update(uint8_t idx,
+                             const modelcar_transfer_params_t *steering,
+                             const modelcar_transfer_params_t *throttle,
+                             const modelcar_slew_profile_t *slew)
+{
+    struct profile_slot_s *slot = &slots[idx];
+    modelcar_profile_t *p = &slot->buf[!slot->front];
+
+    modelcar_transfer_build(&p->transfer[MODELCAR_TRANSFER_STEERING],
+                            steering);
+    modelcar_transfer_build(&p->transfer[MODELCAR_TRANSFER_THROTTLE],
+                            throttle);
+    // braking and reverse run the throttle unscaled
+    modelcar_transfer_params_t brake = *throttle;
+    brake.factor = 1.0f;
+    modelcar_transfer_build(&p->transfer[MODELCAR_TRANSFER_THROTTLE_BRAKE],
+                            &brake);
+
+    // the calibrated center plays the role 1500 us had before
+    p->throttle_offset =
+        throttle->offset + 1500 - throttle->calibration.center;
+    for (int i = 0; i < MODELCAR_TRANSFER_COUNT; ++i)
+    {
+        p->throttle_neutral[i] = modelcar_transfer_lookup(
+            &p->transfer[i], 1500 - p->throttle_offset);
+    }
+    p->steering_neutral =
+        modelcar_transfer_lookup(&p->transfer[MODELCAR_TRANSFER_STEERING],
+                                 steering->calibration.center);
+    p->slew = *slew;
+
+    slot->front = !slot->front;
+}
+
+void modelcar_profile_restore(uint8_t idx, const modelcar_profile_t *profile)
+{
+    struct profile_slot_s *slot = &slots[idx];
+    slot->buf[slot->front] = *profile;
+    active = idx;
+}
+
+IRAM_ATTR const modelcar_profile_t *modelcar_profile_current(void)
+{
+    struct profile_slot_s *slot = &slots[active];
+    return &slot->buf[slot->front];
+}
+
+void modelcar_profile_select(uint8_t idx)
+{
+    if (idx >= MODELCAR_PROFILE_COUNT)
+    {
+        return;
+    }
+    active = idx;
+}
+
+uint8_t modelcar_profile_active(void) { return active; }
+
+uint8_t modelcar_profile_by_us(uint32_t us)
+{
+    if (us <= 1000)
+    {
+        return 0;
+    }
+    uint32_t idx = (us - 1000) * MODELCAR_PROFILE_COUNT / 1000;
+    return idx < MODELCAR_PROFILE_COUNT ? idx : MODELCAR_PROFILE_COUNT - 1;
+}
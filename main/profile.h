@@ -0,0 +1,46 @@
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include <stdint.h>
+
+#include "sdkconfig.h"
+#include "slew.h"
+#include "transfer.h"
+
+#define MODELCAR_PROFILE_COUNT CONFIG_MODELCAR_PROFILE_COUNT
+#define MODELCAR_PROFILE_NAME_MAX 16
+
+/* Everything the control loop needs from one profile, compiled from its
+ * params in advance so that switching is a single index store. */
+struct modelcar_profile_s
+{
+    modelcar_transfer_t transfer[MODELCAR_TRANSFER_COUNT];
+    uint32_t throttle_neutral[MODELCAR_TRANSFER_COUNT]; // duty at neutral
+    uint32_t steering_neutral; // duty at the calibrated steering center
+    modelcar_slew_profile_t slew;
+    int throttle_offset; // shifts the throttle input to neutral at 1500 us
+};
+typedef struct modelcar_profile_s modelcar_profile_t;
+
+/* Compile into the background buffer of a profile and switch to it. Only one
+ * task may update, any task may read. */
+void modelcar_profile_update(uint8_t idx,
+                             const modelcar_transfer_params_t *steering,
+                             const modelcar_transfer_params_t *throttle,
+                             const modelcar_slew_profile_t *slew);
+
+/* Put a profile compiled by an earlier boot in place and select it, see
+ * resume.h. Only before the control task runs. */
+void modelcar_profile_restore(uint8_t idx, const modelcar_profile_t *profile);
+
+/* Fetch once per pulse and use for the whole pulse, a concurrent switch then
+ * takes effect with the next one. Safe to call from an isr. */
+const modelcar_profile_t *modelcar_profile_current(void);
+void modelcar_profile_select(uint8_t idx);
+uint8_t modelcar_profile_active(void);
+
+/* Profile for the position of a multi position switch, the 1000..2000 us
+ * throw is split evenly between the profiles. */
+uint8_t modelcar_profile_by_us(uint32_t us);
+
+#endif
@@ -0,0 +1,115 @@
+#include "ratelimit.h"
+
+#include <string.h>
+
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+
+static void bucket_reset(modelcar_ratelimit_bucket_t *bucket, uint32_t addr,
+                         uint32_t burst, int64_t now)
+{
+    bucket->addr = addr;
+    bucket->millitokens = burst * 1000;
+    bucket->last_us = now;
+}
+
+// refill by elapsed time, true when a token is available
+static bool bucket_refill(modelcar_ratelimit_bucket_t *bucket, uint32_t rate,
+                          uint32_t burst, int64_t now)
+{
+    uint64_t elapsed = now - bucket->last_us;
+    uint64_t millitokens = bucket->millitokens + elapsed * rate / 1000;
+    if (millitokens > burst * 1000)
+    {
+        millitokens = burst * 1000;
+    }
+    bucket->millitokens = millitokens;
+    bucket->last_us = now;
+    return millitokens >= 1000;
+}
+
+void modelcar_ratelimit_init(modelcar_ratelimit_t *rl, uint32_t rate,
+                             uint32_t burst, uint32_t total_rate,
+                             uint32_t total_burst)
+{
+    memset(rl, 0, sizeof(*rl));
+    rl->rate = rate;
+    rl->burst = burst;
+    rl->total_rate = total_rate;
+    rl->total_burst = total_burst;
+    bucket_reset(&rl->total, 0, total_burst, esp_timer_get_time());
+}
+
+bool modelcar_ratelimit_allow(modelcar_ratelimit_t *rl, uint32_t addr)
+{
+    int64_t now = esp_timer_get_time();
+
+    // 0 is a peer getpeername could not name, it only counts against the
+    // total, it must not share the bucket of the free slots
+    modelcar_ratelimit_bucket_t *bucket = NULL;
+    if (addr != 0)
+    {
+        // the table is only a few entries long, a scan is cheaper than hashing
+        bucket = &rl->client[0];
+        for (int i = 0; i < MODELCAR_RATELIMIT_CLIENTS; ++i)
+        {
+            if (rl->client[i].addr == addr)
+            {
+                bucket = &rl->client[i];
+                break;
+            }
+            if (rl->client[i].last_us < bucket->last_us)
+            {
+                bucket = &rl->client[i];
+            }
+        }
+        if (bucket->addr != addr)
+        {
+            // unknown client, recycle the least recently seen slot
+            bucket_reset(bucket, addr, rl->burst, now);
+        }
+    }
+
+    // both buckets are checked before either pays, a dropped request costs
+    // nothing
+    bool allow = bucket_refill(&rl->total, rl->total_rate, rl->total_burst,
+                               now);
+    if (bucket != NULL)
+    {
+        allow = bucket_refill(bucket, rl->rate, rl->burst, now) && allow;
+    }
+    if (!allow)
+    {
+        rl->dropped++;
+        return false;
+    }
+    rl->total.millitokens -= 1000;
+    if (bucket != NULL)
+    {
+        bucket->millitokens -= 1000;
+    }
+    rl->passed++;
+    return true;
+}
+
+uint32_t modelcar_ratelimit_sock_addr(int sockfd)
+{
+    struct sockaddr_in6 addr;
+    socklen_t addr_len = sizeof(addr);
+    if (getpeername(sockfd, (struct sockaddr *)&addr, &addr_len) != 0)
+    {
+        return 0;
+    }
+
+    uint32_t ip4 = 0;
+    if (addr.sin6_family == AF_INET6)
+    {
+        // httpd listens on an IPv6 socket, IPv4 peers are mapped addresses
+        memcpy(&ip4, &addr.sin6_addr.s6_addr[12], sizeof(ip4));
+    }
+    else if (addr.sin6_family == AF_INET)
+    {
+        ip4 = ((struct sockaddr_in *)&addr)->sin_addr.s_addr;
+    }
+    return ip4;
+}
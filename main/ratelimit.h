@@ -0,0 +1,45 @@
+#ifndef _RATELIMIT_H_
+#define _RATELIMIT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+/* every associated station plus a few spare slots for stale addresses */
+#define MODELCAR_RATELIMIT_CLIENTS (CONFIG_ESP_MAX_STA_CONN + 3)
+
+struct modelcar_ratelimit_bucket_s
+{
+    uint32_t addr;
+    uint32_t millitokens;
+    int64_t last_us;
+};
+typedef struct modelcar_ratelimit_bucket_s modelcar_ratelimit_bucket_t;
+
+/* Token buckets keyed by IPv4 source address plus one bucket shared by all
+ * clients, so the total work stays bounded however many phones are joined.
+ * Each instance must only be used from a single task. */
+struct modelcar_ratelimit_s
+{
+    uint32_t rate;         // tokens per second and client
+    uint32_t burst;        // bucket depth per client
+    uint32_t total_rate;   // tokens per second for all clients
+    uint32_t total_burst;  // depth of the shared bucket
+    modelcar_ratelimit_bucket_t total;
+    modelcar_ratelimit_bucket_t client[MODELCAR_RATELIMIT_CLIENTS];
+    uint32_t passed;
+    uint32_t dropped;
+};
+typedef struct modelcar_ratelimit_s modelcar_ratelimit_t;
+
+void modelcar_ratelimit_init(modelcar_ratelimit_t *rl, uint32_t rate,
+                             uint32_t burst, uint32_t total_rate,
+                             uint32_t total_burst);
+/* Takes a token from the client and the shared bucket, or from neither.
+ * addr 0, an unknown peer, is only limited by the shared bucket. */
+bool modelcar_ratelimit_allow(modelcar_ratelimit_t *rl, uint32_t addr);
+/* The IPv4 address of the peer, 0 when it cannot be told. */
+uint32_t modelcar_ratelimit_sock_addr(int sockfd);
+
+#endif
@@ -0,0 +1,131 @@
+#include "receiver.h"
+
+#include <math.h>
+#include <string.h>
+
+// reset is written by any task, the statistics by the control loop only
+static volatile uint8_t reset_pending;
+static modelcar_receiver_channel_t channels[MODELCAR_RECEIVER_CHANNELS];
+
+static void receiver_period(modelcar_receiver_channel_t *c, uint32_t period)
+{
+    uint32_t bin = period / MODELCAR_RECEIVER_PERIOD_BIN_US;
+    c->period_hist[bin < MODELCAR_RECEIVER_PERIOD_BINS
+                       ? bin
+                       : MODELCAR_RECEIVER_PERIOD_BINS - 1]++;
+    if (period > c->gap_max_us)
+    {
+        c->gap_max_us = period;
+    }
+
+    if (c->periods == 0)
+    {
+        c->period_ref_us = period;
+    }
+    else
+    {
+        // missed frames, kept out of the jitter
+        int64_t avg = c->period_ref_us + c->period_sum / c->periods;
+        if (2 * (int64_t)period > 3 * avg)
+        {
+            c->gaps++;
+            return;
+        }
+    }
+    int64_t d = (int64_t)period - c->period_ref_us;
+    c->periods++;
+    c->period_sum += d;
+    c->period_sum_sq += d * d;
+}
+
+void modelcar_receiver_sample(uint8_t channel, uint32_t width_us,
+                              uint32_t fall_us)
+{
+    if (reset_pending)
+    {
+        memset(channels, 0, sizeof(channels));
+        reset_pending = 0;
+    }
+    if (channel >= MODELCAR_RECEIVER_CHANNELS)
+    {
+        return;
+    }
+
+    modelcar_receiver_channel_t *c = &channels[channel];
+    if (width_us < MODELCAR_PULSE_MIN_US || width_us > MODELCAR_PULSE_MAX_US)
+    {
+        c->glitches++;
+        return;
+    }
+
+    uint32_t rise_us = fall_us - width_us;
+    if (c->pulses > 0)
+    {
+        receiver_period(c, rise_us - c->last_rise_us);
+        int32_t d = (int32_t)width_us - (int32_t)c->last_width_us;
+        c->width_diffs++;
+        c->width_diff_sum_sq += (int64_t)d * d;
+    }
+    uint32_t bin =
+        (width_us - MODELCAR_PULSE_MIN_US) / MODELCAR_RECEIVER_WIDTH_BIN_US;
+    c->width_hist[bin < MODELCAR_RECEIVER_WIDTH_BINS
+                      ? bin
+                      : MODELCAR_RECEIVER_WIDTH_BINS - 1]++;
+    c->pulses++;
+    c->last_rise_us = rise_us;
+    c->last_width_us = width_us;
+}
+
+void modelcar_receiver_reset(void) { reset_pending = 1; }
+
+void modelcar_receiver_get(uint8_t channel, modelcar_receiver_channel_t *stats)
+{
+    if (reset_pending || channel >= MODELCAR_RECEIVER_CHANNELS)
+    {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    memcpy(stats, &channels[channel], sizeof(*stats));
+}
+
+static float receiver_penalty(float value, float per_unit, float max)
+{
+    float penalty = value * per_unit;
+    return penalty < max ? penalty : max;
+}
+
+void modelcar_receiver_summarize(const modelcar_receiver_channel_t *stats,
+                                 modelcar_receiver_summary_t *summary)
+{
+    memset(summary, 0, sizeof(*summary));
+    summary->score = -1;
+    if (stats->pulses == 0)
+    {
+        return;
+    }
+
+    if (stats->periods > 0)
+    {
+        float mean = (float)stats->period_sum / stats->periods;
+        float var = (float)stats->period_sum_sq / stats->periods - mean * mean;
+        summary->period_us = stats->period_ref_us + mean + 0.5f;
+        summary->period_jitter_us = var > 0 ? sqrtf(var) : 0;
+    }
+    if (stats->width_diffs > 0)
+    {
+        // the difference of two noisy samples has twice the variance
+        summary->width_noise_us =
+            sqrtf((float)stats->width_diff_sum_sq / stats->width_diffs / 2);
+    }
+    summary->glitch_permille =
+        1000.0f * stats->glitches / (stats->pulses + stats->glitches);
+    summary->gap_permille =
+        1000.0f * stats->gaps / (stats->periods + stats->gaps + 1);
+
+    // a couple of us of noise is normal for any receiver
+    float noise = summary->width_noise_us - 2;
+    float score = 100 - receiver_penalty(summary->glitch_permille, 2, 40) -
+                  receiver_penalty(summary->gap_permille, 2, 30) -
+                  receiver_penalty(noise > 0 ? noise : 0, 3, 30);
+    summary->score = score + 0.5f;
+}
@@ -0,0 +1,69 @@
+#ifndef _RECEIVER_H_
+#define _RECEIVER_H_
+
+#include <stdint.h>
+
+#include "modelcar.h"
+
+/* steering, throttle and the profile switch */
+#define MODELCAR_RECEIVER_CHANNELS 3
+#define MODELCAR_RECEIVER_WIDTH_BIN_US 50
+#define MODELCAR_RECEIVER_WIDTH_BINS                                           \
+    ((MODELCAR_PULSE_MAX_US - MODELCAR_PULSE_MIN_US) /                         \
+     MODELCAR_RECEIVER_WIDTH_BIN_US)
+/* the last bin holds all longer periods */
+#define MODELCAR_RECEIVER_PERIOD_BIN_US 1000
+#define MODELCAR_RECEIVER_PERIOD_BINS 32
+
+/* Signal statistics of one receiver channel since the last reset, updated in
+ * O(1) per pulse without keeping samples. */
+struct modelcar_receiver_channel_s
+{
+    uint32_t pulses;     // accepted ones
+    uint32_t glitches;   // outside MODELCAR_PULSE_MIN_US..MODELCAR_PULSE_MAX_US
+    uint32_t gaps;       // frame periods over 1.5 times the average
+    uint32_t gap_max_us; // longest frame period
+    // frame periods without the gaps, relative to the first one so that the
+    // 64 bit sums stay exact
+    uint32_t period_ref_us;
+    uint32_t periods;
+    int64_t period_sum;
+    uint64_t period_sum_sq;
+    // differences of consecutive widths: the sticks move slowly against the
+    // frame rate, so these are mostly noise
+    uint32_t width_diffs;
+    uint64_t width_diff_sum_sq;
+    uint32_t width_hist[MODELCAR_RECEIVER_WIDTH_BINS];
+    uint32_t period_hist[MODELCAR_RECEIVER_PERIOD_BINS];
+    uint32_t last_rise_us;
+    uint32_t last_width_us;
+};
+typedef struct modelcar_receiver_channel_s modelcar_receiver_channel_t;
+
+/* derived from the statistics for the page and /metrics */
+struct modelcar_receiver_summary_s
+{
+    uint32_t period_us;     // average frame period
+    float period_jitter_us; // standard deviation of the frame period
+    float width_noise_us;   // standard deviation of the width at rest
+    float glitch_permille;  // of all pulses
+    float gap_permille;     // of all frames
+    /* 100 for a clean signal, minus up to 40 for glitches, 30 for gaps and
+     * 30 for width noise. -1 without pulses. */
+    int score;
+};
+typedef struct modelcar_receiver_summary_s modelcar_receiver_summary_t;
+
+/* Control loop only, every pulse of the channel before it is checked. */
+void modelcar_receiver_sample(uint8_t channel, uint32_t width_us,
+                              uint32_t fall_us);
+/* From any task, the control loop clears the statistics on its next pulse.
+ * Called when a config session starts, see portal.c. */
+void modelcar_receiver_reset(void);
+
+/* Copy of the statistics, taken while the control loop may be writing */
+void modelcar_receiver_get(uint8_t channel, modelcar_receiver_channel_t *stats);
+void modelcar_receiver_summarize(const modelcar_receiver_channel_t *stats,
+                                 modelcar_receiver_summary_t *summary);
+
+#endif
@@ -0,0 +1,100 @@
+#include "resume.h"
+
+#include <string.h>
+
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+#define TAG "modelcar resume"
+
+// both parts carry their own CRC over everything behind it, a reset in the
+// middle of an update then just invalidates that part
+struct resume_profile_s
+{
+    uint32_t crc;
+    uint32_t build; // start of the app ELF hash, other builds start cold
+    uint8_t idx;
+    modelcar_profile_t profile;
+};
+
+struct resume_state_s
+{
+    uint32_t crc;
+    modelcar_resume_state_t state;
+};
+
+static RTC_NOINIT_ATTR struct resume_profile_s rtc_profile;
+static RTC_NOINIT_ATTR struct resume_state_s rtc_state;
+
+static modelcar_resume_stats_t stats;
+
+static uint32_t resume_crc(const void *part, size_t size)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)part + sizeof(uint32_t),
+                            size - sizeof(uint32_t));
+}
+
+static uint32_t resume_build(void)
+{
+    uint32_t build;
+    memcpy(&build, esp_ota_get_app_description()->app_elf_sha256,
+           sizeof(build));
+    return build;
+}
+
+bool modelcar_resume_restore(modelcar_resume_state_t *state)
+{
+    esp_reset_reason_t reason = esp_reset_reason();
+    stats.reset_reason = reason;
+    // after power on RTC memory holds noise
+    if (reason == ESP_RST_POWERON ||
+        rtc_profile.crc != resume_crc(&rtc_profile, sizeof(rtc_profile)) ||
+        rtc_state.crc != resume_crc(&rtc_state, sizeof(rtc_state)) ||
+        rtc_profile.build != resume_build() ||
+        rtc_profile.idx >= MODELCAR_PROFILE_COUNT)
+    {
+        return false;
+    }
+
+    modelcar_profile_restore(rtc_profile.idx, &rtc_profile.profile);
+    *state = rtc_state.state;
+    stats.resumed = 1;
+    stats.restore_us = esp_timer_get_time();
+    ESP_LOGI(TAG, "resumed profile %d after reset %d", rtc_profile.idx,
+             reason);
+    return true;
+}
+
+void modelcar_resume_save_profile(uint8_t idx,
+                                  const modelcar_profile_t *profile)
+{
+    rtc_profile.build = resume_build();
+    rtc_profile.idx = idx;
+    rtc_profile.profile = *profile;
+    rtc_profile.crc = resume_crc(&rtc_profile, sizeof(rtc_profile));
+}
+
+void modelcar_resume_save_state(const modelcar_resume_state_t *state)
+{
+    rtc_state.state = *state;
+    rtc_state.crc = resume_crc(&rtc_state, sizeof(rtc_state));
+}
+
+void modelcar_resume_first_output(void)
+{
+    if (stats.first_output_us == 0)
+    {
+        stats.first_output_us = esp_timer_get_time();
+        ESP_LOGI(TAG, "first output %u us after boot, %s",
+                 stats.first_output_us, stats.resumed ? "resumed" : "cold");
+    }
+}
+
+const modelcar_resume_stats_t *modelcar_resume_get_stats(void)
+{
+    return &stats;
+}
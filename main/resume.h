@@ -0,0 +1,44 @@
+#ifndef _RESUME_H_
+#define _RESUME_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "modelcar.h"
+#include "profile.h"
+
+#define MODELCAR_RESUME_OUTPUTS 2
+
+/* how this boot got to its first pulse driven output */
+struct modelcar_resume_stats_s
+{
+    uint8_t resumed; // outputs came from the RTC snapshot
+    uint8_t reset_reason; // esp_reset_reason_t
+    uint32_t restore_us;  // snapshot applied, 0 on the cold path
+    uint32_t first_output_us;
+};
+typedef struct modelcar_resume_stats_s modelcar_resume_stats_t;
+
+struct modelcar_resume_state_s
+{
+    drive_mode_t throttle_mode;
+    uint32_t duty[MODELCAR_RESUME_OUTPUTS];
+};
+typedef struct modelcar_resume_state_s modelcar_resume_state_t;
+
+/* After any reset but power on, e.g. a brownout from motor inrush, restore
+ * the active profile into profile.c and the last outputs into *state from
+ * RTC memory. Call first thing at boot, before anything touches NVS or WiFi.
+ * False when there is no intact snapshot of this build. */
+bool modelcar_resume_restore(modelcar_resume_state_t *state);
+
+/* Control task only. The profile is copied on changes, the state is small
+ * and cheap to keep current on every pulse. */
+void modelcar_resume_save_profile(uint8_t idx,
+                                  const modelcar_profile_t *profile);
+void modelcar_resume_save_state(const modelcar_resume_state_t *state);
+void modelcar_resume_first_output(void);
+
+const modelcar_resume_stats_t *modelcar_resume_get_stats(void);
+
+#endif
@@ -0,0 +1,97 @@
+#include "slew.h"
+
+static uint16_t ramp_clamp(int ms)
+{
+    if (ms < 0)
+    {
+        return 0;
+    }
+    if (ms > MODELCAR_SLEW_RAMP_MAX_MS)
+    {
+        return MODELCAR_SLEW_RAMP_MAX_MS;
+    }
+    return ms;
+}
+
+void modelcar_slew_profile_build(modelcar_slew_profile_t *profile,
+                                 int accel_ms, int decel_ms, int brake_ms,
+                                 int reverse_ms)
+{
+    decel_ms = ramp_clamp(decel_ms);
+    const modelcar_slew_rate_t accel = {ramp_clamp(accel_ms), decel_ms};
+    const modelcar_slew_rate_t brake = {ramp_clamp(brake_ms), decel_ms};
+    const modelcar_slew_rate_t reverse = {ramp_clamp(reverse_ms), decel_ms};
+
+    profile->mode[NEUTRAL] = accel;
+    profile->mode[FORWARD] = accel;
+    profile->mode[NEUTRAL_FORWARD] = accel;
+    profile->mode[BACKWARDS] = reverse;
+    profile->mode[BREAK] = brake;
+    profile->mode[BREAK_BACKWARDS] = brake;
+}
+
+static uint32_t distance(uint32_t a, uint32_t b)
+{
+    return a > b ? a - b : b - a;
+}
+
+void modelcar_slew_seed(modelcar_slew_t *slew, uint32_t duty, uint32_t now_us)
+{
+    slew->running = true;
+    slew->duty = duty;
+    slew->remainder = 0;
+    slew->last_us = now_us;
+}
+
+uint32_t modelcar_slew_step(modelcar_slew_t *slew,
+                            const modelcar_slew_profile_t *profile,
+                            drive_mode_t mode, uint32_t neutral,
+                            uint32_t target, uint32_t now_us)
+{
+    if (!slew->running)
+    {
+        // ramp up from neutral after boot, unless seeded
+        modelcar_slew_seed(slew, neutral, now_us);
+    }
+
+    // unsigned difference stays right across the 32 bit timer wrap
+    uint32_t elapsed = now_us - slew->last_us;
+    slew->last_us = now_us;
+
+    if (mode >= MAX)
+    {
+        mode = NEUTRAL;
+    }
+    const modelcar_slew_rate_t *rate = &profile->mode[mode];
+    uint32_t ramp_ms = distance(target, neutral) < distance(slew->duty, neutral)
+                           ? rate->toward_ms
+                           : rate->away_ms;
+    if (ramp_ms == 0 || target == slew->duty)
+    {
+        slew->duty = target;
+        slew->remainder = 0;
+        return target;
+    }
+    // after a whole ramp time any step is allowed, also keeps this in 32 bit
+    // as long as ramps stay below MODELCAR_SLEW_RAMP_MAX_MS
+    uint32_t ramp_us = ramp_ms * 1000;
+    if (elapsed > ramp_us)
+    {
+        elapsed = ramp_us;
+    }
+    uint32_t budget = elapsed * MODELCAR_SLEW_FULL_TICKS + slew->remainder;
+    uint32_t step = budget / ramp_us;
+
+    if (step >= distance(target, slew->duty))
+    {
+        slew->duty = target;
+        slew->remainder = 0;
+    }
+    else
+    {
+        slew->duty =
+            target > slew->duty ? slew->duty + step : slew->duty - step;
+        slew->remainder = budget % ramp_us;
+    }
+    return slew->duty;
+}
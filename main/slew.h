@@ -0,0 +1,54 @@
+#ifndef _SLEW_H_
+#define _SLEW_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "modelcar.h"
+
+/* duty ticks from neutral to full throw, 500 us of the 20 ms frame */
+#define MODELCAR_SLEW_FULL_TICKS (500 * 8192 / 20000)
+#define MODELCAR_SLEW_RAMP_MAX_MS 10000
+
+/* Ramp times for a full throw in ms, 0 follows the stick instantly. "away"
+ * moves the output away from neutral, "toward" back to it. */
+struct modelcar_slew_rate_s
+{
+    uint16_t away_ms;
+    uint16_t toward_ms;
+};
+typedef struct modelcar_slew_rate_s modelcar_slew_rate_t;
+
+struct modelcar_slew_profile_s
+{
+    modelcar_slew_rate_t mode[MAX];
+};
+typedef struct modelcar_slew_profile_s modelcar_slew_profile_t;
+
+/* per channel state, owned by the control loop */
+struct modelcar_slew_s
+{
+    bool running;
+    uint32_t duty;
+    uint32_t last_us;
+    uint32_t remainder; // tick-microseconds not yet turned into a full tick
+};
+typedef struct modelcar_slew_s modelcar_slew_t;
+
+void modelcar_slew_profile_build(modelcar_slew_profile_t *profile,
+                                 int accel_ms, int decel_ms, int brake_ms,
+                                 int reverse_ms);
+
+/* Continue from an output already driven, e.g. the one a resume restored,
+ * instead of ramping up from neutral with the first pulse */
+void modelcar_slew_seed(modelcar_slew_t *slew, uint32_t duty, uint32_t now_us);
+
+/* Move the output towards target by what the elapsed time since the last
+ * pulse allows. now_us is the pulse timestamp, so the ramp does not depend on
+ * the frame rate of the receiver. */
+uint32_t modelcar_slew_step(modelcar_slew_t *slew,
+                            const modelcar_slew_profile_t *profile,
+                            drive_mode_t mode, uint32_t neutral,
+                            uint32_t target, uint32_t now_us);
+
+#endif
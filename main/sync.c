@@ -0,0 +1,201 @@
+#include "sync.h"
+
+#include "driver/ledc.h"
+#include "esp_timer.h"
+
+/* times are kept with 4 fractional bits, averages weigh new samples 1/8 */
+#define SYNC_FRAC_BITS 4
+#define SYNC_EWMA_SHIFT 3
+
+/* the output can follow frame periods this close to its nominal one */
+#define SYNC_PERIOD_TOLERANCE_US 400
+/* a 1/8 of the phase error is corrected per frame, at most this much */
+#define SYNC_PHASE_GAIN_SHIFT 3
+#define SYNC_CORRECTION_MAX_US 100
+#define SYNC_LOCKED_US 100
+
+#if CONFIG_MODELCAR_OUTPUT_SYNC
+#define SYNC_LEAD_US CONFIG_MODELCAR_OUTPUT_SYNC_LEAD_US
+#else
+#define SYNC_LEAD_US 0
+#endif
+
+/* LEDC on the 80 MHz APB clock with 13 bit resolution, the divider has 8
+ * fractional bits: a period is 8192 * div / 256 = 32 * div APB ticks. The model
+ * counts in APB ticks so that it stays exact over any number of periods. */
+#define SYNC_TICKS_PER_US 80
+#define SYNC_TICKS_FROM_DIV(div) ((int64_t)(div) * 32)
+#define SYNC_DIV_FROM_PERIOD_Q(q) ((q) * 5 / 32)
+#define SYNC_DIV_NOMINAL                                                       \
+    SYNC_DIV_FROM_PERIOD_Q(MODELCAR_SYNC_OUTPUT_PERIOD_US << SYNC_FRAC_BITS)
+/* Q4 us from APB ticks */
+#define SYNC_Q_FROM_TICKS(t) ((t) / (SYNC_TICKS_PER_US >> SYNC_FRAC_BITS))
+
+/* restart the LEDC timer after this many frames in tolerance but not locked,
+ * only while the model says the outputs are low */
+#define SYNC_REANCHOR_FRAMES 250
+#define SYNC_REANCHOR_LOW_US 5000
+
+struct sync_input_s
+{
+    uint32_t last_rise_us;
+    int32_t period_q;
+    uint8_t valid;
+};
+
+static struct sync_input_s inputs[MODELCAR_SYNC_CHANNELS];
+static int64_t next_latch; // model of the LEDC period start, APB ticks
+static uint32_t period_div; // divider of the period that ends at next_latch
+static uint32_t divider;    // last one set, applies from next_latch
+static int32_t error_q;
+static int32_t latency_q;
+static uint32_t unlocked_frames;
+static modelcar_sync_stats_t stats;
+
+volatile uint32_t modelcar_sync_duty_scale_q16 = 1 << 16;
+
+static void ewma(int32_t *avg_q, int32_t sample)
+{
+    *avg_q += ((sample << SYNC_FRAC_BITS) - *avg_q) >> SYNC_EWMA_SHIFT;
+}
+
+static int64_t sync_now(void)
+{
+    return esp_timer_get_time() * SYNC_TICKS_PER_US;
+}
+
+void modelcar_sync_init(void)
+{
+    divider = SYNC_DIV_NOMINAL;
+    period_div = divider;
+    next_latch = sync_now() + SYNC_TICKS_FROM_DIV(period_div);
+    unlocked_frames = 0;
+    modelcar_sync_duty_scale_q16 = 1 << 16;
+    stats.output_period_us = MODELCAR_SYNC_OUTPUT_PERIOD_US;
+}
+
+void modelcar_sync_reanchor(void)
+{
+    ledc_timer_rst(LEDC_LOW_SPEED_MODE, LEDC_TIMER_1);
+    period_div = divider;
+    next_latch = sync_now() + SYNC_TICKS_FROM_DIV(period_div);
+    unlocked_frames = 0;
+}
+
+void modelcar_sync_input(uint8_t channel, uint32_t rise_us)
+{
+    if (channel >= MODELCAR_SYNC_CHANNELS)
+    {
+        return;
+    }
+    struct sync_input_s *in = &inputs[channel];
+    uint32_t period = rise_us - in->last_rise_us;
+    in->last_rise_us = rise_us;
+
+    // skip the first edge and lost frames, they say nothing about the rate
+    if (in->valid && period > 2500 && period < 40000)
+    {
+        if (in->period_q == 0)
+        {
+            in->period_q = period << SYNC_FRAC_BITS;
+        }
+        ewma(&in->period_q, period);
+        stats.input_period_us[channel] = in->period_q >> SYNC_FRAC_BITS;
+    }
+    in->valid = 1;
+}
+
+bool modelcar_sync_output(uint8_t channel)
+{
+    int64_t now = sync_now();
+    if (now >= next_latch)
+    {
+        // the period from next_latch on runs with the last divider set, skip
+        // lost frames in one step
+        period_div = divider;
+        int64_t period = SYNC_TICKS_FROM_DIV(period_div);
+        next_latch += ((now - next_latch) / period + 1) * period;
+    }
+    int32_t period_q = SYNC_Q_FROM_TICKS(SYNC_TICKS_FROM_DIV(period_div));
+
+    // time until the duty just written is latched
+    int32_t lead_q = SYNC_Q_FROM_TICKS(next_latch - now);
+    int32_t error_now_q = lead_q - (SYNC_LEAD_US << SYNC_FRAC_BITS);
+    if (error_now_q > period_q / 2)
+    {
+        // closer to having just missed the previous latch
+        error_now_q -= period_q;
+    }
+    ewma(&error_q, error_now_q >> SYNC_FRAC_BITS);
+    ewma(&latency_q, lead_q >> SYNC_FRAC_BITS);
+    stats.phase_error_us = error_q >> SYNC_FRAC_BITS;
+    stats.latency_us = latency_q >> SYNC_FRAC_BITS;
+    stats.latency_saved_us = period_q / 2 / (1 << SYNC_FRAC_BITS) -
+                             (int32_t)stats.latency_us;
+
+#if CONFIG_MODELCAR_OUTPUT_SYNC
+    int32_t in_period_q = inputs[channel].period_q;
+    int32_t drift = (in_period_q >> SYNC_FRAC_BITS) -
+                    MODELCAR_SYNC_OUTPUT_PERIOD_US;
+    if (drift <= -SYNC_PERIOD_TOLERANCE_US ||
+        drift >= SYNC_PERIOD_TOLERANCE_US)
+    {
+        // no receiver or a different frame rate, fall back to nominal
+        in_period_q = MODELCAR_SYNC_OUTPUT_PERIOD_US << SYNC_FRAC_BITS;
+        error_now_q = 0;
+    }
+    stats.locked = stats.phase_error_us < SYNC_LOCKED_US &&
+                   stats.phase_error_us > -SYNC_LOCKED_US && error_now_q != 0;
+
+    // Following a receiver that long without a lock, the model may be off the
+    // hardware, e.g. a divider latched a period later than assumed. Restart
+    // the period in the middle of the low phase, that only shortens it.
+    if (stats.locked || error_now_q == 0)
+    {
+        unlocked_frames = 0;
+    }
+    else
+    {
+        unlocked_frames++;
+    }
+    const int32_t low_q = SYNC_REANCHOR_LOW_US << SYNC_FRAC_BITS;
+    if (unlocked_frames >= SYNC_REANCHOR_FRAMES && lead_q > low_q &&
+        lead_q < period_q - low_q)
+    {
+        modelcar_sync_reanchor();
+        return false;
+    }
+
+    // follow the frame rate and shorten or stretch the next period a bit to
+    // pull the latch towards the lead
+    int32_t correction_q = error_now_q >> SYNC_PHASE_GAIN_SHIFT;
+    const int32_t max_q = SYNC_CORRECTION_MAX_US << SYNC_FRAC_BITS;
+    if (correction_q > max_q)
+    {
+        correction_q = max_q;
+    }
+    else if (correction_q < -max_q)
+    {
+        correction_q = -max_q;
+    }
+    uint32_t div = SYNC_DIV_FROM_PERIOD_Q(in_period_q - correction_q);
+    bool div_changed = div != divider;
+    if (div_changed)
+    {
+        divider = div;
+        ledc_timer_set(LEDC_LOW_SPEED_MODE, LEDC_TIMER_1, divider,
+                       LEDC_TIMER_13_BIT, LEDC_APB_CLK);
+        stats.output_period_us =
+            SYNC_TICKS_FROM_DIV(divider) / SYNC_TICKS_PER_US;
+        // a pulse is a tick count, it would change with the period, e.g.
+        // 1500 us by 22 us at 19.7 ms
+        modelcar_sync_duty_scale_q16 =
+            ((uint64_t)SYNC_DIV_NOMINAL << 16) / divider;
+    }
+    return div_changed;
+#else
+    return false;
+#endif
+}
+
+const modelcar_sync_stats_t *modelcar_sync_get_stats(void) { return &stats; }
@@ -0,0 +1,53 @@
+#ifndef _SYNC_H_
+#define _SYNC_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+/* nominal LEDC period, a new duty is latched at the start of each period */
+#define MODELCAR_SYNC_OUTPUT_PERIOD_US 20000
+#define MODELCAR_SYNC_CHANNELS 4
+
+struct modelcar_sync_stats_s
+{
+    uint32_t input_period_us[MODELCAR_SYNC_CHANNELS]; // averaged frame period
+    uint32_t output_period_us;
+    int32_t phase_error_us;   // averaged lead minus the configured lead
+    uint32_t latency_us;      // averaged time from duty write to latch
+    int32_t latency_saved_us; // compared to half a period for a random phase
+    uint8_t locked;
+};
+typedef struct modelcar_sync_stats_s modelcar_sync_stats_t;
+
+/* The pulse widths are in ticks of the LEDC period, which sync.c trims. Q16
+ * factor from a duty of the nominal period to the register value, only the
+ * control task writes it. */
+extern volatile uint32_t modelcar_sync_duty_scale_q16;
+
+/* the LEDC duty for a duty of the nominal period, always inlined, the gpio isr
+ * uses it from IRAM */
+static inline __attribute__((always_inline)) uint32_t
+modelcar_sync_duty(uint32_t duty)
+{
+    return (duty * modelcar_sync_duty_scale_q16 + 0x8000) >> 16;
+}
+
+/* call right after the LEDC timer was (re)started */
+void modelcar_sync_init(void);
+/* Restart the LEDC period now, keeping the trimmed divider, and the model with
+ * it. Only while the outputs are low or stopped, a restart during a pulse
+ * would lengthen it. */
+void modelcar_sync_reanchor(void);
+/* control loop, every accepted pulse */
+void modelcar_sync_input(uint8_t channel, uint32_t rise_us);
+/* Control loop, right after the reference channel wrote its duty. Trims the
+ * LEDC period so that its start lands just after the input frame. True when
+ * the period changed, the staged duties have to be rescaled then, see
+ * modelcar_rescale_outputs(). */
+bool modelcar_sync_output(uint8_t channel);
+
+const modelcar_sync_stats_t *modelcar_sync_get_stats(void);
+
+#endif
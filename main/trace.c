@@ -0,0 +1,229 @@
+#include "trace.h"
+
+#if CONFIG_MODELCAR_TRACE
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define TRACE_EVENTS CONFIG_MODELCAR_TRACE_EVENTS
+#define TRACE_MAX_TASKS 24
+
+// chrome trace threads besides the tasks themselves
+#define TRACE_TID_CPU 0
+#define TRACE_TID_ISR 1
+
+struct trace_event_s
+{
+    uint32_t ts_us;
+    const void *ref;
+    uint8_t type;
+};
+
+static struct trace_event_s events[TRACE_EVENTS];
+static volatile uint32_t head;  // next slot to write
+static volatile uint32_t count; // saturates at TRACE_EVENTS
+static volatile uint8_t recording = 1;
+
+static TaskStatus_t task_status[TRACE_MAX_TASKS];
+static UBaseType_t task_count;
+
+struct trace_writer_s
+{
+    char buf[512];
+    size_t len;
+    modelcar_trace_write_t write;
+    void *ctx;
+    int failed;
+    uint8_t first;
+};
+typedef struct trace_writer_s trace_writer_t;
+
+void IRAM_ATTR modelcar_trace_record(modelcar_trace_type_t type,
+                                     const void *ref)
+{
+    // single core, masking interrupts keeps tasks, isrs and the scheduler out
+    UBaseType_t state = portSET_INTERRUPT_MASK_FROM_ISR();
+    if (!recording)
+    {
+        portCLEAR_INTERRUPT_MASK_FROM_ISR(state);
+        return;
+    }
+    struct trace_event_s *e = &events[head];
+    e->ts_us = esp_timer_get_time();
+    e->ref = ref;
+    e->type = type;
+    head = (head + 1 == TRACE_EVENTS) ? 0 : head + 1;
+    if (count < TRACE_EVENTS)
+    {
+        count++;
+    }
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(state);
+}
+
+void IRAM_ATTR modelcar_trace_task_switched_in(void)
+{
+    modelcar_trace_record(MODELCAR_TRACE_TYPE_SWITCH,
+                          xTaskGetCurrentTaskHandle());
+}
+
+static void trace_flush(trace_writer_t *w)
+{
+    if (w->len && !w->failed)
+    {
+        w->failed = w->write(w->ctx, w->buf, w->len);
+    }
+    w->len = 0;
+}
+
+static void trace_printf(trace_writer_t *w, const char *fmt, ...)
+{
+    char line[128];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (n <= 0)
+    {
+        return;
+    }
+    if (n >= sizeof(line))
+    {
+        n = sizeof(line) - 1;
+    }
+    if (w->len + n + 1 > sizeof(w->buf))
+    {
+        trace_flush(w);
+    }
+    if (!w->first)
+    {
+        w->buf[w->len++] = ',';
+    }
+    w->first = 0;
+    memcpy(w->buf + w->len, line, n);
+    w->len += n;
+}
+
+/* tasks deleted since are only known by their handle */
+static const char *trace_task_name(const void *handle)
+{
+    for (int i = 0; i < task_count; ++i)
+    {
+        if (task_status[i].xHandle == handle)
+        {
+            return task_status[i].pcTaskName;
+        }
+    }
+    return "?";
+}
+
+static void trace_thread_name(trace_writer_t *w, uint32_t tid,
+                              const char *name)
+{
+    trace_printf(w,
+                 "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                 "\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                 tid, name);
+}
+
+void modelcar_trace_export(modelcar_trace_write_t write, void *ctx)
+{
+    static trace_writer_t w;
+    w.len = 0;
+    w.write = write;
+    w.ctx = ctx;
+    w.failed = 0;
+
+    recording = 0;
+    task_count = uxTaskGetSystemState(task_status, TRACE_MAX_TASKS, NULL);
+
+    const char *open = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    memcpy(w.buf, open, strlen(open));
+    w.len = strlen(open);
+    w.first = 1;
+
+    trace_thread_name(&w, TRACE_TID_CPU, "cpu");
+    trace_thread_name(&w, TRACE_TID_ISR, "isr");
+    for (int i = 0; i < task_count; ++i)
+    {
+        trace_thread_name(&w, (uint32_t)(uintptr_t)task_status[i].xHandle,
+                          task_status[i].pcTaskName);
+    }
+
+    uint32_t idx = (head + TRACE_EVENTS - count) % TRACE_EVENTS;
+    uint32_t start = events[idx].ts_us;
+    // spans go to the task running at the time, known after the first switch
+    const void *task = NULL;
+    const struct trace_event_s *running = NULL;
+    uint32_t ts = 0;
+    for (uint32_t i = 0; i < count && !w.failed; ++i)
+    {
+        const struct trace_event_s *e = &events[idx];
+        idx = (idx + 1 == TRACE_EVENTS) ? 0 : idx + 1;
+        // relative, the us clock wraps every ~71 minutes
+        ts = e->ts_us - start;
+        switch (e->type)
+        {
+        case MODELCAR_TRACE_TYPE_SWITCH:
+            if (running)
+            {
+                trace_printf(&w,
+                             "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%u,"
+                             "\"dur\":%u,\"pid\":1,\"tid\":%u}",
+                             trace_task_name(running->ref),
+                             running->ts_us - start, e->ts_us - running->ts_us,
+                             TRACE_TID_CPU);
+            }
+            running = e;
+            task = e->ref;
+            break;
+        case MODELCAR_TRACE_TYPE_BEGIN:
+        case MODELCAR_TRACE_TYPE_END:
+            if (task)
+            {
+                trace_printf(&w,
+                             "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%u,"
+                             "\"pid\":1,\"tid\":%u}",
+                             (const char *)e->ref,
+                             e->type == MODELCAR_TRACE_TYPE_BEGIN ? 'B' : 'E',
+                             ts, (uint32_t)(uintptr_t)task);
+            }
+            break;
+        case MODELCAR_TRACE_TYPE_ISR_BEGIN:
+        case MODELCAR_TRACE_TYPE_ISR_END:
+            trace_printf(&w,
+                         "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%u,"
+                         "\"pid\":1,\"tid\":%u}",
+                         (const char *)e->ref,
+                         e->type == MODELCAR_TRACE_TYPE_ISR_BEGIN ? 'B' : 'E',
+                         ts, TRACE_TID_ISR);
+            break;
+        default:
+            break;
+        }
+    }
+    if (running)
+    {
+        trace_printf(&w,
+                     "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%u,\"dur\":%u,"
+                     "\"pid\":1,\"tid\":%u}",
+                     trace_task_name(running->ref), running->ts_us - start,
+                     ts - (running->ts_us - start), TRACE_TID_CPU);
+    }
+    trace_flush(&w);
+    if (!w.failed)
+    {
+        w.failed = w.write(w.ctx, "]}", 2);
+    }
+
+    head = 0;
+    count = 0;
+    recording = 1;
+}
+
+#endif
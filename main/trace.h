@@ -0,0 +1,46 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+enum modelcar_trace_type_e
+{
+    MODELCAR_TRACE_TYPE_SWITCH = 0, // ref is the task switched in
+    MODELCAR_TRACE_TYPE_BEGIN,      // ref is the span name
+    MODELCAR_TRACE_TYPE_END,
+    MODELCAR_TRACE_TYPE_ISR_BEGIN,
+    MODELCAR_TRACE_TYPE_ISR_END,
+};
+typedef enum modelcar_trace_type_e modelcar_trace_type_t;
+
+/* returns 0 to go on, anything else stops the export */
+typedef int (*modelcar_trace_write_t)(void *ctx, const char *buf, size_t len);
+
+#if CONFIG_MODELCAR_TRACE
+/* Append an event to the ring buffer, callable from tasks, isrs and the
+ * scheduler. Names must be string literals, only the pointer is stored. */
+void modelcar_trace_record(modelcar_trace_type_t type, const void *ref);
+
+#define MODELCAR_TRACE_BEGIN(name)                                             \
+    modelcar_trace_record(MODELCAR_TRACE_TYPE_BEGIN, name)
+#define MODELCAR_TRACE_END(name)                                               \
+    modelcar_trace_record(MODELCAR_TRACE_TYPE_END, name)
+#define MODELCAR_TRACE_ISR_BEGIN(name)                                         \
+    modelcar_trace_record(MODELCAR_TRACE_TYPE_ISR_BEGIN, name)
+#define MODELCAR_TRACE_ISR_END(name)                                           \
+    modelcar_trace_record(MODELCAR_TRACE_TYPE_ISR_END, name)
+
+/* Write the recorded events as Chrome trace JSON in pieces, oldest first.
+ * Recording pauses meanwhile and starts over empty afterwards. */
+void modelcar_trace_export(modelcar_trace_write_t write, void *ctx);
+#else
+#define MODELCAR_TRACE_BEGIN(name)
+#define MODELCAR_TRACE_END(name)
+#define MODELCAR_TRACE_ISR_BEGIN(name)
+#define MODELCAR_TRACE_ISR_END(name)
+#endif
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef _TRACE_HOOKS_H_
+#define _TRACE_HOOKS_H_
+
+/* Forced into every C file of the build with MODELCAR_TRACE, see
+ * CMakeLists.txt. FreeRTOS keeps hook macros that are already defined. */
+void modelcar_trace_task_switched_in(void);
+#define traceTASK_SWITCHED_IN() modelcar_trace_task_switched_in()
+
+#endif
@@ -0,0 +1,171 @@
+#include "transfer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "driver/ledc.h"
+
+#include "modelcar.h"
+
+/* The duty math of the outputs, free of driver calls so that the web server
+ * builds on the host as well, see host/. */
+uint32_t DutyCyclePercentageToDuty(float per)
+{
+    return per / 100.0f * pow(2, LEDC_TIMER_13_BIT);
+}
+
+float DutyCycleScale(float per, float scale)
+{
+    return 7.5f + ((per - 7.5f) * scale);
+}
+
+float DutyCycleUsToPercentage(int32_t us)
+{
+    return us / 200.0f /* us to percent at 50hz*/;
+}
+
+uint32_t DutyCycleOffset(uint32_t us, int offset) { return us + offset; }
+
+float DutyCycleLimit(float per, float limit, int offset)
+{
+    per -= 7.5f - DutyCycleUsToPercentage(offset);
+    const float neutral = 7.5f * 0.5f;
+    if (per > neutral * limit)
+    {
+        per = neutral * limit;
+    }
+    else if (per < -neutral * limit)
+    {
+        per = -neutral * limit;
+    }
+    return 7.5f - DutyCycleUsToPercentage(offset) + per;
+}
+
+uint32_t modelcar_duty_by_us(uint32_t us, float scale, int offset, float limit)
+{
+    return DutyCyclePercentageToDuty(DutyCycleScale(
+        DutyCycleLimit(DutyCycleUsToPercentage(DutyCycleOffset(us, offset)),
+                       limit, offset),
+        scale));
+}
+
+
+static float curve_apply(const modelcar_curve_t *curve, float x)
+{
+    if (curve->count < 2)
+    {
+        return x;
+    }
+    int last = curve->count - 1;
+    // beyond the outer points continue with unit slope
+    if (x <= curve->x[0])
+    {
+        return curve->y[0] + x - curve->x[0];
+    }
+    if (x >= curve->x[last])
+    {
+        return curve->y[last] + x - curve->x[last];
+    }
+    int i = 1;
+    while (x > curve->x[i])
+    {
+        ++i;
+    }
+    float t = (x - curve->x[i - 1]) / (curve->x[i] - curve->x[i - 1]);
+    return curve->y[i - 1] + t * (curve->y[i] - curve->y[i - 1]);
+}
+
+/* -1..1 between the calibrated endpoints, 0 within the deadband */
+static float transfer_normalize(const modelcar_calibration_channel_t *cal,
+                                uint32_t us)
+{
+    float d = (float)us - cal->center;
+    float x = 0.0f;
+    if (d > cal->deadband)
+    {
+        x = (d - cal->deadband) / (cal->max - cal->center - cal->deadband);
+    }
+    else if (d < -cal->deadband)
+    {
+        x = (d + cal->deadband) / (cal->center - cal->min - cal->deadband);
+    }
+    // the table reaches a bit beyond the endpoints, keep that but no further
+    if (x > 1.4f)
+    {
+        x = 1.4f;
+    }
+    else if (x < -1.4f)
+    {
+        x = -1.4f;
+    }
+    return x;
+}
+
+static uint32_t transfer_shape(const modelcar_transfer_params_t *params,
+                               uint32_t us)
+{
+    float x = transfer_normalize(&params->calibration, us);
+    x = (1.0f - params->expo) * x + params->expo * x * x * x;
+    x = curve_apply(&params->curve, x);
+    // steep curves can overshoot, the limit only applies later
+    float us_out = 1500.0f + x * 500.0f;
+    return us_out > 0.0f ? us_out : 0.0f;
+}
+
+void modelcar_transfer_build(modelcar_transfer_t *t,
+                             const modelcar_transfer_params_t *params)
+{
+    for (int i = 0; i < MODELCAR_TRANSFER_ENTRIES; ++i)
+    {
+        uint32_t us = MODELCAR_TRANSFER_MIN_US + i * MODELCAR_TRANSFER_STEP_US;
+        t->duty[i] =
+            modelcar_duty_by_us(transfer_shape(params, us), params->factor,
+                                params->offset, params->limit);
+    }
+}
+
+/* "x:y,x:y,..." with ascending x, at most MODELCAR_CURVE_MAX_POINTS points.
+ * Returns 0 on success, -1 leaves the curve untouched. */
+int modelcar_curve_parse(modelcar_curve_t *curve, const char *str)
+{
+    modelcar_curve_t parsed = {0};
+    while (*str != 0)
+    {
+        if (parsed.count == MODELCAR_CURVE_MAX_POINTS)
+        {
+            return -1;
+        }
+        float x, y;
+        int n = 0;
+        // written as in range tests, so that NaN fails them
+        if (sscanf(str, "%f:%f%n", &x, &y, &n) != 2 ||
+            !(x >= -1.0f && x <= 1.0f && y >= -1.0f && y <= 1.0f) ||
+            (parsed.count > 0 && x <= parsed.x[parsed.count - 1]))
+        {
+            return -1;
+        }
+        parsed.x[parsed.count] = x;
+        parsed.y[parsed.count] = y;
+        parsed.count++;
+        str += n;
+        if (*str == ',')
+        {
+            str++;
+        }
+    }
+    *curve = parsed;
+    return 0;
+}
+
+void modelcar_curve_format(const modelcar_curve_t *curve, char *buf,
+                           size_t size)
+{
+    size_t len = 0;
+    buf[0] = 0;
+    for (int i = 0; i < curve->count && len < size; ++i)
+    {
+        len += snprintf(buf + len, size - len, "%s%.2f:%.2f", i ? "," : "",
+                        curve->x[i], curve->y[i]);
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef _TRANSFER_H_
+#define _TRANSFER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "calibration.h"
+
+/* Input pulse widths covered by the tables, wider pulses are clamped. */
+#define MODELCAR_TRANSFER_MIN_US 800
+#define MODELCAR_TRANSFER_MAX_US 2200
+#define MODELCAR_TRANSFER_STEP_US 8
+#define MODELCAR_TRANSFER_ENTRIES                                              \
+    ((MODELCAR_TRANSFER_MAX_US - MODELCAR_TRANSFER_MIN_US) /                   \
+         MODELCAR_TRANSFER_STEP_US +                                           \
+     1)
+
+#define MODELCAR_CURVE_MAX_POINTS 8
+/* "-1.00:-1.00," per point */
+#define MODELCAR_CURVE_PARAM_MAX (MODELCAR_CURVE_MAX_POINTS * 12 + 1)
+
+/* Piecewise linear response curve on the normalized stick position, both axes
+ * -1..1 with 0 at neutral. Fewer than two points means linear. */
+struct modelcar_curve_s
+{
+    uint8_t count;
+    float x[MODELCAR_CURVE_MAX_POINTS];
+    float y[MODELCAR_CURVE_MAX_POINTS];
+};
+typedef struct modelcar_curve_s modelcar_curve_t;
+
+struct modelcar_transfer_params_s
+{
+    float factor;
+    int offset;
+    float limit;
+    float expo; // 0 linear .. 1 fully cubic, soft around neutral
+    modelcar_curve_t curve;
+    modelcar_calibration_channel_t calibration;
+};
+typedef struct modelcar_transfer_params_s modelcar_transfer_params_t;
+
+/* Output duty per input width, built once from the params so the per-pulse
+ * cost does not depend on how complex the curve is. See profile.h for how
+ * the control loop gets at them. */
+struct modelcar_transfer_s
+{
+    uint16_t duty[MODELCAR_TRANSFER_ENTRIES];
+};
+typedef struct modelcar_transfer_s modelcar_transfer_t;
+
+enum modelcar_transfer_id_e
+{
+    MODELCAR_TRANSFER_STEERING = 0,
+    MODELCAR_TRANSFER_THROTTLE = 1,
+    MODELCAR_TRANSFER_THROTTLE_BRAKE = 2, // throttle without scaling
+    MODELCAR_TRANSFER_COUNT
+};
+typedef enum modelcar_transfer_id_e modelcar_transfer_id_t;
+
+void modelcar_transfer_build(modelcar_transfer_t *t,
+                             const modelcar_transfer_params_t *params);
+
+/* always inlined, the gpio isr uses it from IRAM */
+static inline __attribute__((always_inline)) uint32_t
+modelcar_transfer_lookup(const modelcar_transfer_t *t, uint32_t us)
+{
+    if (us <= MODELCAR_TRANSFER_MIN_US)
+    {
+        return t->duty[0];
+    }
+    if (us >= MODELCAR_TRANSFER_MAX_US)
+    {
+        return t->duty[MODELCAR_TRANSFER_ENTRIES - 1];
+    }
+    uint32_t pos = us - MODELCAR_TRANSFER_MIN_US;
+    uint32_t idx = pos / MODELCAR_TRANSFER_STEP_US;
+    int32_t frac = pos % MODELCAR_TRANSFER_STEP_US;
+    int32_t d0 = t->duty[idx];
+    int32_t d1 = t->duty[idx + 1];
+    return d0 + (d1 - d0) * frac / MODELCAR_TRANSFER_STEP_US;
+}
+
+int modelcar_curve_parse(modelcar_curve_t *curve, const char *str);
+void modelcar_curve_format(const modelcar_curve_t *curve, char *buf,
+                           size_t size);
+
+#endif
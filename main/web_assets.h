@@ -0,0 +1,23 @@
+#ifndef _WEB_ASSETS_H_
+#define _WEB_ASSETS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Config page files, minified and gzipped at build time by
+ * tools/embed_web_assets.py (see main/CMakeLists.txt). */
+struct web_asset_s
+{
+    const char *uri;
+    const char *content_type;
+    const char *cache_control;
+    const char *etag; // strong etag including the quotes
+    const uint8_t *data;
+    size_t len;
+};
+typedef struct web_asset_s web_asset_t;
+
+extern const web_asset_t web_assets[];
+extern const size_t web_assets_count;
+
+#endif
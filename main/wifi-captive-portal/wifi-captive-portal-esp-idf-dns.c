@@ -34,9 +34,21 @@
 #include "string.h"
 #include <sys/time.h>
 
+#include "net.h"
+#include "portal.h"
+#include "ratelimit.h"
+#include "trace.h"
+
 static const char *DNS_TAG = "wifi-captive-portal-esp-idf-dns";
 
-static int sock_fd;
+static modelcar_ratelimit_t dns_ratelimit;
+
+/* The query and reply buffers belong to the network task, see net.h */
+static char dns_name[WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_LEN];
+
+#if WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_LEN > MODELCAR_NET_PACKET_LEN
+#error "DNS packets do not fit the buffers of the network task"
+#endif
 
 // Function to put unaligned 16-bit network values
 static void setn16(void *pp, int16_t n)
@@ -134,13 +146,11 @@ static char *str_to_label(char *str, char *label, int maxLen)
     return p; // ptr to first free byte in resp
 }
 
-// Receive a DNS packet and maybe send a response back
-static void dns_recv(struct sockaddr_in *premote_addr, char *pusrdata,
-                     unsigned short length)
+// Build the response to a DNS packet, returns its length or 0
+static size_t dns_recv(char *pusrdata, unsigned short length, char *reply)
 {
 
-    char buff[WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_LEN];
-    char reply[WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_LEN];
+    char *buff = dns_name;
     int i;
     char *rend = &reply[length];
     char *p = pusrdata;
@@ -150,13 +160,13 @@ static void dns_recv(struct sockaddr_in *premote_addr, char *pusrdata,
 
     // Some sanity checks:
     if (length > WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_LEN)
-        return; // Packet is longer than DNS implementation allows
+        return 0; // Packet is longer than DNS implementation allows
     if (length < sizeof(DnsHeader))
-        return; // Packet is too short
+        return 0; // Packet is too short
     if (hdr->ancount || hdr->nscount || hdr->arcount)
-        return; // this is a reply, don't know what to do with it
+        return 0; // this is a reply, don't know what to do with it
     if (hdr->flags & WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_FLAG_TC)
-        return; // truncated, can't use this
+        return 0; // truncated, can't use this
     // Reply is basically the request plus the needed data
     memcpy(reply, pusrdata, length);
     rhdr->flags |= WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_FLAG_QR;
@@ -164,13 +174,14 @@ static void dns_recv(struct sockaddr_in *premote_addr, char *pusrdata,
     for (i = 0; i < my_ntohs(&hdr->qdcount); i++)
     {
         // Grab the labels in the q string
-        p = label_to_str(pusrdata, p, length, buff, sizeof(buff));
+        p = label_to_str(pusrdata, p, length, buff,
+                         WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_LEN);
         if (p == NULL)
-            return;
+            return 0;
         DnsQuestionFooter *qf = (DnsQuestionFooter *)p;
         p += sizeof(DnsQuestionFooter);
 
-        ESP_LOGI(DNS_TAG,
+        ESP_LOGD(DNS_TAG,
                  "DNS: WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_Q (type 0x%X cl 0x%X) "
                  "for %s\n",
                  my_ntohs(&qf->type), my_ntohs(&qf->cl), buff);
@@ -180,10 +191,11 @@ static void dns_recv(struct sockaddr_in *premote_addr, char *pusrdata,
             // They want to know the IPv4 address of something.
             // Build the response.
 
-            rend = str_to_label(
-                buff, rend, sizeof(reply) - (rend - reply)); // Add the label
+            rend = str_to_label(buff, rend,
+                                WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_LEN -
+                                    (rend - reply)); // Add the label
             if (rend == NULL)
-                return;
+                return 0;
             DnsResourceFooter *rf = (DnsResourceFooter *)rend;
             rend += sizeof(DnsResourceFooter);
             setn16(&rf->type, WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_QTYPE_A);
@@ -193,7 +205,9 @@ static void dns_recv(struct sockaddr_in *premote_addr, char *pusrdata,
             // Grab the current IP of the softap interface
 
             esp_netif_ip_info_t info;
-            esp_netif_get_ip_info(esp_netif_next(NULL), &info);
+            // the AP one, with MODELCAR_MQTT there is a station as well
+            esp_netif_get_ip_info(
+                esp_netif_get_handle_from_ifkey("WIFI_AP_DEF"), &info);
             *rend++ = ip4_addr1(&info.ip);
             *rend++ = ip4_addr2(&info.ip);
             *rend++ = ip4_addr3(&info.ip);
@@ -205,8 +219,9 @@ static void dns_recv(struct sockaddr_in *premote_addr, char *pusrdata,
         {
             // Give ns server. Basically can be whatever we want because it'll
             // get resolved to our IP later anyway.
-            rend = str_to_label(
-                buff, rend, sizeof(reply) - (rend - reply)); // Add the label
+            rend = str_to_label(buff, rend,
+                                WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_LEN -
+                                    (rend - reply)); // Add the label
             DnsResourceFooter *rf = (DnsResourceFooter *)rend;
             rend += sizeof(DnsResourceFooter);
             setn16(&rf->type, WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_QTYPE_NS);
@@ -223,8 +238,9 @@ static void dns_recv(struct sockaddr_in *premote_addr, char *pusrdata,
                  WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_QTYPE_URI)
         {
             // Give uri to us
-            rend = str_to_label(
-                buff, rend, sizeof(reply) - (rend - reply)); // Add the label
+            rend = str_to_label(buff, rend,
+                                WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_LEN -
+                                    (rend - reply)); // Add the label
             DnsResourceFooter *rf = (DnsResourceFooter *)rend;
             rend += sizeof(DnsResourceFooter);
             DnsUriHdr *uh = (DnsUriHdr *)rend;
@@ -240,64 +256,40 @@ static void dns_recv(struct sockaddr_in *premote_addr, char *pusrdata,
             setn16(&rhdr->ancount, my_ntohs(&rhdr->ancount) + 1);
         }
     }
-    // Send the response
-    sendto(sock_fd, (uint8_t *)reply, rend - reply, 0,
-           (struct sockaddr *)premote_addr, sizeof(struct sockaddr_in));
+    return rend - reply;
 }
 
-static void dns_task(void *pvParameters)
+static size_t dns_handle(const struct sockaddr_in *from, const uint8_t *query,
+                         size_t len, uint8_t *reply)
 {
-    struct sockaddr_in server_addr;
-    uint32_t ret;
-    struct sockaddr_in from;
-    socklen_t fromlen;
-    char udp_msg[WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_LEN];
-
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_addr.s_addr = INADDR_ANY;
-    server_addr.sin_port = htons(53);
-    server_addr.sin_len = sizeof(server_addr);
-
-    do
-    {
-        sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
-        if (sock_fd == -1)
-        {
-            ESP_LOGI(DNS_TAG, "dns_task failed to create sock!");
-            vTaskDelay(1000 / portTICK_RATE_MS);
-        }
-    } while (sock_fd == -1);
-
-    do
-    {
-        ret =
-            bind(sock_fd, (struct sockaddr *)&server_addr, sizeof(server_addr));
-        if (ret != 0)
-        {
-            ESP_LOGI(DNS_TAG, "dns_task failed to bind sock!");
-            vTaskDelay(1000 / portTICK_RATE_MS);
-        }
-    } while (ret != 0);
+    // drop floods before spending any time on parsing
+    if (!modelcar_ratelimit_allow(&dns_ratelimit, from->sin_addr.s_addr))
+        return 0;
+    MODELCAR_TRACE_BEGIN("dns_reply");
+    size_t reply_len = dns_recv((char *)query, len, (char *)reply);
+    MODELCAR_TRACE_END("dns_reply");
+    return reply_len;
+}
 
-    ESP_LOGI(DNS_TAG, "DNS initialized.");
+// no station, no queries: the socket is only open while the portal is active
+static modelcar_net_service_t dns_service = {
+    .name = "DNS",
+    .active_bit = MODELCAR_PORTAL_ACTIVE_BIT,
+    .handler = dns_handle,
+};
 
-    while (1)
-    {
-        memset(&from, 0, sizeof(from));
-        fromlen = sizeof(struct sockaddr_in);
-        ret = recvfrom(sock_fd, (uint8_t *)udp_msg,
-                       WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_LEN, 0,
-                       (struct sockaddr *)&from, (socklen_t *)&fromlen);
-        if (ret > 0)
-            dns_recv(&from, udp_msg, ret);
-    }
-
-    close(sock_fd);
-    vTaskDelete(NULL);
+void wifi_captive_portal_esp_idf_dns_init(void)
+{
+    modelcar_ratelimit_init(&dns_ratelimit, CONFIG_MODELCAR_DNS_RATE_LIMIT,
+                            CONFIG_MODELCAR_DNS_RATE_BURST,
+                            CONFIG_MODELCAR_DNS_RATE_LIMIT_TOTAL,
+                            CONFIG_MODELCAR_DNS_RATE_BURST_TOTAL);
+    // not a constant in the host build
+    dns_service.port = WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_PORT;
+    modelcar_net_add_service(&dns_service);
 }
 
-void wifi_captive_portal_esp_idf_dns_init(void)
+const modelcar_ratelimit_t *wifi_captive_portal_esp_idf_dns_ratelimit(void)
 {
-    xTaskCreate(dns_task, (const char *)"dns_task", 10000, NULL, 3, NULL);
+    return &dns_ratelimit;
 }
@@ -30,8 +30,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "ratelimit.h"
+
 #define WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_LEN 512
 
+/** The host build (see host/) listens on an unprivileged port instead. */
+#ifndef WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_PORT
+#define WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_PORT 53
+#endif
+
 #define WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_FLAG_QR (1 << 7)
 #define WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_FLAG_AA (1 << 2)
 #define WIFI_CAPTIVE_PORTAL_ESP_IDF_DNS_FLAG_TC (1 << 1)
@@ -96,6 +103,7 @@ extern "C"
 #endif
 
     void wifi_captive_portal_esp_idf_dns_init(void);
+    const modelcar_ratelimit_t *wifi_captive_portal_esp_idf_dns_ratelimit(void);
 
 #ifdef __cplusplus
 }
@@ -34,204 +34,134 @@
 
 #include "wifi-captive-portal-esp-idf-httpd.h"
 
-#define REST_CHECK(a, str, goto_tag, ...)                                      \
-    do                                                                         \
-    {                                                                          \
-        if (!(a))                                                              \
-        {                                                                      \
-            ESP_LOGE(HTTPD_TAG, "%s(%d): " str, __FUNCTION__, __LINE__,        \
-                     ##__VA_ARGS__);                                           \
-            goto goto_tag;                                                     \
-        }                                                                      \
-    } while (0)
-
-#define FILE_PATH_MAX (ESP_VFS_PATH_MAX + 128)
-#define SCRATCH_BUFSIZE (10240)
-
 static const char *HTTPD_TAG = "wifi-captive-portal-esp-idf-httpd";
 
 esp_event_loop_handle_t wifi_captive_portal_esp_idf_httpd_event_loop_handle;
 
 ESP_EVENT_DEFINE_BASE(WIFI_CAPTIVE_PORTAL_ESP_IDF_HTTPD_EVENT);
 
-static const char *base_path = "/www";
-
-typedef struct rest_server_context
-{
-    char base_path[ESP_VFS_PATH_MAX + 1];
-    char scratch[SCRATCH_BUFSIZE];
-} rest_server_context_t;
-
-#define CHECK_FILE_EXTENSION(filename, ext)                                    \
-    (strcasecmp(&filename[strlen(filename) - strlen(ext)], ext) == 0)
-
-/* Send HTTP response with the contents of the requested file */
-esp_err_t rest_common_get_handler(httpd_req_t *req)
+/** Connectivity check probes of the common client OSes. Answering them with a
+    redirect makes the OS open the portal on the very first probe. A NULL
+    path matches any path on that host. */
+static const wifi_captive_portal_esp_idf_probe_t probes[] = {
+    {"connectivitycheck.gstatic.com", "/generate_204"},
+    {"connectivitycheck.android.com", "/generate_204"},
+    {"clients1.google.com", "/generate_204"},
+    {"clients3.google.com", "/generate_204"},
+    {"www.google.com", "/gen_204"},
+    {"captive.apple.com", NULL},
+    {"www.appleiphonecell.com", NULL},
+    {"www.msftconnecttest.com", NULL},
+    {"www.msftncsi.com", "/ncsi.txt"},
+    {"detectportal.firefox.com", NULL},
+    {"nmcheck.gnome.org", NULL},
+    {"network-test.debian.org", NULL},
+};
+
+#define PROBE_COUNT (sizeof(probes) / sizeof(probes[0]))
+#define PROBE_SLOTS 32 /**< power of two, at least twice PROBE_COUNT */
+#define PROBE_HOST_MAX 64
+
+/** Open addressed hash of the probe hosts, built once without allocation. */
+static int8_t probe_slots[PROBE_SLOTS];
+static uint32_t probe_hits;
+
+static const char probe_redirect_body[] =
+    "<html><body><a href=\"/\">Model Car Config</a></body></html>";
+
+/** FNV-1a over the lower cased host, stops at the port separator. */
+static uint32_t probe_hash(const char *host)
 {
-    size_t req_hdr_host_len = httpd_req_get_hdr_value_len(req, "Host");
-
-    char req_hdr_host_val[req_hdr_host_len + 1];
-
-    esp_err_t res =
-        httpd_req_get_hdr_value_str(req, "Host", (char *)&req_hdr_host_val,
-                                    sizeof(char) * req_hdr_host_len + 1);
-    if (res != ESP_OK)
+    uint32_t h = 2166136261u;
+    for (; *host != 0 && *host != ':'; ++host)
     {
-        ESP_LOGE(HTTPD_TAG, "failed getting HOST header value: %d", res);
-
-        switch (res)
+        char c = *host;
+        if (c >= 'A' && c <= 'Z')
         {
-        case ESP_ERR_NOT_FOUND:
-            ESP_LOGE(HTTPD_TAG,
-                     "failed getting HOST header value: ESP_ERR_NOT_FOUND: Key "
-                     "not found: %d",
-                     res);
-            break;
-
-        case ESP_ERR_INVALID_ARG:
-            ESP_LOGE(HTTPD_TAG,
-                     "failed getting HOST header value: ESP_ERR_INVALID_ARG: "
-                     "Null arguments: %d",
-                     res);
-            break;
-
-        case ESP_ERR_HTTPD_INVALID_REQ:
-            ESP_LOGE(
-                HTTPD_TAG,
-                "failed getting HOST header value: ESP_ERR_HTTPD_INVALID_REQ: "
-                "Invalid HTTP request pointer: %d",
-                res);
-            break;
-
-        case ESP_ERR_HTTPD_RESULT_TRUNC:
-            ESP_LOGE(HTTPD_TAG,
-                     "failed getting HOST header value: "
-                     "ESP_ERR_HTTPD_RESULT_TRUNC: Value string truncated: %d",
-                     res);
-            break;
-
-        default:
-            break;
+            c += 'a' - 'A';
         }
+        h = (h ^ (uint8_t)c) * 16777619u;
     }
+    return h;
+}
 
-    ESP_LOGI(HTTPD_TAG, "Got HOST header value: %s", req_hdr_host_val);
-
-    const char redir_trigger_host[] = "connectivitycheck.gstatic.com";
+static bool probe_host_equal(const char *probe_host, const char *host)
+{
+    size_t len = strlen(probe_host);
+    return strncasecmp(probe_host, host, len) == 0 &&
+           (host[len] == 0 || host[len] == ':');
+}
 
-    if (strncmp(req_hdr_host_val, redir_trigger_host,
-                strlen(redir_trigger_host)) == 0)
+void wifi_captive_portal_esp_idf_httpd_probe_init(void)
+{
+    memset(probe_slots, -1, sizeof(probe_slots));
+    for (int i = 0; i < PROBE_COUNT; ++i)
     {
-        const char resp[] = "302 Found";
-
-        ESP_LOGI(HTTPD_TAG, "Detected redirect trigger HOST: %s",
-                 redir_trigger_host);
-
-        httpd_resp_set_status(req, resp);
-
-        /** NOTE: This is where you redirect to whatever DNS address you prefer
-           to open the captive portal page. This DNS address will be displayed
-           at the top of the page, so maybe you want to choose a nice name to
-           use (it can be any legal DNS name that you prefer. */
-        httpd_resp_set_hdr(req, "Location", (const char *)req->user_ctx);
-
-        httpd_resp_send(req, resp, HTTPD_RESP_USE_STRLEN);
+        uint32_t slot = probe_hash(probes[i].host) & (PROBE_SLOTS - 1);
+        while (probe_slots[slot] >= 0)
+        {
+            slot = (slot + 1) & (PROBE_SLOTS - 1);
+        }
+        probe_slots[slot] = i;
     }
-    else
-    {
-        ESP_LOGI(HTTPD_TAG, "No redirect needed for HOST: %s",
-                 req_hdr_host_val);
-
-        char *buf;
-        size_t buf_len;
+}
 
-        /*	Get header value string length and allocate memory for length + 1,
-            extra byte for null termination */
-        buf_len = httpd_req_get_hdr_value_len(req, "Host") + 1;
-        if (buf_len > 1)
+const wifi_captive_portal_esp_idf_probe_t *
+wifi_captive_portal_esp_idf_httpd_probe_lookup(const char *host,
+                                               const char *uri)
+{
+    uint32_t slot = probe_hash(host) & (PROBE_SLOTS - 1);
+    while (probe_slots[slot] >= 0)
+    {
+        const wifi_captive_portal_esp_idf_probe_t *probe =
+            &probes[probe_slots[slot]];
+        if (probe_host_equal(probe->host, host))
         {
-            buf = malloc(buf_len);
-            /* Copy null terminated value string into buffer */
-            if (httpd_req_get_hdr_value_str(req, "Host", buf, buf_len) ==
-                ESP_OK)
+            if (probe->path == NULL ||
+                strncmp(uri, probe->path, strlen(probe->path)) == 0)
             {
-                ESP_LOGI(HTTPD_TAG, "Found header => Host: %s", buf);
+                return probe;
             }
-            free(buf);
-        }
-
-        /*	Send response with custom headers and body set as the
-            string passed in user context */
-        const char *resp_str = (const char *)req->user_ctx;
-        httpd_resp_send(req, resp_str, strlen(resp_str));
-
-        /*	After sending the HTTP response the old HTTP request
-            headers are lost. Check if HTTP request headers can be read now. */
-        if (httpd_req_get_hdr_value_len(req, "Host") == 0)
-        {
-            ESP_LOGI(HTTPD_TAG, "Request headers lost");
+            return NULL;
         }
+        slot = (slot + 1) & (PROBE_SLOTS - 1);
     }
-
-    return ESP_OK;
+    return NULL;
 }
 
-static void start_httpd(void *pvParameter)
+uint32_t wifi_captive_portal_esp_idf_httpd_probe_hits(void)
 {
-    /** HTTP server */
-    ESP_LOGI(HTTPD_TAG, "Starting HTTP Server...");
-
-    REST_CHECK(base_path, "wrong base path", err);
-    rest_server_context_t *rest_context =
-        calloc(1, sizeof(rest_server_context_t));
-    REST_CHECK(rest_context, "No memory for rest context", err);
-    strlcpy(rest_context->base_path, base_path,
-            sizeof(rest_context->base_path));
-
-    httpd_handle_t server = NULL;
-
-    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    config.uri_match_fn = httpd_uri_match_wildcard;
-    config.lru_purge_enable = true;
-
-    REST_CHECK(httpd_start(&server, &config) == ESP_OK,
-               "Start HTTP server failed", err_start);
-    ESP_LOGI(HTTPD_TAG, "Started HTTP Server.");
-
-    ESP_LOGI(HTTPD_TAG, "Registering HTTP server URI handlers...");
-
-    /** URI handler */
-    httpd_uri_t common_get_uri = {.uri = "/*",
-                                  .method = HTTP_GET,
-                                  .handler = rest_common_get_handler,
-                                  .user_ctx = "Hello World!"};
-
-    httpd_register_uri_handler(server, &common_get_uri);
-
-    ESP_LOGI(HTTPD_TAG, "Registered HTTP server URI handlers.");
-
-    return;
-
-err_start:
-    free(rest_context);
-
-err:
-    return;
+    return probe_hits;
 }
 
-void wifi_captive_portal_esp_idf_httpd_task(void *pvParameter)
+/* Answer OS connectivity probes with a redirect to the portal, everything else
+   with the portal address in the body. req->user_ctx holds the portal URL. */
+esp_err_t rest_common_get_handler(httpd_req_t *req)
 {
-    while (1)
-    {
-        start_httpd(NULL);
+    char host[PROBE_HOST_MAX];
+    const char *location = (const char *)req->user_ctx;
 
-        /** TODO: xEventGroupWaitBits or similar might be much better than
-         * vTaskDelay for this section. */
-        while (1)
-        {
-            vTaskDelay(1000 / portTICK_PERIOD_MS);
-        }
+    /* Hosts longer than the buffer are no probes, truncation is fine. */
+    if (httpd_req_get_hdr_value_str(req, "Host", host, sizeof(host)) ==
+            ESP_OK &&
+        wifi_captive_portal_esp_idf_httpd_probe_lookup(host, req->uri) != NULL)
+    {
+        probe_hits++;
 
-        vTaskDelete(NULL);
+        /** NOTE: This is where you redirect to whatever DNS address you prefer
+           to open the captive portal page. This DNS address will be displayed
+           at the top of the page, so maybe you want to choose a nice name to
+           use (it can be any legal DNS name that you prefer. */
+        httpd_resp_set_status(req, "302 Found");
+        httpd_resp_set_hdr(req, "Location", location);
+        httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+        httpd_resp_send(req, probe_redirect_body,
+                        sizeof(probe_redirect_body) - 1);
+        return ESP_OK;
     }
+
+    ESP_LOGD(HTTPD_TAG, "No redirect needed for %s", req->uri);
+    httpd_resp_send(req, location, HTTPD_RESP_USE_STRLEN);
+
+    return ESP_OK;
 }
@@ -37,6 +37,13 @@ enum /**< The events. */
                                                        is finished". */
 };
 
+/** A known OS connectivity check probe. */
+typedef struct
+{
+    const char *host; /**< Host header value, matched case insensitive. */
+    const char *path; /**< URI prefix, NULL for any path. */
+} wifi_captive_portal_esp_idf_probe_t;
+
 /** The event loop handle. */
 extern esp_event_loop_handle_t
     wifi_captive_portal_esp_idf_httpd_event_loop_handle;
@@ -46,11 +53,16 @@ extern "C"
 {
 #endif
 
-    /** The esp-idf task function. */
-    void wifi_captive_portal_esp_idf_httpd_task(void *pvParameter);
-
     esp_err_t rest_common_get_handler(httpd_req_t *req);
 
+    /** Build the probe host hash, call once before serving requests. */
+    void wifi_captive_portal_esp_idf_httpd_probe_init(void);
+    const wifi_captive_portal_esp_idf_probe_t *
+    wifi_captive_portal_esp_idf_httpd_probe_lookup(const char *host,
+                                                   const char *uri);
+    /** Number of probes answered with a redirect. */
+    uint32_t wifi_captive_portal_esp_idf_httpd_probe_hits(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,185 @@
+// filled from api/params, see params.def
+var params = [];
+
+getProfiles("", loadAll);
+calibrate("");
+signal("");
+
+// the form is built once, later loads only update the values
+function loadAll() {
+    var xhttp = new XMLHttpRequest();
+    xhttp.onreadystatechange = function () {
+        if (this.readyState == 4 && this.status == 200) {
+            var list = JSON.parse(this.responseText).params;
+            if (!params.length) {
+                params = list;
+                params.forEach(addControl);
+            }
+            list.forEach(function (p) {
+                document.getElementById(p.name).value = p.value;
+            });
+            updateDisplay();
+        }
+    };
+    xhttp.open("GET", "api/params", true);
+    xhttp.send();
+}
+
+function addControl(p) {
+    var div = document.createElement("div");
+    var input = document.createElement("input");
+    input.id = p.name;
+    input.onchange = setData;
+    if (p.type == "curve") {
+        input.type = "text";
+        input.placeholder = "-1:-1,0:0,1:1";
+        div.appendChild(document.createTextNode(p.label + " "));
+    } else {
+        input.type = "range";
+        input.min = p.min;
+        input.max = p.max;
+        input.step = p.step;
+        input.oninput = updateDisplay;
+        var label = document.createElement("label");
+        label.id = "l_" + p.name;
+        div.appendChild(document.createTextNode(p.label + " "));
+        div.appendChild(label);
+        div.appendChild(document.createTextNode(" " + p.unit + " "));
+    }
+    div.appendChild(input);
+    document.getElementById("channel" + p.channel).appendChild(div);
+}
+
+// the profile list, optionally after selecting or renaming one
+function getProfiles(query, done) {
+    var xhttp = new XMLHttpRequest();
+    xhttp.onreadystatechange = function () {
+        if (this.readyState == 4 && this.status == 200) {
+            var list = JSON.parse(this.responseText);
+            var select = document.getElementById("profile");
+            select.innerHTML = "";
+            list.profiles.forEach(function (name, i) {
+                select.add(new Option(name, i, false, i == list.active));
+            });
+            document.getElementById("profile_name").value = list.profiles[list.active];
+            if (done) {
+                done();
+            }
+        }
+    };
+    xhttp.open("GET", "profile" + query, true);
+    xhttp.send();
+}
+
+function selectProfile() {
+    getProfiles("?select=" + document.getElementById("profile").value, loadAll);
+}
+
+function renameProfile() {
+    var name = document.getElementById("profile_name").value.replace(/[^-0-9A-Za-z_]/g, "");
+    getProfiles("?name=" + name);
+}
+
+function setData() {
+    var query = params.map(function (p) {
+        var value = p.type == "curve" ? curveParam(p.name) : document.getElementById(p.name).value;
+        return p.name + "=" + value;
+    });
+    var xhttp = new XMLHttpRequest();
+    xhttp.open("GET", "save?" + query.join("&"), true);
+    xhttp.send();
+}
+
+// "x:y,x:y" needs no escaping, just drop what the firmware does not parse
+function curveParam(id) {
+    return document.getElementById(id).value.replace(/[^-0-9.:,]/g, "");
+}
+
+var calibrationHint = {
+    idle: "",
+    center: "release the sticks",
+    range: "move the sticks to all ends, then finish",
+    done: "saved",
+    failed: "range too small, start again"
+};
+
+// polls while the receiver is sampled, the throttle is held at neutral then
+function calibrate(action) {
+    var xhttp = new XMLHttpRequest();
+    xhttp.onreadystatechange = function () {
+        if (this.readyState == 4 && this.status == 200) {
+            var cal = JSON.parse(this.responseText);
+            var text = cal.phase + " " + calibrationHint[cal.phase];
+            cal.channels.forEach(function (c, i) {
+                text += " | servo" + (i + 1) + ": " + c.min + "/" + c.center + "/" + c.max + " us +-" + c.deadband;
+            });
+            document.getElementById("l_calibration").innerHTML = text;
+            if (action || cal.phase == "center" || cal.phase == "range") {
+                setTimeout(function () { calibrate(""); }, 500);
+            }
+        }
+    };
+    xhttp.open("GET", "calibrate" + (action ? "?action=" + action : ""), true);
+    xhttp.send();
+}
+
+var signalNames = ["steering", "throttle", "switch"];
+
+// receiver statistics of this session, refreshed while the page is open
+function signal(query) {
+    var xhttp = new XMLHttpRequest();
+    xhttp.onreadystatechange = function () {
+        if (this.readyState == 4 && this.status == 200) {
+            var text = "";
+            JSON.parse(this.responseText).channels.forEach(function (c, i) {
+                if (c.score < 0) {
+                    return;
+                }
+                text += (text ? " | " : "") + signalNames[i] + ": " + c.score + " %, " +
+                    c.period_us + " us frames +-" + c.period_jitter_us + ", noise " + c.width_noise_us +
+                    " us, " + c.glitches + " glitches, " + c.gaps + " gaps";
+            });
+            document.getElementById("l_signal").innerHTML = text || "no pulses";
+        }
+    };
+    xhttp.open("GET", "api/signal" + query, true);
+    xhttp.send();
+    if (!query) {
+        setTimeout(function () { signal(""); }, 2000);
+    }
+}
+
+// the device restarts into the new image once the upload was accepted
+function uploadFirmware() {
+    var file = document.getElementById("firmware").files[0];
+    if (!file) {
+        return;
+    }
+    var label = document.getElementById("l_firmware");
+    var xhttp = new XMLHttpRequest();
+    xhttp.upload.onprogress = function (e) {
+        label.innerHTML = Math.round(e.loaded * 100 / e.total) + " %";
+    };
+    xhttp.onreadystatechange = function () {
+        if (this.readyState == 4) {
+            if (this.status == 200) {
+                var ota = JSON.parse(this.responseText);
+                label.innerHTML = "done, " + ota.kbyte_per_s + " kB/s, restarting";
+            } else {
+                label.innerHTML = "failed: " + this.responseText;
+            }
+        }
+    };
+    xhttp.open("POST", "api/ota", true);
+    xhttp.send(file);
+}
+
+// a "%" unit shows the value times 100
+function updateDisplay() {
+    params.forEach(function (p) {
+        if (p.type != "curve") {
+            var value = document.getElementById(p.name).value;
+            document.getElementById("l_" + p.name).innerHTML = p.unit == "%" ? Math.round(value * 100) : value;
+        }
+    });
+}
@@ -1,3 +1,7 @@
 #!/bin/sh
+# usage: start_ota.sh BROKER USER PASSWORD IMAGE_URL [DEVICE_ID]
+# The device (MODELCAR_MQTT) downloads and flashes IMAGE_URL, progress shows
+# up on homie/DEVICE_ID/DEVICE_ID/update.
 
-mosquitto_pub -h $1 -u $2 -P $3 -r -t homie/sentio-b2-control/sentio-b2-control/update/set -m $4 -q 0
+device=${5:-modelcar}
+mosquitto_pub -h $1 -u $2 -P $3 -r -t homie/$device/$device/update/set -m $4 -q 0
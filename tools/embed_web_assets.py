@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""Minify, gzip and embed the config page assets into a C source file.
+
+usage: embed_web_assets.py OUTPUT.c index.html [asset ...]
+
+The first asset is served at "/", every further asset under a name carrying
+its content hash (e.g. /app.1a2b3c4d.js) so browsers can cache it forever.
+References to the plain names inside index.html are rewritten accordingly.
+"""
+import gzip
+import hashlib
+import os
+import re
+import sys
+
+CONTENT_TYPES = {
+    ".html": "text/html",
+    ".js": "application/javascript",
+    ".css": "text/css",
+    ".svg": "image/svg+xml",
+    ".ico": "image/x-icon",
+}
+
+CACHE_REVALIDATE = "no-cache"
+CACHE_IMMUTABLE = "public, max-age=31536000, immutable"
+
+
+def minify_html(text):
+    text = re.sub(r"<!--.*?-->", "", text, flags=re.S)
+    return "\n".join(l.strip() for l in text.splitlines() if l.strip())
+
+
+def minify_js(text):
+    # line based only, newlines are kept so automatic semicolons still work
+    lines = (l.strip() for l in text.splitlines())
+    return "\n".join(l for l in lines if l and not l.startswith("//"))
+
+
+def minify_css(text):
+    text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+    text = re.sub(r"\s+", " ", text)
+    text = re.sub(r"\s*([{};:,>])\s*", r"\1", text)
+    return text.replace(";}", "}").strip()
+
+
+MINIFIERS = {".html": minify_html, ".js": minify_js, ".css": minify_css}
+
+
+def content_hash(data):
+    return hashlib.sha256(data).hexdigest()
+
+
+def load(path):
+    ext = os.path.splitext(path)[1]
+    with open(path, encoding="utf-8") as f:
+        text = f.read()
+    return MINIFIERS.get(ext, lambda t: t)(text)
+
+
+def c_array(name, data):
+    lines = []
+    for i in range(0, len(data), 12):
+        lines.append("    " + ", ".join("0x%02x" % b for b in data[i:i + 12]) + ",")
+    return "static const uint8_t %s[] = {\n%s\n};\n" % (name, "\n".join(lines))
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.exit(__doc__)
+    output, index, others = sys.argv[1], sys.argv[2], sys.argv[3:]
+
+    assets = []
+    renames = {}
+    for path in others:
+        text = load(path)
+        stem, ext = os.path.splitext(os.path.basename(path))
+        uri = "/%s.%s%s" % (stem, content_hash(text.encode())[:8], ext)
+        renames[os.path.basename(path)] = uri
+        assets.append((uri, ext, text, CACHE_IMMUTABLE))
+
+    text = load(index)
+    for name, uri in renames.items():
+        text = re.sub(r'((?:src|href)=")%s"' % re.escape(name),
+                      lambda m: m.group(1) + uri + '"', text)
+    assets.insert(0, ("/", ".html", text, CACHE_REVALIDATE))
+
+    out = ["/* generated by tools/embed_web_assets.py, do not edit */",
+           '#include "web_assets.h"', ""]
+    table = []
+    raw_total = gz_total = 0
+    for i, (uri, ext, text, cache) in enumerate(assets):
+        raw = text.encode()
+        # mtime=0 keeps the output reproducible
+        gz = gzip.compress(raw, compresslevel=9, mtime=0)
+        raw_total += len(raw)
+        gz_total += len(gz)
+        out.append(c_array("asset_%d" % i, gz))
+        table.append('    {"%s", "%s", "%s", "\\"%s\\"", asset_%d, sizeof(asset_%d)},'
+                     % (uri, CONTENT_TYPES.get(ext, "application/octet-stream"),
+                        cache, content_hash(gz)[:16], i, i))
+
+    out.append("const web_asset_t web_assets[] = {")
+    out.extend(table)
+    out.append("};")
+    out.append("const size_t web_assets_count = %d;" % len(assets))
+    out.append("")
+
+    with open(output, "w") as f:
+        f.write("\n".join(out))
+    print("web assets: %d files, %d bytes minified, %d bytes gzip"
+          % (len(assets), raw_total, gz_total))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,54 @@
+#!/usr/bin/env python3
+"""Generate a perfect hash over the parameter names of params.def.
+
+usage: gen_params.py OUTPUT.h params.def
+
+Keys are the MODELCAR_PARAM names in file order. The C side hashes with
+modelcar_param_hash(), the same FNV-1a as the routes (see gen_routes.py), and
+verifies the hit with one strncmp.
+"""
+import re
+import sys
+
+from gen_routes import fnv1a
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    output, params_def = sys.argv[1:]
+
+    with open(params_def) as f:
+        keys = re.findall(r"^MODELCAR_PARAM\(\s*(\w+)", f.read(), re.M)
+    if len(set(keys)) != len(keys):
+        sys.exit("gen_params.py: duplicate parameter")
+
+    slots = 8
+    while slots < 2 * len(keys):
+        slots *= 2
+
+    for seed in range(2166136261, 2166136261 + 100000):
+        table = [-1] * slots
+        for i, key in enumerate(keys):
+            slot = fnv1a(seed, key) & (slots - 1)
+            if table[slot] >= 0:
+                break
+            table[slot] = i
+        else:
+            break
+    else:
+        sys.exit("gen_params.py: no perfect hash seed found")
+
+    with open(output, "w") as f:
+        f.write("/* generated by tools/gen_params.py, do not edit */\n")
+        f.write("#define MODELCAR_PARAM_SEED %du\n" % seed)
+        f.write("#define MODELCAR_PARAM_SLOTS %d\n" % slots)
+        f.write("/* slot to params.def index */\n")
+        f.write("static const int8_t modelcar_param_slots[MODELCAR_PARAM_SLOTS] = {\n")
+        for i in range(0, slots, 8):
+            f.write("    " + ", ".join("%d" % v for v in table[i:i + 8]) + ",\n")
+        f.write("};\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+"""Generate a perfect hash over the exact routes of the modelcar web server.
+
+usage: gen_routes.py OUTPUT.h routes.def web_assets_data.c
+
+Keys are the MODELCAR_ROUTE uris of routes.def in file order followed by the
+web asset uris. The C side hashes with modelcar_route_hash(), FNV-1a using
+the generated seed as offset basis with the high half folded into the low
+one, and verifies the hit with one strcmp.
+"""
+import re
+import sys
+
+FNV_PRIME = 16777619
+
+
+def fnv1a(seed, text):
+    h = seed
+    for c in text.encode():
+        h = ((h ^ c) * FNV_PRIME) & 0xFFFFFFFF
+    # the low bits only depend on the low seed bits, fold the high half in
+    return h ^ (h >> 16)
+
+
+def main():
+    if len(sys.argv) != 4:
+        sys.exit(__doc__)
+    output, routes_def, assets_c = sys.argv[1:]
+
+    with open(routes_def) as f:
+        keys = re.findall(r'^MODELCAR_ROUTE\(\s*\w+\s*,\s*"([^"]+)"', f.read(), re.M)
+    with open(assets_c) as f:
+        keys += re.findall(r'^    \{"([^"]+)"', f.read(), re.M)
+    if len(set(keys)) != len(keys):
+        sys.exit("gen_routes.py: duplicate route")
+
+    slots = 8
+    while slots < 2 * len(keys):
+        slots *= 2
+
+    for seed in range(2166136261, 2166136261 + 100000):
+        table = [-1] * slots
+        for i, key in enumerate(keys):
+            slot = fnv1a(seed, key) & (slots - 1)
+            if table[slot] >= 0:
+                break
+            table[slot] = i
+        else:
+            break
+    else:
+        sys.exit("gen_routes.py: no perfect hash seed found")
+
+    with open(output, "w") as f:
+        f.write("/* generated by tools/gen_routes.py, do not edit */\n")
+        f.write("#define MODELCAR_ROUTE_SEED %du\n" % seed)
+        f.write("#define MODELCAR_ROUTE_SLOTS %d\n" % slots)
+        f.write("#define MODELCAR_ROUTE_KEYS %d\n" % len(keys))
+        f.write("/* slot to key index: routes.def entries first, then web assets */\n")
+        f.write("static const int8_t modelcar_route_slots[MODELCAR_ROUTE_SLOTS] = {\n")
+        for i in range(0, slots, 8):
+            f.write("    " + ", ".join("%d" % v for v in table[i:i + 8]) + ",\n")
+        f.write("};\n")
+
+
+if __name__ == "__main__":
+    main()
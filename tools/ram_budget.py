@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+"""Print the static RAM footprint per subsystem from the linker map file.
+
+usage: ram_budget.py PROJECT.map
+
+Everything placed in internal data RAM (.dram0.data / .dram0.bss) is summed
+per input object. Objects of the main component are grouped into firmware
+subsystems, everything else by its IDF component library.
+"""
+import collections
+import os
+import re
+import sys
+
+RAM_SECTIONS = (".dram0.data", ".dram0.bss")
+
+# main component object -> subsystem
+SUBSYSTEMS = {
+    "main.c.obj": "control",
+    "modelcar.c.obj": "control",
+    "sync.c.obj": "control",
+    "calibration.c.obj": "control",
+    "esc.c.obj": "control",
+    "profile.c.obj": "control",
+    "receiver.c.obj": "control",
+    "resume.c.obj": "control",
+    "slew.c.obj": "control",
+    "transfer.c.obj": "control",
+    "httpd.c.obj": "web",
+    "idle.c.obj": "control",
+    "web_assets_data.c.obj": "web",
+    "ratelimit.c.obj": "web",
+    "ota.c.obj": "web",
+    "params.c.obj": "web",
+    "homie.c.obj": "mqtt",
+    "metrics.c.obj": "metrics",
+    "net.c.obj": "network",
+    "trace.c.obj": "metrics",
+    "portal.c.obj": "web",
+    "wifi-captive-portal-esp-idf-dns.c.obj": "captive dns",
+    "wifi-captive-portal-esp-idf-httpd.c.obj": "captive httpd",
+}
+
+ENTRY = re.compile(r"^\s+(?:(\S+)\s+)?0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+)$")
+
+
+def subsystem(origin):
+    m = re.match(r"(?:.*/)?(lib[^/]+)\.a\((.+)\)$", origin)
+    if m is None:
+        return "other"
+    lib, obj = m.groups()
+    if lib == "libmain":
+        return "main: " + SUBSYSTEMS.get(os.path.basename(obj), obj)
+    return lib[3:]
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+
+    sizes = collections.Counter()
+    section = None
+    with open(sys.argv[1], errors="replace") as f:
+        for line in f:
+            if line and not line[0].isspace():
+                name = line.split()[0] if line.strip() else ""
+                section = name if name in RAM_SECTIONS else None
+                continue
+            if section is None:
+                continue
+            m = ENTRY.match(line.rstrip("\n"))
+            if m is None or int(m.group(2), 16) == 0:
+                continue
+            sizes[subsystem(m.group(4))] += int(m.group(3), 16)
+
+    total = sum(sizes.values())
+    print("RAM budget (static .data + .bss)")
+    for name, size in sorted(sizes.items(), key=lambda i: (-i[1], i[0])):
+        if name.startswith("main: ") or size >= 512:
+            print("  %-28s %7d" % (name, size))
+    rest = sum(s for n, s in sizes.items()
+               if not n.startswith("main: ") and s < 512)
+    print("  %-28s %7d" % ("(smaller components)", rest))
+    print("  %-28s %7d" % ("total", total))
+
+
+if __name__ == "__main__":
+    main()